@@ -15,8 +15,9 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
   EventLoop eventloop {};
   FileDescriptor input { STDIN_FILENO };
   FileDescriptor output { STDOUT_FILENO };
-  ByteStream outbound { buffer_size };
-  ByteStream inbound { buffer_size };
+  // bytes move between the descriptors and the streams' pages with readv/writev, never via a temporary string
+  ByteStream outbound { buffer_size, ByteStream::Storage::Paged };
+  ByteStream inbound { buffer_size, ByteStream::Storage::Paged };
   bool outbound_shutdown { false };
   bool inbound_shutdown { false };
 
@@ -30,10 +31,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     input,
     Direction::In,
     [&] {
-      string data;
-      data.resize( outbound.writer().available_capacity() );
-      input.read( data );
-      outbound.writer().push( move( data ) );
+      outbound.writer().read_from( input );
       if ( input.eof() ) {
         outbound.writer().close();
       }
@@ -55,9 +53,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     socket,
     Direction::Out,
     [&] {
-      if ( outbound.reader().bytes_buffered() ) {
-        outbound.reader().pop( socket.write( outbound.reader().peek() ) );
-      }
+      outbound.reader().write_to( socket );
       if ( outbound.reader().is_finished() ) {
         socket.shutdown( SHUT_WR );
         outbound_shutdown = true;
@@ -80,10 +76,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     socket,
     Direction::In,
     [&] {
-      string data;
-      data.resize( inbound.writer().available_capacity() );
-      socket.read( data );
-      inbound.writer().push( move( data ) );
+      inbound.writer().read_from( socket );
       if ( socket.eof() ) {
         inbound.writer().close();
       }
@@ -105,9 +98,7 @@ void bidirectional_stream_copy( Socket& socket, string_view peer_name )
     output,
     Direction::Out,
     [&] {
-      if ( inbound.reader().bytes_buffered() ) {
-        inbound.reader().pop( output.write( inbound.reader().peek() ) );
-      }
+      inbound.reader().write_to( output );
       if ( inbound.reader().is_finished() ) {
         output.close();
         inbound_shutdown = true;
@@ -30,7 +30,9 @@ void show_usage( const char* argv0, const char* msg )
        << "   -a <addr>       Set source address (client mode only)           " << LOCAL_ADDRESS_DFLT << "\n"
        << "   -s <port>       Set source port (client mode only)              (random)\n\n"
 
-       << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::MAX_PAYLOAD_SIZE
+       << "   -w <winsz>      Use a window of <winsz> bytes                   " << TCPConfig::DEFAULT_CAPACITY
+       << "\n"
+       << "   -m <mss>        Use a maximum segment size of <mss> bytes       " << TCPConfig::MAX_PAYLOAD_SIZE
        << "\n\n"
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
@@ -91,6 +93,11 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
       c_fsm.recv_capacity = strtol( args[curr + 1], nullptr, 0 );
       curr += 2;
 
+    } else if ( strncmp( "-m", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -m requires one argument." );
+      c_fsm.mss = strtol( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
     } else if ( strncmp( "-t", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -t requires one argument." );
       c_fsm.rt_timeout = strtol( args[curr + 1], nullptr, 0 );
@@ -23,6 +23,7 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_storage)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -31,6 +32,7 @@ ttest(reassembler_dup)
 ttest(reassembler_holes)
 ttest(reassembler_overlapping)
 ttest(reassembler_win)
+ttest(reassembler_modes)
 
 ttest(wrapping_integers_cmp)
 ttest(wrapping_integers_wrap)
@@ -45,6 +47,10 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_zero_copy)
+ttest(recv_sack)
+ttest(recv_sws)
+ttest(recv_delayed_ack)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,6 +59,15 @@ ttest(send_ack)
 ttest(send_close)
 ttest(send_retx)
 ttest(send_extra)
+ttest(send_congestion)
+ttest(send_bbr)
+ttest(send_rto)
+ttest(send_fast_recovery)
+ttest(send_sack)
+ttest(send_window_scale)
+ttest(send_timestamps)
+ttest(send_rack_tlp)
+ttest(send_nagle)
 
 ttest(net_interface)
 
@@ -93,4 +108,12 @@ set_property(TEST ${compile_name_opt} PROPERTY TIMEOUT 0)
 set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
+stest(byte_stream_spsc_speed_test)
 stest(reassembler_speed_test)
+stest(reassembler_bench)
+stest(tcp_mss_bench)
+stest(short_transfer_bench)
+stest(sender_inflight_bench)
+stest(nagle_bench)
+stest(delayed_ack_bench)
+stest(recv_autotune_bench)
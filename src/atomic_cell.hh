@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Assumed size of a cache line, for keeping data written by different threads apart
+// (std::hardware_destructive_interference_size is not ABI-stable across compilers).
+static constexpr size_t kCacheLineSize = 64;
+
+// A value that one thread writes and another thread reads. Stores are releases and
+// loads are acquires, so whatever the writer did before a store is visible to a
+// reader that sees the stored value. Unlike std::atomic it can be copied (the copy
+// is a snapshot), so objects holding one stay copyable.
+template<typename T>
+class AtomicCell
+{
+public:
+  AtomicCell() = default;
+  explicit AtomicCell( T value ) : value_( value ) {}
+
+  AtomicCell( const AtomicCell& other ) : value_( other.load() ) {}
+  AtomicCell& operator=( const AtomicCell& other )
+  {
+    store( other.load() );
+    return *this;
+  }
+  ~AtomicCell() = default;
+
+  T load() const { return value_.load( std::memory_order_acquire ); }
+  void store( T value ) { value_.store( value, std::memory_order_release ); }
+
+  // For the single writing thread: read its own last store without synchronizing
+  T owned() const { return value_.load( std::memory_order_relaxed ); }
+
+  // For the single writing thread: add to the value (a plain store, not a read-modify-write)
+  void advance( T delta ) { store( owned() + delta ); }
+
+private:
+  std::atomic<T> value_ {};
+};
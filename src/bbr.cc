@@ -0,0 +1,215 @@
+#include "bbr.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+constexpr double kHighGain = 2.885; // 2 / ln(2): doubles the sending rate each round in Startup
+constexpr double kDrainGain = 1 / kHighGain;
+constexpr double kCwndGain = 2;
+constexpr array<double, 8> kGainCycle { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+
+constexpr uint64_t kBtlBwRounds = 10;
+constexpr uint64_t kMinRttWindowUs = 10'000'000;
+constexpr uint64_t kProbeRttDurationUs = 200'000;
+constexpr uint64_t kMinWindowSegments = 4;
+} // namespace
+
+// Initial window as for Reno (RFC 5681 section 3.1)
+Bbr::Bbr( uint64_t mss )
+  : mss_( mss )
+  , cwnd_( min( 4 * mss, max<uint64_t>( 2 * mss, 4380 ) ) )
+  , pacing_gain_( kHighGain )
+  , cwnd_gain_( kHighGain )
+{}
+
+uint64_t Bbr::btl_bw() const
+{
+  return btl_bw_filter_.empty() ? 0 : btl_bw_filter_.front().second;
+}
+
+uint64_t Bbr::pacing_rate() const
+{
+  if ( btl_bw() > 0 ) {
+    return static_cast<uint64_t>( pacing_gain_ * static_cast<double>( btl_bw() ) );
+  }
+  // no delivery rate yet: send the window over one RTT (or not pace at all, before any RTT)
+  if ( min_rtt_us_ != UINT64_MAX and min_rtt_us_ > 0 ) {
+    return static_cast<uint64_t>( kHighGain * static_cast<double>( cwnd_ ) * 1e6
+                                  / static_cast<double>( min_rtt_us_ ) );
+  }
+  return 0;
+}
+
+uint64_t Bbr::bdp( double gain ) const
+{
+  if ( btl_bw() == 0 or min_rtt_us_ == UINT64_MAX ) {
+    return min( 4 * mss_, max<uint64_t>( 2 * mss_, 4380 ) );
+  }
+  return static_cast<uint64_t>( gain * static_cast<double>( btl_bw() ) * static_cast<double>( min_rtt_us_ ) / 1e6 );
+}
+
+void Bbr::on_ack( const Event& event )
+{
+  update_round( event );
+  update_btl_bw( event );
+  update_min_rtt( event );
+  check_full_pipe();
+  advance_state( event );
+  update_cwnd( event );
+}
+
+void Bbr::on_loss( const Event& event )
+{
+  // packet conservation: send no more than what leaves the network until the ACKs say otherwise
+  cwnd_ = min( cwnd_, max( event.in_flight + mss_, kMinWindowSegments * mss_ ) );
+  loss_in_cycle_ = true;
+}
+
+void Bbr::on_timeout( const Event& /*unused*/ )
+{
+  cwnd_ = mss_;
+  loss_in_cycle_ = true;
+}
+
+void Bbr::update_round( const Event& event )
+{
+  round_start_ = event.ackno >= round_end_;
+  if ( round_start_ ) {
+    ++round_;
+    round_end_ = event.next_seqno;
+  }
+}
+
+void Bbr::update_btl_bw( const Event& event )
+{
+  if ( event.delivery_rate == 0 ) {
+    return;
+  }
+  // windowed maximum: drop samples older than the window, and those a newer, higher one makes moot
+  while ( not btl_bw_filter_.empty() and btl_bw_filter_.front().first + kBtlBwRounds <= round_ ) {
+    btl_bw_filter_.pop_front();
+  }
+  while ( not btl_bw_filter_.empty() and btl_bw_filter_.back().second <= event.delivery_rate ) {
+    btl_bw_filter_.pop_back();
+  }
+  btl_bw_filter_.emplace_back( round_, event.delivery_rate );
+}
+
+void Bbr::update_min_rtt( const Event& event )
+{
+  min_rtt_expired_ = min_rtt_us_ != UINT64_MAX and event.now_us > min_rtt_stamp_us_ + kMinRttWindowUs;
+  if ( event.rtt_us.has_value() and ( *event.rtt_us < min_rtt_us_ or min_rtt_expired_ ) ) {
+    min_rtt_us_ = *event.rtt_us;
+    min_rtt_stamp_us_ = event.now_us;
+  }
+}
+
+void Bbr::check_full_pipe()
+{
+  if ( filled_pipe_ or not round_start_ or btl_bw() == 0 ) {
+    return;
+  }
+  if ( static_cast<double>( btl_bw() ) >= 1.25 * static_cast<double>( full_bw_ ) ) {
+    full_bw_ = btl_bw();
+    full_bw_rounds_ = 0;
+    return;
+  }
+  filled_pipe_ = ++full_bw_rounds_ >= 3;
+}
+
+void Bbr::advance_state( const Event& event )
+{
+  if ( state_ == State::Startup and filled_pipe_ ) {
+    enter( State::Drain, event );
+  }
+  if ( state_ == State::Drain and event.in_flight <= bdp( 1 ) ) {
+    enter( State::ProbeBW, event );
+  }
+
+  if ( state_ == State::ProbeBW ) {
+    // each phase lasts at least one min RTT; probing up lasts until the extra data is in flight (or
+    // is lost), and draining ends early once the queue it was for has gone
+    const bool full_length = event.now_us - cycle_stamp_us_ > min_rtt_us_;
+    const uint64_t prior_in_flight = event.in_flight + event.newly_acked;
+    bool next_phase = full_length;
+    if ( pacing_gain_ > 1 ) {
+      next_phase = full_length and ( loss_in_cycle_ or prior_in_flight >= bdp( pacing_gain_ ) );
+    } else if ( pacing_gain_ < 1 ) {
+      next_phase = full_length or prior_in_flight <= bdp( 1 );
+    }
+    if ( next_phase ) {
+      cycle_index_ = ( cycle_index_ + 1 ) % kGainCycle.size();
+      cycle_stamp_us_ = event.now_us;
+      pacing_gain_ = kGainCycle.at( cycle_index_ );
+      loss_in_cycle_ = false;
+    }
+  }
+
+  if ( state_ != State::ProbeRTT and min_rtt_expired_ ) {
+    prior_cwnd_ = cwnd_;
+    enter( State::ProbeRTT, event );
+  }
+
+  if ( state_ == State::ProbeRTT ) {
+    // wait for in_flight to come down, then hold it there for 200 ms and at least one round
+    if ( probe_rtt_done_us_ == 0 and event.in_flight <= kMinWindowSegments * mss_ ) {
+      probe_rtt_done_us_ = event.now_us + kProbeRttDurationUs;
+      probe_rtt_round_done_ = false;
+      round_end_ = event.next_seqno;
+    } else if ( probe_rtt_done_us_ != 0 ) {
+      probe_rtt_round_done_ |= round_start_;
+      if ( probe_rtt_round_done_ and event.now_us >= probe_rtt_done_us_ ) {
+        min_rtt_stamp_us_ = event.now_us;
+        cwnd_ = max( cwnd_, prior_cwnd_ );
+        enter( filled_pipe_ ? State::ProbeBW : State::Startup, event );
+      }
+    }
+  }
+}
+
+void Bbr::update_cwnd( const Event& event )
+{
+  const uint64_t min_window = kMinWindowSegments * mss_;
+  // the extra segments leave room for delayed and stretched ACKs
+  const uint64_t target = max( bdp( cwnd_gain_ ) + 3 * mss_, min_window );
+  if ( filled_pipe_ ) {
+    cwnd_ = min( cwnd_ + event.newly_acked, target );
+  } else if ( cwnd_ < target or btl_bw() == 0 ) {
+    cwnd_ += event.newly_acked;
+  }
+  cwnd_ = max( cwnd_, min_window );
+  if ( state_ == State::ProbeRTT ) {
+    cwnd_ = min( cwnd_, min_window );
+  }
+}
+
+void Bbr::enter( State state, const Event& event )
+{
+  state_ = state;
+  switch ( state ) {
+    case State::Startup:
+      pacing_gain_ = kHighGain;
+      cwnd_gain_ = kHighGain;
+      break;
+    case State::Drain:
+      pacing_gain_ = kDrainGain;
+      cwnd_gain_ = kHighGain;
+      break;
+    case State::ProbeBW:
+      // start in the last cruising phase, so the first probe for bandwidth comes one min RTT in
+      cycle_index_ = kGainCycle.size() - 1;
+      cycle_stamp_us_ = event.now_us;
+      pacing_gain_ = kGainCycle.at( cycle_index_ );
+      cwnd_gain_ = kCwndGain;
+      break;
+    case State::ProbeRTT:
+      pacing_gain_ = 1;
+      cwnd_gain_ = 1;
+      probe_rtt_done_us_ = 0;
+      break;
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "congestion_control.hh"
+
+#include <deque>
+#include <utility>
+
+// BBR (draft-cardwell-iccrg-bbr-congestion-control): rather than reacting to loss, keeps a model of
+// the path, the bottleneck bandwidth (the highest delivery rate seen over the last ten rounds) and
+// the round-trip propagation time (the lowest RTT seen over the last ten seconds). It paces at
+// about the bottleneck bandwidth and keeps about one bandwidth-delay product in flight.
+//
+//   Startup:  pace at 2/ln(2) times the bandwidth until it stops growing by 25% a round for three rounds
+//   Drain:    pace below the bandwidth until the queue Startup built has gone
+//   ProbeBW:  cycle the pacing gain through 1.25, 0.75 and then 1 for six rounds, to find more bandwidth
+//   ProbeRTT: when the lowest RTT is ten seconds old, keep four segments in flight for 200 ms to
+//             measure it again with no queue
+class Bbr : public CongestionControl
+{
+public:
+  enum class State : uint8_t
+  {
+    Startup,
+    Drain,
+    ProbeBW,
+    ProbeRTT,
+  };
+
+  explicit Bbr( uint64_t mss );
+
+  Algorithm algorithm() const override { return Algorithm::Bbr; }
+  uint64_t cwnd() const override { return cwnd_; }
+  uint64_t ssthresh() const override { return UINT64_MAX; }
+  uint64_t pacing_rate() const override;
+
+  void on_ack( const Event& event ) override;
+  void on_loss( const Event& event ) override;
+  void on_timeout( const Event& event ) override;
+
+  State state() const { return state_; }
+  uint64_t btl_bw() const;                            // sequence numbers per second, or 0 before any sample
+  uint64_t min_rtt_us() const { return min_rtt_us_; } // UINT64_MAX before any sample
+  double pacing_gain() const { return pacing_gain_; }
+
+private:
+  uint64_t bdp( double gain ) const; // gain times the estimated bandwidth-delay product
+  void update_round( const Event& event );
+  void update_btl_bw( const Event& event );
+  void update_min_rtt( const Event& event );
+  void check_full_pipe();
+  void advance_state( const Event& event );
+  void update_cwnd( const Event& event );
+  void enter( State state, const Event& event );
+
+  uint64_t mss_;
+  uint64_t cwnd_;
+  uint64_t prior_cwnd_ {}; // cwnd when ProbeRTT started, restored when it ends
+  State state_ { State::Startup };
+  double pacing_gain_;
+  double cwnd_gain_;
+
+  // rounds: a round ends when the ACK passes everything sent when it started
+  uint64_t round_ {};
+  uint64_t round_end_ {};
+  bool round_start_ {};
+
+  std::deque<std::pair<uint64_t, uint64_t>> btl_bw_filter_ {}; // (round, rate), rates decreasing
+  uint64_t min_rtt_us_ { UINT64_MAX };
+  uint64_t min_rtt_stamp_us_ {};
+  bool min_rtt_expired_ {};
+
+  uint64_t full_bw_ {}; // bandwidth when Startup last saw it grow by 25%
+  uint64_t full_bw_rounds_ {};
+  bool filled_pipe_ {};
+
+  size_t cycle_index_ {};
+  uint64_t cycle_stamp_us_ {};
+  bool loss_in_cycle_ {};
+
+  uint64_t probe_rtt_done_us_ {}; // 0 until in_flight has come down to the ProbeRTT window
+  bool probe_rtt_round_done_ {};
+};
@@ -0,0 +1,238 @@
+#include "bitmap_store.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+
+#if defined( __x86_64__ )
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+constexpr uint64_t kWordBits = 64;
+constexpr uint64_t kAllPresent = UINT64_MAX;
+
+// Each scan returns how many of the `count` words at `words` are all ones before the first that is not
+using WordScan = size_t ( * )( const uint64_t* words, size_t count );
+
+size_t scan_words( const uint64_t* words, size_t count )
+{
+  size_t i = 0;
+  while ( i < count and words[i] == kAllPresent ) {
+    ++i;
+  }
+  return i;
+}
+
+#if defined( __x86_64__ )
+// SSE2 is part of x86-64, so this one needs no check of the CPU
+size_t scan_words_sse2( const uint64_t* words, size_t count )
+{
+  const __m128i ones = _mm_set1_epi32( -1 );
+  size_t i = 0;
+  for ( ; i + 2 <= count; i += 2 ) {
+    // NOLINTNEXTLINE(*-reinterpret-cast)
+    const __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( words + i ) );
+    if ( _mm_movemask_epi8( _mm_cmpeq_epi32( v, ones ) ) != 0xFFFF ) {
+      break;
+    }
+  }
+  return i + scan_words( words + i, count - i );
+}
+
+[[gnu::target( "avx2" )]] size_t scan_words_avx2( const uint64_t* words, size_t count )
+{
+  const __m256i ones = _mm256_set1_epi64x( -1 );
+  size_t i = 0;
+  for ( ; i + 4 <= count; i += 4 ) {
+    // NOLINTNEXTLINE(*-reinterpret-cast)
+    const __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( words + i ) );
+    if ( _mm256_movemask_epi8( _mm256_cmpeq_epi64( v, ones ) ) != -1 ) {
+      break;
+    }
+  }
+  return i + scan_words( words + i, count - i );
+}
+#endif
+
+WordScan vector_scan()
+{
+#if defined( __x86_64__ )
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx2" ) ) {
+    return scan_words_avx2;
+  }
+  return scan_words_sse2;
+#else
+  return scan_words;
+#endif
+}
+
+WordScan& word_scan()
+{
+  static WordScan scan = vector_scan();
+  return scan;
+}
+} // namespace
+
+BitmapStore::BitmapStore( uint64_t capacity, uint64_t next_index )
+  : ring_( capacity ), present_( ( capacity + kWordBits - 1 ) / kWordBits ), next_( next_index )
+{}
+
+void BitmapStore::use_vector_scan( bool enabled )
+{
+  word_scan() = enabled ? vector_scan() : scan_words;
+}
+
+void BitmapStore::store( uint64_t first_index, string data )
+{
+  bytes_pending_ += mark( first_index, data.size(), true );
+
+  // copy in at most two pieces: up to the end of the ring, then from the front
+  const uint64_t start = slot( first_index );
+  const uint64_t first = min( data.size(), ring_.size() - start );
+  copy_n( data.begin(), first, ring_.begin() + static_cast<ptrdiff_t>( start ) );
+  copy( data.begin() + static_cast<ptrdiff_t>( first ), data.end(), ring_.begin() );
+}
+
+void BitmapStore::flush( Writer& writer )
+{
+  // Bytes pushed straight through since the last flush may also have been stored; forget them
+  const uint64_t pushed = writer.bytes_pushed();
+  bytes_pending_ -= mark( next_, min( pushed - next_, ring_.size() ), false );
+  next_ = pushed;
+
+  uint64_t ready = run_length( next_, bytes_pending_ );
+  while ( ready > 0 ) {
+    const auto region = writer.writable_region();
+    const uint64_t len = min( ready, region.size() );
+    if ( len == 0 ) {
+      return;
+    }
+    copy_out( next_, region.first( len ) );
+    writer.commit( len );
+    bytes_pending_ -= mark( next_, len, false );
+    next_ += len;
+    ready -= len;
+  }
+}
+
+vector<pair<uint64_t, uint64_t>> BitmapStore::held_ranges() const
+{
+  vector<pair<uint64_t, uint64_t>> ranges;
+  uint64_t held = 0;
+  uint64_t index = next_;
+  const uint64_t end = next_ + ring_.size();
+  while ( held < bytes_pending_ and index < end ) {
+    // skip the gap a word at a time (the bits past the end of the ring are always clear)
+    const uint64_t begin = slot( index );
+    const uint64_t word = present_[begin / kWordBits] >> ( begin % kWordBits );
+    if ( word == 0 ) {
+      index += min( kWordBits - begin % kWordBits, ring_.size() - begin );
+      continue;
+    }
+    index += static_cast<uint64_t>( countr_zero( word ) );
+
+    const uint64_t run = run_length( index, end - index );
+    ranges.emplace_back( index, index + run );
+    held += run;
+    index += run;
+  }
+  return ranges;
+}
+
+void BitmapStore::resize( uint64_t capacity )
+{
+  if ( capacity == ring_.size() ) {
+    return;
+  }
+  BitmapStore resized { capacity, next_ };
+  for ( const auto& [first, end] : held_ranges() ) {
+    string data( end - first, 0 );
+    copy_out( first, data );
+    resized.store( first, move( data ) );
+  }
+  *this = move( resized );
+}
+
+uint64_t BitmapStore::mark( uint64_t index, uint64_t len, bool present )
+{
+  uint64_t changed = 0;
+  while ( len > 0 ) {
+    const uint64_t begin = slot( index );
+    const uint64_t n = min( len, ring_.size() - begin );
+    changed += mark_slots( begin, begin + n, present );
+    index += n;
+    len -= n;
+  }
+  return changed;
+}
+
+uint64_t BitmapStore::mark_slots( uint64_t begin, uint64_t end, bool present )
+{
+  uint64_t changed = 0;
+  for ( uint64_t bit = begin; bit < end; ) {
+    const uint64_t offset = bit % kWordBits;
+    const uint64_t n = min( kWordBits - offset, end - bit );
+    const uint64_t mask = ( n == kWordBits ? kAllPresent : ( uint64_t { 1 } << n ) - 1 ) << offset;
+    uint64_t& word = present_[bit / kWordBits];
+    if ( present ) {
+      changed += popcount( mask & ~word );
+      word |= mask;
+    } else {
+      changed += popcount( mask & word );
+      word &= ~mask;
+    }
+    bit += n;
+  }
+  return changed;
+}
+
+uint64_t BitmapStore::run_length( uint64_t index, uint64_t max_len ) const
+{
+  uint64_t run = 0;
+  while ( run < max_len ) {
+    const uint64_t begin = slot( index + run );
+    const uint64_t n = min( max_len - run, ring_.size() - begin );
+    const uint64_t found = run_in_slots( begin, begin + n );
+    run += found;
+    if ( found < n ) {
+      break;
+    }
+  }
+  return run;
+}
+
+uint64_t BitmapStore::run_in_slots( uint64_t begin, uint64_t end ) const
+{
+  uint64_t bit = begin;
+
+  // the rest of the first word (shifting brings in zeros, so the count stops at the word's end)
+  if ( bit % kWordBits != 0 ) {
+    const uint64_t offset = bit % kWordBits;
+    const auto ones = static_cast<uint64_t>( countr_one( present_[bit / kWordBits] >> offset ) );
+    bit += ones;
+    if ( ones < kWordBits - offset ) {
+      return min( bit, end ) - begin;
+    }
+  }
+
+  // whole words, then the part of the word where the run stops
+  if ( bit < end ) {
+    bit += kWordBits * word_scan()( &present_[bit / kWordBits], ( end - bit ) / kWordBits );
+    if ( bit < end ) {
+      bit += static_cast<uint64_t>( countr_one( present_[bit / kWordBits] ) );
+    }
+  }
+  return min( bit, end ) - begin;
+}
+
+void BitmapStore::copy_out( uint64_t index, span<char> out ) const
+{
+  const uint64_t start = slot( index );
+  const uint64_t first = min( out.size(), ring_.size() - start );
+  copy_n( ring_.begin() + static_cast<ptrdiff_t>( start ), first, out.begin() );
+  copy_n( ring_.begin(), out.size() - first, out.begin() + static_cast<ptrdiff_t>( first ) );
+}
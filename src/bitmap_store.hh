@@ -0,0 +1,56 @@
+#pragma once
+
+#include "byte_stream.hh"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Reassembler storage that copies out-of-order bytes straight into a ring the size of the
+// stream's capacity, at the slot their stream index maps to, and records which slots hold a
+// byte in a bitmap (one bit per slot). Memory is fixed at capacity + capacity/8 bytes and
+// storing a substring never allocates. The Reassembler's window never spans more than
+// `capacity` indices, so two bytes it can store never share a slot.
+//
+// Finding the end of the bytes that have become writable is a scan for the first clear bit,
+// done a vector of bitmap words at a time (AVX2 when the CPU has it, else SSE2 on x86-64, else
+// one word at a time).
+class BitmapStore
+{
+public:
+  BitmapStore( uint64_t capacity, uint64_t next_index );
+
+  // Keep a substring that starts after the writer's next byte and ends inside its window
+  void store( uint64_t first_index, std::string data );
+  void flush( Writer& writer ); // push stored bytes that have become writable
+  uint64_t bytes_pending() const { return bytes_pending_; }
+  std::vector<std::pair<uint64_t, uint64_t>> held_ranges() const; // [first, end) of each run of stored bytes
+
+  // Reallocate the ring and bitmap for a new capacity, moving the stored bytes to their new slots (caller
+  // guarantees they all lie within `capacity` indices of the writer's next byte)
+  void resize( uint64_t capacity );
+
+  // Use the vector scan when the CPU has one (the default), or force the one-word-at-a-time scan
+  static void use_vector_scan( bool enabled );
+
+private:
+  std::vector<char> ring_;
+  std::vector<uint64_t> present_; // bit i is set when ring_[i] holds a stored byte
+  uint64_t next_;                 // stream index of the first byte not yet pushed, as of the last flush
+  uint64_t bytes_pending_ {};     // number of set bits in present_
+
+  uint64_t slot( uint64_t index ) const { return index % ring_.size(); }
+
+  // Set or clear the bits of the `len` slots from stream index `index` (len <= capacity);
+  // returns how many bits changed
+  uint64_t mark( uint64_t index, uint64_t len, bool present );
+  uint64_t mark_slots( uint64_t begin, uint64_t end, bool present ); // slots [begin, end), no wraparound
+
+  // How many stored bytes run on without a gap from stream index `index`, up to max_len (<= capacity)
+  uint64_t run_length( uint64_t index, uint64_t max_len ) const;
+  uint64_t run_in_slots( uint64_t begin, uint64_t end ) const; // slots [begin, end), no wraparound
+
+  void copy_out( uint64_t index, std::span<char> out ) const; // the stored bytes from stream index `index`
+};
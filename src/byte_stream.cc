@@ -1,94 +1,283 @@
 #include "byte_stream.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
 
-inline uint64_t abs_u64( uint64_t a, uint64_t b )
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+using StorageVariant = variant<RingBuffer, ChunkQueue, MirroredBuffer, PagedBuffer, SpscRing>;
+
+StorageVariant make_storage( uint64_t capacity, ByteStream::Storage storage )
 {
-  return ( a > b ) ? ( a - b ) : ( b - a );
+  switch ( storage ) {
+    case ByteStream::Storage::Ring:
+      return RingBuffer { capacity };
+    case ByteStream::Storage::Chunked:
+      return ChunkQueue {};
+    case ByteStream::Storage::Mirrored:
+      return MirroredBuffer { capacity };
+    case ByteStream::Storage::Paged:
+      return PagedBuffer {};
+    case ByteStream::Storage::Spsc:
+      return SpscRing { capacity };
+  }
+  throw invalid_argument( "unknown ByteStream::Storage" );
 }
+} // namespace
 
-using namespace std;
+ByteStream::ByteStream( uint64_t capacity, Storage storage )
+  : capacity_( capacity ), buf_( make_storage( capacity, storage ) )
+{}
+
+struct ByteStream::Wakeups
+{
+  FileDescriptor readable { CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) };
+  FileDescriptor writable { CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) };
+  atomic<bool> reader_armed {};
+  atomic<bool> writer_armed {};
+};
+
+namespace {
+// Arm a wakeup unless `ready` (re-checked after arming) says there is no need to sleep.
+// The seq_cst fences pair with the one in notify(): either the sleeper sees the other
+// side's progress here, or the other side sees the armed flag and signals the event.
+bool arm( atomic<bool>& armed, const auto& ready )
+{
+  armed.store( true, memory_order_relaxed );
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( ready() ) {
+    armed.store( false, memory_order_relaxed );
+    return false;
+  }
+  return true;
+}
+
+void notify( atomic<bool>& armed, FileDescriptor& event )
+{
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( armed.load( memory_order_relaxed ) ) {
+    armed.store( false, memory_order_relaxed );
+    const uint64_t one = 1;
+    event.write( { reinterpret_cast<const char*>( &one ), sizeof( one ) } ); // NOLINT(*-reinterpret-cast)
+  }
+}
+} // namespace
+
+void ByteStream::enable_wakeups()
+{
+  if ( not wakeups_ ) {
+    wakeups_ = make_shared<Wakeups>();
+  }
+}
+
+ByteStream::Wakeups& ByteStream::wakeups()
+{
+  if ( not wakeups_ ) {
+    throw runtime_error( "ByteStream: enable_wakeups() was not called" );
+  }
+  return *wakeups_;
+}
 
-ByteStream::ByteStream( uint64_t capacity )
-  : capacity_( capacity )
-  , available_capacity_( capacity )
-  , buf_start_( 0 )
-  , buf_end_( 0 )
-  , byte_popped_( 0 )
-  , byte_pushed_( 0 )
-  , eof_( false )
+FileDescriptor& ByteStream::readable_event()
 {
-  buf_.resize( capacity_ );
+  return wakeups().readable;
+}
+
+FileDescriptor& ByteStream::writable_event()
+{
+  return wakeups().writable;
+}
+
+void ByteStream::wake_reader()
+{
+  if ( wakeups_ ) {
+    notify( wakeups_->reader_armed, wakeups_->readable );
+  }
+}
+
+void ByteStream::wake_writer()
+{
+  if ( wakeups_ ) {
+    notify( wakeups_->writer_armed, wakeups_->writable );
+  }
 }
 
 bool Writer::is_closed() const
 {
-  return eof_;
+  return eof_.load();
 }
 
 void Writer::push( string data )
 {
-  if ( eof_ )
+  if ( eof_.load() )
+    return;
+
+  const uint64_t len = min( data.size(), available_capacity() );
+  if ( !len )
     return;
 
-  uint64_t len = min( data.size(), available_capacity() );
+  // Truncating in place avoids a copy, but keeps the whole allocation, which Chunked storage holds on to:
+  // a prefix of less than half of it is copied out instead
+  if ( len < data.size() and len * 2 < data.capacity() ) {
+    data = data.substr( 0, len );
+  } else {
+    data.resize( len );
+  }
+  visit( [&]( auto& buf ) { buf.push( move( data ) ); }, buf_ );
+  byte_pushed_.advance( len );
+  wake_reader();
+}
+
+void Writer::set_capacity( uint64_t capacity )
+{
+  capacity = max( capacity, reader().bytes_buffered() );
+  visit( [&]( auto& buf ) { buf.resize( capacity ); }, buf_ );
+  capacity_ = capacity;
+}
+
+span<char> Writer::writable_region()
+{
+  if ( eof_.load() )
+    return {};
+
+  return visit( [&]( auto& buf ) { return buf.writable_region( available_capacity() ); }, buf_ );
+}
+
+void Writer::commit( uint64_t len )
+{
+  len = eof_.load() ? 0 : min( len, available_capacity() );
+
+  // always commit, even nothing, so that storage set aside for the region is released
+  visit( [&]( auto& buf ) { buf.commit( len ); }, buf_ );
   if ( !len )
     return;
 
-  for ( uint64_t i = 0; i < len; i++ ) {
-    buf_[buf_end_] = data[i];
-    buf_end_ = ( buf_end_ + 1 ) % capacity_;
+  byte_pushed_.advance( len );
+  wake_reader();
+}
+
+uint64_t Writer::read_from( FileDescriptor& fd )
+{
+  if ( eof_.load() )
+    return 0;
+
+  vector<span<char>> regions;
+  const uint64_t max_len = min( available_capacity(), READ_BATCH );
+  visit( [&]( auto& buf ) { buf.writable_regions( max_len, regions ); }, buf_ );
+  if ( regions.size() > IOV_MAX )
+    regions.resize( IOV_MAX );
+
+  uint64_t len = 0;
+  try {
+    len = regions.empty() ? 0 : fd.read( regions );
+  } catch ( ... ) {
+    visit( []( auto& buf ) { buf.commit( 0 ); }, buf_ ); // give back any pages taken for the regions
+    throw;
   }
 
-  available_capacity_ -= len;
-  byte_pushed_ += len;
+  // always commit, even nothing, so that storage set aside for the regions is released
+  visit( [&]( auto& buf ) { buf.commit( len ); }, buf_ );
+  byte_pushed_.advance( len );
+  wake_reader();
+  return len;
 }
 
 void Writer::close()
 {
-  eof_ = true;
+  eof_.store( true );
+  wake_reader();
+}
+
+bool Writer::arm_wakeup()
+{
+  return arm( wakeups().writer_armed, [&] { return available_capacity() > 0 or is_closed() or has_error(); } );
 }
 
 uint64_t Writer::available_capacity() const
 {
-  return available_capacity_;
+  const uint64_t capacity_left = capacity_ - reader().bytes_buffered();
+  if ( const auto* paged = get_if<PagedBuffer>( &buf_ ) ) {
+    return min( capacity_left, paged->headroom() ); // the shared page pool may be close to its memory limit
+  }
+  return capacity_left;
 }
 
 uint64_t Writer::bytes_pushed() const
 {
-  return byte_pushed_;
+  return byte_pushed_.load();
 }
 
 // string closed and fully popped
 bool Reader::is_finished() const
 {
-  return eof_ && bytes_buffered() == 0;
+  return eof_.load() && bytes_buffered() == 0;
 }
 
 uint64_t Reader::bytes_popped() const
 {
-  return byte_popped_;
+  return byte_popped_.load();
 }
 
 string_view Reader::peek() const
 {
-  if ( bytes_buffered() == 0 )
-    return std::string_view {}; // nothing in buf
+  return visit( []( const auto& buf ) { return buf.peek(); }, buf_ );
+}
+
+span<const string_view> Reader::peek_all( uint64_t max_len ) const
+{
+  peeked_.clear();
+  visit( [&]( const auto& buf ) { buf.peek_all( max_len, peeked_ ); }, buf_ );
+  return peeked_;
+}
 
-  return std::string_view( &buf_[buf_start_], 1 );
+span<const string_view> Reader::peek_range( uint64_t offset, uint64_t len ) const
+{
+  peeked_.clear();
+  const uint64_t buffered = bytes_buffered();
+  offset = min( offset, buffered );
+  len = min( len, buffered - offset );
+  if ( len > 0 ) {
+    visit( [&]( const auto& buf ) { buf.peek_range( offset, len, peeked_ ); }, buf_ );
+  }
+  return peeked_;
 }
 
 // reader consume from buffer
 void Reader::pop( uint64_t len )
 {
-  if ( bytes_buffered() == 0 )
+  len = min( bytes_buffered(), len );
+  if ( !len )
     return;
 
-  len = min( bytes_buffered(), len );
-  buf_start_ = ( buf_start_ + len ) % capacity_;
-  byte_popped_ += len;
-  available_capacity_ += len;
+  visit( [&]( auto& buf ) { buf.pop( len ); }, buf_ );
+  byte_popped_.advance( len );
+  wake_writer();
+}
+
+uint64_t Reader::write_to( FileDescriptor& fd )
+{
+  if ( !bytes_buffered() )
+    return 0;
+
+  auto buffers = peek_all();
+  const uint64_t len = fd.write( buffers.first( min<size_t>( buffers.size(), IOV_MAX ) ) );
+  pop( len );
+  return len;
+}
+
+bool Reader::arm_wakeup()
+{
+  return arm( wakeups().reader_armed, [&] { return bytes_buffered() > 0 or is_finished() or has_error(); } );
 }
 
 uint64_t Reader::bytes_buffered() const
 {
-  return capacity_ - available_capacity_;
-}
\ No newline at end of file
+  return byte_pushed_.load() - byte_popped_.load();
+}
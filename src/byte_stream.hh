@@ -1,17 +1,43 @@
 #pragma once
 
+#include "atomic_cell.hh"
+#include "chunk_queue.hh"
+#include "mirrored_buffer.hh"
+#include "paged_buffer.hh"
+#include "ring_buffer.hh"
+#include "spsc_ring.hh"
+
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
 #include <string_view>
+#include <variant>
 #include <vector>
 
 class Reader;
 class Writer;
+class FileDescriptor;
 
 class ByteStream
 {
 public:
-  explicit ByteStream( uint64_t capacity );
+  // How the buffered bytes are stored:
+  //   Ring:     fixed circular buffer of `capacity` bytes, allocated up front; pushes copy bytes in
+  //   Chunked:  pushed strings are moved in as owned chunks; peek() returns the whole front chunk
+  //   Mirrored: circular buffer mapped twice back to back; peek() returns every buffered byte
+  //   Paged:    pages taken from the process-wide PagePool on demand and returned as they drain
+  //   Spsc:     like Ring, but the Writer and the Reader may be used from two different threads at once
+  enum class Storage : uint8_t
+  {
+    Ring,
+    Chunked,
+    Mirrored,
+    Paged,
+    Spsc,
+  };
+
+  explicit ByteStream( uint64_t capacity, Storage storage = Storage::Chunked );
 
   // Helper functions (provided) to access the ByteStream's Reader and Writer interfaces
   Reader& reader();
@@ -19,20 +45,39 @@ public:
   Writer& writer();
   const Writer& writer() const;
 
-  void set_error() { error_ = true; };       // Signal that the stream suffered an error.
-  bool has_error() const { return error_; }; // Has the stream had an error?
+  void set_error() { error_.store( true ); };       // Signal that the stream suffered an error.
+  bool has_error() const { return error_.load(); }; // Has the stream had an error?
+
+  Storage storage() const { return static_cast<Storage>( buf_.index() ); }
+  uint64_t capacity() const { return capacity_; } // Most bytes the stream ever buffers at once
+
+  // Optional wakeups for a Spsc stream shared between two threads; enable them before the stream is
+  // shared. Before sleeping, a side calls arm_wakeup() on its Reader or Writer; if that returns true
+  // it may block until its event fd is readable (and should then read the fd to reset it). The other
+  // side signals the event the next time it makes progress: the Writer after pushing or closing,
+  // the Reader after popping.
+  void enable_wakeups();
+  FileDescriptor& readable_event(); // for the Reader: bytes arrived or the stream was closed
+  FileDescriptor& writable_event(); // for the Writer: capacity was freed
 
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
+  // Everything the two sides share is an AtomicCell, so a Spsc stream can be used from two threads;
+  // the counters each writer thread bumps live on their own cache lines.
   uint64_t capacity_;
-  uint64_t available_capacity_;
-  bool error_ {};
-  std::vector<char> buf_ {};
-  uint64_t buf_start_;
-  uint64_t buf_end_;
-  uint64_t byte_popped_;
-  uint64_t byte_pushed_;
-  bool eof_;
+  AtomicCell<bool> error_ {};
+  // one alternative per Storage, in the same order
+  std::variant<RingBuffer, ChunkQueue, MirroredBuffer, PagedBuffer, SpscRing> buf_;
+  alignas( kCacheLineSize ) AtomicCell<uint64_t> byte_popped_ {};
+  alignas( kCacheLineSize ) AtomicCell<uint64_t> byte_pushed_ {};
+  AtomicCell<bool> eof_ {};
+  mutable std::vector<std::string_view> peeked_ {}; // storage for the views returned by Reader::peek_all()
+
+  struct Wakeups;
+  std::shared_ptr<Wakeups> wakeups_ {};
+  Wakeups& wakeups(); // throws unless enable_wakeups() was called
+  void wake_reader();
+  void wake_writer();
 };
 
 class Writer : public ByteStream
@@ -41,6 +86,26 @@ public:
   void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
   void close();                  // Signal that the stream has reached its ending. Nothing more will be written.
 
+  // Direct writes: fill (a prefix of) the writable region in place, then commit() the bytes written.
+  // The region is contiguous and at most available_capacity() long; it is empty once the stream is closed.
+  std::span<char> writable_region();
+  void commit( uint64_t len ); // Push the first `len` bytes of the last writable_region()
+
+  // Read from `fd` straight into the stream's free space with a single readv (no intermediate string), at
+  // most READ_BATCH bytes of it: one read rarely returns more, and Paged storage takes pages only for those.
+  // Returns the number of bytes pushed; the stream is not closed when `fd` reaches EOF.
+  static constexpr uint64_t READ_BATCH = 64 * 1024;
+  uint64_t read_from( FileDescriptor& fd );
+
+  // Change how many bytes the stream may buffer at once, but never to fewer than are buffered now. Ring
+  // storage is reallocated to the new capacity; Mirrored and Spsc storage cannot grow past the capacity it
+  // was made with (throws), and a Spsc stream's capacity must not change while another thread uses it.
+  void set_capacity( uint64_t capacity );
+
+  // Ask for writable_event() once capacity is freed. Returns false, without arming, if there is
+  // already capacity (or the stream is closed or errored), in which case the caller should not sleep.
+  bool arm_wakeup();
+
   bool is_closed() const;              // Has the stream been closed?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
   uint64_t bytes_pushed() const;       // Total number of bytes cumulatively pushed to the stream
@@ -52,6 +117,22 @@ public:
   std::string_view peek() const; // Peek at the next bytes in the buffer
   void pop( uint64_t len );      // Remove `len` bytes from the buffer
 
+  // Peek at every buffered byte at once, as one view per contiguous region, in order. Given `max_len`,
+  // stops after the regions covering the first `max_len` bytes. The views are valid until the next
+  // push or pop. pop() takes any length, so bytes consumed across several views go in a single call.
+  std::span<const std::string_view> peek_all( uint64_t max_len = UINT64_MAX ) const;
+
+  // Peek at the `len` bytes that start `offset` bytes past the front (clamped to those buffered), as one
+  // view per contiguous region, without walking the bytes before them. Valid until the next push or pop.
+  std::span<const std::string_view> peek_range( uint64_t offset, uint64_t len ) const;
+
+  // Ask for readable_event() once bytes arrive. Returns false, without arming, if there are already
+  // bytes to read (or the stream is finished or errored), in which case the caller should not sleep.
+  bool arm_wakeup();
+
+  // Write the buffered bytes to `fd` with a single writev and pop what was written. Returns bytes popped.
+  uint64_t write_to( FileDescriptor& fd );
+
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
   uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
   uint64_t bytes_popped() const;   // Total number of bytes cumulatively popped from stream
@@ -61,4 +142,4 @@ public:
  * read: A (provided) helper function thats peeks and pops up to `len` bytes
  * from a ByteStream Reader into a string;
  */
-void read( Reader& reader, uint64_t len, std::string& out );
\ No newline at end of file
+void read( Reader& reader, uint64_t len, std::string& out );
@@ -1,5 +1,6 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <stdexcept>
 
@@ -12,18 +13,22 @@ using namespace std;
 void read( Reader& reader, uint64_t max_len, string& out )
 {
   out.clear();
+  out.reserve( min( max_len, reader.bytes_buffered() ) );
 
-  while ( reader.bytes_buffered() and out.size() < max_len ) {
-    auto view = reader.peek();
+  for ( auto view : reader.peek_all( max_len ) ) {
+    if ( out.size() == max_len ) {
+      break;
+    }
 
     if ( view.empty() ) {
-      throw runtime_error( "Reader::peek() returned empty string_view" );
+      throw runtime_error( "Reader::peek_all() returned empty string_view" );
     }
 
     view = view.substr( 0, max_len - out.size() ); // Don't return more bytes than desired.
     out += view;
-    reader.pop( view.size() );
   }
+
+  reader.pop( out.size() );
 }
 
 Reader& ByteStream::reader()
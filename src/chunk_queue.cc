@@ -0,0 +1,79 @@
+#include "chunk_queue.hh"
+
+using namespace std;
+
+void ChunkQueue::push( string data )
+{
+  if ( not data.empty() ) {
+    chunks_.push_back( move( data ) );
+  }
+}
+
+string_view ChunkQueue::peek() const
+{
+  if ( chunks_.empty() ) {
+    return {};
+  }
+  return string_view { chunks_.front() }.substr( front_offset_ );
+}
+
+void ChunkQueue::pop( uint64_t len )
+{
+  while ( len > 0 ) {
+    const uint64_t remaining = chunks_.front().size() - front_offset_;
+    if ( len < remaining ) {
+      front_offset_ += len;
+      return;
+    }
+    len -= remaining;
+    chunks_.pop_front();
+    front_offset_ = 0;
+  }
+}
+
+span<char> ChunkQueue::writable_region( uint64_t max_len )
+{
+  // the staging buffer outlives each commit, so it is zero-filled only as it grows
+  if ( staging_.size() < max_len ) {
+    staging_.resize( max_len );
+  }
+  return span { staging_ }.first( max_len );
+}
+
+void ChunkQueue::peek_all( uint64_t max_len, vector<string_view>& out ) const
+{
+  uint64_t offset = front_offset_;
+  for ( auto it = chunks_.begin(); it != chunks_.end() and max_len > 0; ++it ) {
+    out.push_back( string_view { *it }.substr( offset ) );
+    max_len -= min( max_len, out.back().size() );
+    offset = 0;
+  }
+}
+
+void ChunkQueue::peek_range( uint64_t offset, uint64_t len, vector<string_view>& out ) const
+{
+  offset += front_offset_;
+  for ( auto it = chunks_.begin(); it != chunks_.end() and len > 0; ++it ) {
+    if ( offset >= it->size() ) {
+      offset -= it->size();
+      continue;
+    }
+    out.push_back( string_view { *it }.substr( offset, len ) );
+    len -= out.back().size();
+    offset = 0;
+  }
+}
+
+void ChunkQueue::writable_regions( uint64_t max_len, vector<span<char>>& out )
+{
+  const auto region = writable_region( max_len );
+  if ( not region.empty() ) {
+    out.push_back( region );
+  }
+}
+
+void ChunkQueue::commit( uint64_t len )
+{
+  // a chunk of just the bytes written, rather than a buffer as large as the region handed out
+  push( staging_.substr( 0, len ) );
+}
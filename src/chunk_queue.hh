@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Queue of owned strings, moved in as they were pushed (no byte copies).
+// peek() returns the unpopped remainder of the front chunk.
+class ChunkQueue
+{
+public:
+  void push( std::string data );
+  std::string_view peek() const;
+  void pop( uint64_t len ); // caller guarantees len <= bytes buffered
+
+  std::span<char> writable_region( uint64_t max_len ); // staging space, copied into a new chunk on commit()
+  void commit( uint64_t len ); // caller guarantees len <= writable_region().size()
+
+  // Append the buffered chunks covering max_len bytes / the one staging region of writable_region()
+  void peek_all( uint64_t max_len, std::vector<std::string_view>& out ) const;
+  void writable_regions( uint64_t max_len, std::vector<std::span<char>>& out );
+  // Append the pieces of chunks holding `len` bytes from `offset` past the front, walking the chunks before them
+  // (caller guarantees offset + len <= bytes buffered)
+  void peek_range( uint64_t offset, uint64_t len, std::vector<std::string_view>& out ) const;
+
+  void resize( uint64_t /*capacity*/ ) {} // chunks are allocated as they are pushed, whatever the capacity
+
+private:
+  std::deque<std::string> chunks_ {};
+  uint64_t front_offset_ {}; // bytes already popped from chunks_.front()
+  std::string staging_ {};   // space handed out by writable_region(), reused from one commit to the next
+};
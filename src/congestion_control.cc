@@ -0,0 +1,50 @@
+#include "congestion_control.hh"
+#include "bbr.hh"
+#include "cubic.hh"
+#include "new_reno.hh"
+
+using namespace std;
+
+namespace {
+// No congestion window: only the receiver's window limits the sender
+class Unlimited : public CongestionControl
+{
+public:
+  Algorithm algorithm() const override { return Algorithm::None; }
+  uint64_t cwnd() const override { return UINT64_MAX; }
+  uint64_t ssthresh() const override { return UINT64_MAX; }
+  void on_ack( const Event& /*unused*/ ) override {}
+  void on_loss( const Event& /*unused*/ ) override {}
+  void on_timeout( const Event& /*unused*/ ) override {}
+};
+} // namespace
+
+unique_ptr<CongestionControl> CongestionControl::make( Algorithm algorithm, uint64_t mss )
+{
+  switch ( algorithm ) {
+    case Algorithm::NewReno:
+      return make_unique<NewReno>( mss );
+    case Algorithm::Cubic:
+      return make_unique<Cubic>( mss );
+    case Algorithm::Bbr:
+      return make_unique<Bbr>( mss );
+    case Algorithm::None:
+      break;
+  }
+  return make_unique<Unlimited>();
+}
+
+string_view CongestionControl::name( Algorithm algorithm )
+{
+  switch ( algorithm ) {
+    case Algorithm::NewReno:
+      return "NewReno";
+    case Algorithm::Cubic:
+      return "Cubic";
+    case Algorithm::Bbr:
+      return "BBR";
+    case Algorithm::None:
+      break;
+  }
+  return "None";
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+// Decides how many sequence numbers the TCPSender may have in flight: the congestion window.
+// The sender reports ACKs, losses and timeouts, and never has more than min(cwnd, receive window)
+// outstanding.
+class CongestionControl
+{
+public:
+  // Which controller to use:
+  //   None:    no congestion window; the sender is limited only by the receiver's window
+  //   NewReno: slow start and congestion avoidance (RFC 5681), NewReno fast recovery (RFC 6582)
+  //   Cubic:   CUBIC window growth after a loss (RFC 9438), never slower than Reno would be
+  //   Bbr:     BBR: models the path's bottleneck bandwidth and round-trip time, and paces to match
+  enum class Algorithm : uint8_t
+  {
+    None,
+    NewReno,
+    Cubic,
+    Bbr,
+  };
+
+  // What the sender knows when it reports an event. Sequence numbers are absolute.
+  struct Event
+  {
+    uint64_t now_us {};                // the sender's clock: total time passed to tick()
+    uint64_t ackno {};                 // highest ackno received
+    uint64_t next_seqno {};            // next sequence number the sender will use
+    uint64_t in_flight {};             // sequence numbers outstanding after the event
+    uint64_t newly_acked {};           // sequence numbers acknowledged for the first time by this ACK
+    std::optional<uint64_t> rtt_us {}; // round-trip time of a segment this ACK covered, if never resent
+    uint64_t srtt_us {};               // smoothed round-trip time, or 0 before the first sample
+    uint64_t delivery_rate {};         // sequence numbers acknowledged per second, or 0 if not measured
+    bool sack {};                      // SACK recovery: cwnd limits the pipe (RFC 6675), so is never inflated
+  };
+
+  // A controller for segments of at most `mss` bytes
+  static std::unique_ptr<CongestionControl> make( Algorithm algorithm, uint64_t mss );
+  static std::string_view name( Algorithm algorithm );
+
+  virtual Algorithm algorithm() const = 0;
+  virtual uint64_t cwnd() const = 0;     // congestion window, in sequence numbers
+  virtual uint64_t ssthresh() const = 0; // slow start threshold, in sequence numbers
+  // Sequence numbers per second the sender should spread its segments out to, or 0 not to pace
+  virtual uint64_t pacing_rate() const { return 0; }
+
+  virtual void on_ack( const Event& event ) = 0;     // an ACK arrived (newly_acked is 0 for a duplicate ACK)
+  virtual void on_loss( const Event& event ) = 0;    // a loss was detected without a timeout
+  virtual void on_timeout( const Event& event ) = 0; // the retransmission timer expired
+
+  virtual ~CongestionControl() = default;
+};
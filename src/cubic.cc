@@ -0,0 +1,57 @@
+#include "cubic.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+double Cubic::w_cubic( double t ) const
+{
+  return kC * pow( t - k_, 3 ) + w_max_;
+}
+
+void Cubic::congestion_avoidance( const Event& event )
+{
+  const double cwnd = segments( cwnd_ );
+
+  // The first ACK in congestion avoidance after a congestion event starts a new epoch
+  if ( not epoch_started_ ) {
+    epoch_started_ = true;
+    epoch_start_us_ = event.now_us;
+    if ( after_timeout_ or cwnd >= w_max_ ) {
+      w_max_ = cwnd;
+      k_ = 0;
+    } else {
+      k_ = cbrt( ( w_max_ - cwnd ) / kC );
+    }
+    w_est_ = cwnd;
+  }
+
+  // Reno-friendly estimate: grows by alpha segments per RTT, or one once it has passed w_max_
+  const double alpha = w_est_ >= w_max_ ? 1.0 : 3 * ( 1 - kBeta ) / ( 1 + kBeta );
+  w_est_ += alpha * segments( event.newly_acked ) / cwnd;
+
+  const double t = static_cast<double>( event.now_us - epoch_start_us_ ) / 1e6;
+  if ( w_cubic( t ) < w_est_ ) {
+    cwnd_ = max( cwnd_, static_cast<uint64_t>( w_est_ * static_cast<double>( mss_ ) ) );
+    return;
+  }
+
+  // Concave or convex region: close (target - cwnd) / cwnd of the gap on each ACK, aiming one RTT ahead
+  const double rtt = static_cast<double>( event.srtt_us ) / 1e6;
+  const double target = clamp( w_cubic( t + rtt ), cwnd, 1.5 * cwnd );
+  cwnd_ += static_cast<uint64_t>( ( target - cwnd ) / cwnd * static_cast<double>( mss_ ) );
+}
+
+void Cubic::reduce( const Event& event, bool timeout )
+{
+  // After a timeout, the next epoch takes w_max_ from cwnd when it starts
+  if ( not timeout ) {
+    const double cwnd = segments( cwnd_ );
+    // fast convergence: a flow whose window keeps shrinking gives up bandwidth sooner
+    w_max_ = cwnd < w_max_ ? cwnd * ( 1 + kBeta ) / 2 : cwnd;
+  }
+  ssthresh_ = max( static_cast<uint64_t>( static_cast<double>( event.in_flight ) * kBeta ), 2 * mss_ );
+  epoch_started_ = false;
+  after_timeout_ = timeout;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "new_reno.hh"
+
+// CUBIC (RFC 9438): after a congestion event, cwnd follows a cubic function of the time since
+// congestion avoidance resumed, flattening out near the window where the loss happened. It never
+// grows more slowly than an estimate of what Reno would reach. Slow start and fast recovery are NewReno's.
+//
+// Each ACK moves cwnd toward W_cubic(t + SRTT), where the window should be one round trip from now.
+class Cubic : public NewReno
+{
+public:
+  static constexpr double kC = 0.4;    // scaling constant, in segments per second cubed
+  static constexpr double kBeta = 0.7; // multiplicative decrease factor
+
+  using NewReno::NewReno;
+
+  Algorithm algorithm() const override { return Algorithm::Cubic; }
+  double w_max() const { return w_max_; } // in segments
+  double k() const { return k_; }         // in seconds
+
+protected:
+  void congestion_avoidance( const Event& event ) override;
+  void reduce( const Event& event, bool timeout ) override;
+
+private:
+  double segments( uint64_t bytes ) const { return static_cast<double>( bytes ) / static_cast<double>( mss_ ); }
+  double w_cubic( double t ) const;
+
+  double w_max_ {};            // cwnd just before the last congestion event, in segments
+  double k_ {};                // time for W_cubic to grow back to w_max_, in seconds
+  double w_est_ {};            // the Reno-friendly estimate, in segments
+  bool epoch_started_ {};      // has congestion avoidance resumed since the last congestion event?
+  bool after_timeout_ {};      // was the last congestion event a timeout?
+  uint64_t epoch_start_us_ {}; // when congestion avoidance resumed
+};
@@ -0,0 +1,73 @@
+#include "interval_store.hh"
+
+#include <iterator>
+
+using namespace std;
+
+void IntervalStore::store( uint64_t first_index, string data )
+{
+  uint64_t end = first_index + data.size();
+
+  // Trim the front against the substring stored just before, if it reaches this far
+  auto it = pending_.upper_bound( first_index );
+  if ( it != pending_.begin() ) {
+    const auto& [prev_index, prev_data] = *prev( it );
+    const uint64_t prev_end = prev_index + prev_data.size();
+    if ( prev_end >= end ) {
+      return; // already have every byte
+    }
+    if ( prev_end > first_index ) {
+      data.erase( 0, prev_end - first_index );
+      first_index = prev_end;
+    }
+  }
+
+  // Drop the substrings this one covers, and trim its back against one that sticks out
+  while ( it != pending_.end() and it->first < end ) {
+    const uint64_t it_end = it->first + it->second.size();
+    if ( it_end > end ) {
+      data.resize( it->first - first_index );
+      end = it->first;
+      break;
+    }
+    bytes_pending_ -= it->second.size();
+    it = pending_.erase( it );
+  }
+
+  bytes_pending_ += data.size();
+  pending_.emplace_hint( it, first_index, move( data ) );
+}
+
+vector<pair<uint64_t, uint64_t>> IntervalStore::held_ranges() const
+{
+  vector<pair<uint64_t, uint64_t>> ranges;
+  for ( const auto& [index, data] : pending_ ) {
+    if ( not ranges.empty() and ranges.back().second == index ) {
+      ranges.back().second += data.size(); // substrings that touch make one run
+    } else {
+      ranges.emplace_back( index, index + data.size() );
+    }
+  }
+  return ranges;
+}
+
+void IntervalStore::flush( Writer& writer )
+{
+  while ( not pending_.empty() ) {
+    auto it = pending_.begin();
+    const uint64_t next = writer.bytes_pushed();
+    if ( it->first > next ) {
+      return;
+    }
+
+    auto& [index, data] = *it;
+    bytes_pending_ -= data.size();
+    if ( index + data.size() > next ) {
+      if ( index < next ) {
+        data.erase( 0, next - index );
+      }
+      writer.push( move( data ) );
+    }
+    pending_.erase( it );
+  }
+}
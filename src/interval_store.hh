@@ -0,0 +1,27 @@
+#pragma once
+
+#include "byte_stream.hh"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Reassembler storage that keeps each out-of-order substring as its own string, keyed by first
+// index. Stored substrings never overlap, so a new one only has to be trimmed against its
+// neighbours. Memory follows what is actually stored; each stored substring is a heap allocation.
+class IntervalStore
+{
+public:
+  // Keep a substring that starts after the writer's next byte and ends inside its window
+  void store( uint64_t first_index, std::string data );
+  void flush( Writer& writer ); // push stored substrings that have become writable
+  uint64_t bytes_pending() const { return bytes_pending_; }
+  std::vector<std::pair<uint64_t, uint64_t>> held_ranges() const; // [first, end) of each run of stored bytes
+  void resize( uint64_t /*capacity*/ ) {} // substrings are stored as they are, whatever the capacity
+
+private:
+  std::map<uint64_t, std::string> pending_ {};
+  uint64_t bytes_pending_ {}; // total size of the substrings in pending_
+};
@@ -0,0 +1,160 @@
+#include "mirrored_buffer.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+uint64_t round_up_to_page( uint64_t len )
+{
+  const auto page
+    = static_cast<uint64_t>( CheckSystemCall( "sysconf", static_cast<int>( sysconf( _SC_PAGESIZE ) ) ) );
+  return ( len + page - 1 ) / page * page;
+}
+
+void* check_mmap( string_view s_attempt, void* result )
+{
+  if ( result == MAP_FAILED ) {
+    throw unix_error { s_attempt };
+  }
+  return result;
+}
+} // namespace
+
+MirroredBuffer::MirroredBuffer( uint64_t capacity ) : size_( round_up_to_page( capacity ) )
+{
+  if ( size_ == 0 ) {
+    return;
+  }
+
+  const int fd = CheckSystemCall( "memfd_create", memfd_create( "minnow-bytestream", MFD_CLOEXEC ) );
+  try {
+    CheckSystemCall( "ftruncate", ftruncate( fd, static_cast<off_t>( size_ ) ) );
+
+    // reserve 2 * size_ of address space, then map the memfd over each half
+    base_ = static_cast<char*>(
+      check_mmap( "mmap", mmap( nullptr, 2 * size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 ) ) );
+    for ( char* half : { base_, base_ + size_ } ) {
+      check_mmap( "mmap", mmap( half, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 ) );
+    }
+  } catch ( ... ) {
+    release();
+    ::close( fd );
+    throw;
+  }
+
+  // the mappings keep the memory alive; the descriptor itself is no longer needed
+  CheckSystemCall( "close", ::close( fd ) );
+}
+
+MirroredBuffer::~MirroredBuffer()
+{
+  release();
+}
+
+void MirroredBuffer::release()
+{
+  if ( base_ ) {
+    munmap( base_, 2 * size_ );
+    base_ = nullptr;
+  }
+}
+
+MirroredBuffer::MirroredBuffer( const MirroredBuffer& other ) : MirroredBuffer( other.size_ )
+{
+  push( string { other.peek() } );
+}
+
+MirroredBuffer& MirroredBuffer::operator=( const MirroredBuffer& other )
+{
+  if ( this != &other ) {
+    *this = MirroredBuffer { other };
+  }
+  return *this;
+}
+
+MirroredBuffer::MirroredBuffer( MirroredBuffer&& other ) noexcept
+  : base_( exchange( other.base_, nullptr ) )
+  , size_( exchange( other.size_, 0 ) )
+  , start_( exchange( other.start_, 0 ) )
+  , used_( exchange( other.used_, 0 ) )
+{}
+
+MirroredBuffer& MirroredBuffer::operator=( MirroredBuffer&& other ) noexcept
+{
+  if ( this != &other ) {
+    release();
+    base_ = exchange( other.base_, nullptr );
+    size_ = exchange( other.size_, 0 );
+    start_ = exchange( other.start_, 0 );
+    used_ = exchange( other.used_, 0 );
+  }
+  return *this;
+}
+
+void MirroredBuffer::push( string data )
+{
+  const auto region = writable_region( data.size() );
+  copy( data.begin(), data.end(), region.begin() );
+  commit( data.size() );
+}
+
+string_view MirroredBuffer::peek() const
+{
+  if ( used_ == 0 ) {
+    return {};
+  }
+  return { base_ + start_, used_ };
+}
+
+void MirroredBuffer::pop( uint64_t len )
+{
+  used_ -= len;
+  start_ = used_ ? ( start_ + len ) % size_ : 0;
+}
+
+span<char> MirroredBuffer::writable_region( uint64_t max_len )
+{
+  if ( size_ == 0 ) {
+    return {};
+  }
+  return { base_ + start_ + used_, min( max_len, size_ - used_ ) };
+}
+
+void MirroredBuffer::peek_all( uint64_t max_len, vector<string_view>& out ) const
+{
+  if ( used_ > 0 and max_len > 0 ) {
+    out.push_back( peek() );
+  }
+}
+
+void MirroredBuffer::peek_range( uint64_t offset, uint64_t len, vector<string_view>& out ) const
+{
+  out.emplace_back( base_ + start_ + offset, len ); // runs on into the second mapping past the wraparound
+}
+
+void MirroredBuffer::writable_regions( uint64_t max_len, vector<span<char>>& out )
+{
+  const auto region = writable_region( max_len );
+  if ( not region.empty() ) {
+    out.push_back( region );
+  }
+}
+
+void MirroredBuffer::resize( uint64_t capacity ) const
+{
+  if ( capacity > size_ ) {
+    throw runtime_error( "MirroredBuffer: cannot grow past its mapping" );
+  }
+}
+
+void MirroredBuffer::commit( uint64_t len )
+{
+  used_ += len;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Circular buffer whose backing memfd is mapped twice, back to back, so that
+// any run of up to size() bytes starting anywhere in the first mapping is
+// contiguous in virtual memory. peek() therefore always returns every
+// buffered byte, and the free space is always one writable span.
+//
+// The physical footprint is the capacity rounded up to a whole page.
+class MirroredBuffer
+{
+public:
+  explicit MirroredBuffer( uint64_t capacity );
+  ~MirroredBuffer();
+
+  MirroredBuffer( const MirroredBuffer& other );
+  MirroredBuffer& operator=( const MirroredBuffer& other );
+  MirroredBuffer( MirroredBuffer&& other ) noexcept;
+  MirroredBuffer& operator=( MirroredBuffer&& other ) noexcept;
+
+  void push( std::string data ); // caller guarantees data.size() <= free space
+  std::string_view peek() const;
+  void pop( uint64_t len ); // caller guarantees len <= bytes buffered
+
+  std::span<char> writable_region( uint64_t max_len );
+  void commit( uint64_t len ); // caller guarantees len <= writable_region().size()
+
+  // Append the (single) buffered span / the (single) free span
+  void peek_all( uint64_t max_len, std::vector<std::string_view>& out ) const;
+  void writable_regions( uint64_t max_len, std::vector<std::span<char>>& out );
+  // Append the one span of `len` bytes from `offset` past the front (caller guarantees it is all buffered)
+  void peek_range( uint64_t offset, uint64_t len, std::vector<std::string_view>& out ) const;
+
+  uint64_t size() const { return size_; } // length of one mapping (capacity rounded up to a page)
+
+  // The mapping is fixed: throws if `capacity` is more than size()
+  void resize( uint64_t capacity ) const;
+
+private:
+  char* base_ {};     // start of the first mapping (the second follows at base_ + size_)
+  uint64_t size_ {};  // length of one mapping
+  uint64_t start_ {}; // offset of the first buffered byte, always < size_
+  uint64_t used_ {};  // number of buffered bytes
+
+  void release();
+};
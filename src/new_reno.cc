@@ -0,0 +1,71 @@
+#include "new_reno.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+// Initial window (RFC 5681 section 3.1)
+NewReno::NewReno( uint64_t mss ) : mss_( mss ), cwnd_( min( 4 * mss, max<uint64_t>( 2 * mss, 4380 ) ) ) {}
+
+void NewReno::on_ack( const Event& event )
+{
+  if ( in_recovery_ ) {
+    // With SACK, the sender's pipe already leaves out what has left the network, so cwnd stays at ssthresh
+    if ( event.sack and event.ackno <= recover_ ) {
+      return;
+    }
+    if ( event.newly_acked == 0 ) {
+      cwnd_ += mss_; // each duplicate ACK means a segment has left the network
+    } else if ( event.ackno > recover_ ) {
+      // full ACK: everything outstanding when the loss was detected has arrived
+      cwnd_ = min( ssthresh_, max( event.in_flight, mss_ ) + mss_ );
+      in_recovery_ = false;
+    } else {
+      // partial ACK: deflate by the amount acknowledged, then add back one segment if it covered one
+      cwnd_ -= min( cwnd_ - mss_, event.newly_acked );
+      if ( event.newly_acked >= mss_ ) {
+        cwnd_ += mss_;
+      }
+    }
+    return;
+  }
+
+  if ( event.newly_acked == 0 ) {
+    return;
+  }
+  if ( cwnd_ < ssthresh_ ) {
+    cwnd_ += min( event.newly_acked, mss_ ); // slow start
+  } else {
+    congestion_avoidance( event );
+  }
+}
+
+void NewReno::on_loss( const Event& event )
+{
+  // A loss is only a new congestion event if the ACK has moved past the last one
+  if ( in_recovery_ or event.ackno <= recover_ ) {
+    return;
+  }
+  reduce( event, false );
+  cwnd_ = ssthresh_ + ( event.sack ? 0 : 3 * mss_ ); // the three segments that caused the duplicate ACKs
+  recover_ = event.next_seqno - 1;
+  in_recovery_ = true;
+}
+
+void NewReno::on_timeout( const Event& event )
+{
+  reduce( event, true );
+  cwnd_ = mss_;
+  recover_ = event.next_seqno - 1;
+  in_recovery_ = false;
+}
+
+void NewReno::congestion_avoidance( const Event& /*unused*/ )
+{
+  cwnd_ += max<uint64_t>( 1, mss_ * mss_ / cwnd_ );
+}
+
+void NewReno::reduce( const Event& event, bool /*unused*/ )
+{
+  ssthresh_ = max( event.in_flight / 2, 2 * mss_ );
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "congestion_control.hh"
+
+// Slow start and congestion avoidance as in RFC 5681 (with RFC 3465 byte counting in slow start),
+// and NewReno fast recovery as in RFC 6582, or with SACK, a window that stays at ssthresh through
+// recovery as in RFC 6675
+class NewReno : public CongestionControl
+{
+public:
+  explicit NewReno( uint64_t mss );
+
+  Algorithm algorithm() const override { return Algorithm::NewReno; }
+  uint64_t cwnd() const override { return cwnd_; }
+  uint64_t ssthresh() const override { return ssthresh_; }
+  bool in_recovery() const { return in_recovery_; }
+
+  void on_ack( const Event& event ) override;
+  void on_loss( const Event& event ) override;
+  void on_timeout( const Event& event ) override;
+
+protected:
+  // Growth for each new ACK once cwnd has reached ssthresh
+  virtual void congestion_avoidance( const Event& event );
+  // Sets ssthresh after a loss or timeout (cwnd still holds its value from before)
+  virtual void reduce( const Event& event, bool timeout );
+
+  uint64_t mss_;
+  uint64_t cwnd_;
+  uint64_t ssthresh_ { UINT64_MAX };
+
+private:
+  bool in_recovery_ {};
+  uint64_t recover_ {}; // highest sequence number sent when the last loss was detected
+};
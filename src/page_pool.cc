@@ -0,0 +1,101 @@
+#include "page_pool.hh"
+
+#include <algorithm>
+#include <sys/mman.h>
+
+using namespace std;
+
+PagePool& PagePool::global()
+{
+  // never destroyed, so streams that outlive static destruction can still release their pages
+  static auto* pool = new PagePool {}; // NOLINT(*-owning-memory)
+  return *pool;
+}
+
+PagePool::~PagePool()
+{
+  for ( const auto& [base, len] : slabs_ ) {
+    munmap( base, len );
+  }
+}
+
+void PagePool::set_huge_pages( bool enabled )
+{
+  const lock_guard lock { mutex_ };
+  huge_pages_ = enabled;
+}
+
+void PagePool::set_memory_limit( uint64_t bytes )
+{
+  const lock_guard lock { mutex_ };
+  memory_limit_ = bytes;
+}
+
+bool PagePool::reserve_slab()
+{
+  const uint64_t headroom = memory_limit_ > bytes_reserved_ ? memory_limit_ - bytes_reserved_ : 0;
+  const uint64_t len = min( huge_pages_ ? kHugeSlabSize : kSlabSize, headroom ) / kPageSize * kPageSize;
+  if ( len == 0 ) {
+    return false;
+  }
+
+  void* base = MAP_FAILED;
+  if ( huge_pages_ and len == kHugeSlabSize ) {
+    base = mmap( nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+  }
+  if ( base == MAP_FAILED ) {
+    base = mmap( nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( base == MAP_FAILED ) {
+      return false;
+    }
+    if ( huge_pages_ ) {
+      madvise( base, len, MADV_HUGEPAGE ); // best effort: let the kernel promote the slab transparently
+    }
+  }
+
+  auto* slab = static_cast<char*>( base );
+  slabs_.emplace_back( slab, len );
+  bytes_reserved_ += len;
+  for ( uint64_t offset = len; offset > 0; offset -= kPageSize ) {
+    free_pages_.push_back( slab + offset - kPageSize );
+  }
+  return true;
+}
+
+char* PagePool::allocate()
+{
+  const lock_guard lock { mutex_ };
+  if ( free_pages_.empty() and not reserve_slab() ) {
+    return nullptr;
+  }
+  char* page = free_pages_.back();
+  free_pages_.pop_back();
+  ++pages_in_use_;
+  return page;
+}
+
+void PagePool::release( char* page )
+{
+  const lock_guard lock { mutex_ };
+  free_pages_.push_back( page );
+  --pages_in_use_;
+}
+
+uint64_t PagePool::pages_available() const
+{
+  const lock_guard lock { mutex_ };
+  const uint64_t headroom = memory_limit_ > bytes_reserved_ ? memory_limit_ - bytes_reserved_ : 0;
+  return free_pages_.size() + headroom / kPageSize;
+}
+
+uint64_t PagePool::pages_in_use() const
+{
+  const lock_guard lock { mutex_ };
+  return pages_in_use_;
+}
+
+uint64_t PagePool::bytes_reserved() const
+{
+  const lock_guard lock { mutex_ };
+  return bytes_reserved_;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Process-wide pool of fixed-size pages for ByteStream storage.
+//
+// Pages are carved out of larger slabs reserved from the OS with mmap. Released
+// pages go back on a free list for reuse by any stream; slabs are never returned.
+// The total memory reserved can be capped, after which allocate() fails, and
+// slabs can optionally be backed by huge pages.
+class PagePool
+{
+public:
+  static constexpr uint64_t kPageSize = 4096;
+  static constexpr uint64_t kSlabSize = 64 * 1024;           // slab reserved when huge pages are off
+  static constexpr uint64_t kHugeSlabSize = 2 * 1024 * 1024; // one x86-64 huge page
+
+  // The pool shared by every paged ByteStream in the process
+  static PagePool& global();
+
+  PagePool() = default;
+  ~PagePool();
+
+  PagePool( const PagePool& other ) = delete;
+  PagePool& operator=( const PagePool& other ) = delete;
+  PagePool( PagePool&& other ) = delete;
+  PagePool& operator=( PagePool&& other ) = delete;
+
+  // Back slabs reserved from now on with huge pages (falls back to regular pages if none are available)
+  void set_huge_pages( bool enabled );
+
+  // Cap the memory the pool may reserve from the OS, in bytes
+  void set_memory_limit( uint64_t bytes );
+
+  char* allocate();           // Returns a page, or nullptr if the memory limit has been reached
+  void release( char* page ); // Returns a page obtained from allocate() to the pool
+
+  uint64_t pages_available() const; // How many more pages could allocate() hand out right now?
+  uint64_t pages_in_use() const;    // Pages handed out and not yet released
+  uint64_t bytes_reserved() const;  // Memory reserved from the OS so far
+
+private:
+  mutable std::mutex mutex_ {};
+  std::vector<char*> free_pages_ {};
+  std::vector<std::pair<char*, uint64_t>> slabs_ {}; // base and length of every reserved slab
+  uint64_t pages_in_use_ {};
+  uint64_t bytes_reserved_ {};
+  uint64_t memory_limit_ { std::numeric_limits<uint64_t>::max() };
+  bool huge_pages_ {};
+
+  bool reserve_slab(); // requires mutex_ held
+};
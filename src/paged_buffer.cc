@@ -0,0 +1,179 @@
+#include "paged_buffer.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+PagedBuffer::~PagedBuffer()
+{
+  release_all();
+}
+
+PagedBuffer::PagedBuffer( const PagedBuffer& other )
+{
+  uint64_t offset = other.head_;
+  uint64_t remaining = other.size_;
+  for ( auto* page : other.pages_ ) {
+    if ( remaining == 0 ) {
+      break;
+    }
+    const uint64_t len = min( remaining, kPageSize - offset );
+    push( string { page + offset, len } );
+    remaining -= len;
+    offset = 0;
+  }
+}
+
+PagedBuffer& PagedBuffer::operator=( const PagedBuffer& other )
+{
+  if ( this != &other ) {
+    *this = PagedBuffer { other };
+  }
+  return *this;
+}
+
+PagedBuffer::PagedBuffer( PagedBuffer&& other ) noexcept
+  : pages_( exchange( other.pages_, {} ) ), head_( exchange( other.head_, 0 ) ), size_( exchange( other.size_, 0 ) )
+{}
+
+PagedBuffer& PagedBuffer::operator=( PagedBuffer&& other ) noexcept
+{
+  if ( this != &other ) {
+    release_all();
+    pages_ = exchange( other.pages_, {} );
+    head_ = exchange( other.head_, 0 );
+    size_ = exchange( other.size_, 0 );
+  }
+  return *this;
+}
+
+void PagedBuffer::release_all()
+{
+  for ( auto* page : pages_ ) {
+    PagePool::global().release( page );
+  }
+  pages_.clear();
+  head_ = size_ = 0;
+}
+
+char* PagedBuffer::tail_page()
+{
+  if ( tail() == pages_.size() * kPageSize ) {
+    char* page = PagePool::global().allocate();
+    if ( page == nullptr ) {
+      return nullptr;
+    }
+    pages_.push_back( page );
+  }
+  return pages_.back();
+}
+
+void PagedBuffer::push( string data )
+{
+  string_view remaining { data };
+  while ( not remaining.empty() ) {
+    const auto region = writable_region( remaining.size() );
+    if ( region.empty() ) {
+      throw runtime_error( "PagedBuffer: page pool exhausted" );
+    }
+    copy_n( remaining.begin(), region.size(), region.begin() );
+    commit( region.size() );
+    remaining.remove_prefix( region.size() );
+  }
+}
+
+string_view PagedBuffer::peek() const
+{
+  if ( size_ == 0 ) {
+    return {};
+  }
+  return { pages_.front() + head_, min( size_, kPageSize - head_ ) };
+}
+
+void PagedBuffer::pop( uint64_t len )
+{
+  head_ += len;
+  size_ -= len;
+  if ( size_ == 0 ) {
+    release_all();
+    return;
+  }
+  while ( head_ >= kPageSize ) {
+    PagePool::global().release( pages_.front() );
+    pages_.pop_front();
+    head_ -= kPageSize;
+  }
+}
+
+span<char> PagedBuffer::writable_region( uint64_t max_len )
+{
+  char* page = tail_page();
+  if ( page == nullptr ) {
+    return {};
+  }
+  const uint64_t offset = tail() % kPageSize;
+  return { page + offset, min( max_len, kPageSize - offset ) };
+}
+
+void PagedBuffer::peek_all( uint64_t max_len, vector<string_view>& out ) const
+{
+  uint64_t offset = head_;
+  uint64_t remaining = size_;
+  for ( auto it = pages_.begin(); it != pages_.end() and remaining > 0 and max_len > 0; ++it ) {
+    const uint64_t len = min( remaining, kPageSize - offset );
+    out.emplace_back( *it + offset, len );
+    remaining -= len;
+    max_len -= min( max_len, len );
+    offset = 0;
+  }
+}
+
+void PagedBuffer::peek_range( uint64_t offset, uint64_t len, vector<string_view>& out ) const
+{
+  uint64_t position = head_ + offset; // from the start of the front page
+  while ( len > 0 ) {
+    const uint64_t in_page = min( len, kPageSize - position % kPageSize );
+    out.emplace_back( pages_[position / kPageSize] + position % kPageSize, in_page );
+    position += in_page;
+    len -= in_page;
+  }
+}
+
+void PagedBuffer::writable_regions( uint64_t max_len, vector<span<char>>& out )
+{
+  uint64_t offset = tail();
+  while ( max_len > 0 ) {
+    if ( offset == pages_.size() * kPageSize ) {
+      char* page = PagePool::global().allocate();
+      if ( page == nullptr ) {
+        break;
+      }
+      pages_.push_back( page );
+    }
+    const uint64_t page_offset = offset % kPageSize;
+    const uint64_t len = min( max_len, kPageSize - page_offset );
+    out.emplace_back( pages_[offset / kPageSize] + page_offset, len );
+    offset += len;
+    max_len -= len;
+  }
+}
+
+void PagedBuffer::commit( uint64_t len )
+{
+  size_ += len;
+  if ( size_ == 0 ) {
+    release_all(); // nothing was written into freshly allocated pages
+    return;
+  }
+  while ( pages_.size() * kPageSize >= tail() + kPageSize ) {
+    PagePool::global().release( pages_.back() ); // allocated for a region that went unused
+    pages_.pop_back();
+  }
+}
+
+uint64_t PagedBuffer::headroom() const
+{
+  return pages_.size() * kPageSize - tail() + PagePool::global().pages_available() * kPageSize;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "page_pool.hh"
+
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Byte queue stored in fixed-size pages taken from the process-wide PagePool.
+// Pages are allocated only as bytes arrive and go back to the pool as soon as
+// they have been fully popped, so an idle stream holds no memory at all.
+// peek() returns the buffered bytes up to the end of the front page.
+class PagedBuffer
+{
+public:
+  PagedBuffer() = default;
+  ~PagedBuffer();
+
+  PagedBuffer( const PagedBuffer& other );
+  PagedBuffer& operator=( const PagedBuffer& other );
+  PagedBuffer( PagedBuffer&& other ) noexcept;
+  PagedBuffer& operator=( PagedBuffer&& other ) noexcept;
+
+  void push( std::string data ); // caller guarantees data.size() <= headroom()
+  std::string_view peek() const;
+  void pop( uint64_t len ); // caller guarantees len <= bytes buffered
+
+  std::span<char> writable_region( uint64_t max_len ); // free space up to the end of the tail page
+  void commit( uint64_t len ); // caller guarantees len <= total size of the writable region(s)
+
+  // Append the buffered spans (one per page) covering max_len bytes / free spans up to max_len,
+  // allocating pages for them. Pages that commit() leaves unused go straight back to the pool.
+  void peek_all( uint64_t max_len, std::vector<std::string_view>& out ) const;
+  void writable_regions( uint64_t max_len, std::vector<std::span<char>>& out );
+  // Append one span per page for `len` bytes from `offset` past the front; the first page is found by index
+  // (caller guarantees offset + len <= bytes buffered)
+  void peek_range( uint64_t offset, uint64_t len, std::vector<std::string_view>& out ) const;
+
+  void resize( uint64_t /*capacity*/ ) {} // pages are taken as bytes arrive, whatever the capacity
+
+  // How many more bytes could be stored, given the pages left in the pool?
+  uint64_t headroom() const;
+
+private:
+  static constexpr uint64_t kPageSize = PagePool::kPageSize;
+
+  std::deque<char*> pages_ {};
+  uint64_t head_ {}; // offset of the first buffered byte in pages_.front()
+  uint64_t size_ {}; // number of buffered bytes
+
+  uint64_t tail() const { return head_ + size_; } // offset of the next free byte from the front page
+  char* tail_page();                              // page holding tail(), allocated if necessary
+  void release_all();
+};
@@ -1,76 +1,69 @@
 #include "reassembler.hh"
 #include "debug.hh"
-#include <iostream>
+#include <algorithm>
+#include <stdexcept>
 using namespace std;
- 
+
+namespace {
+variant<IntervalStore, BitmapStore> make_store( const Writer& writer, Reassembler::Mode mode )
+{
+  switch ( mode ) {
+    case Reassembler::Mode::Intervals:
+      return IntervalStore {};
+    case Reassembler::Mode::Bitmap:
+      return BitmapStore { writer.capacity(), writer.bytes_pushed() };
+  }
+  throw invalid_argument( "unknown Reassembler::Mode" );
+}
+} // namespace
+
+Reassembler::Reassembler( ByteStream&& output, Mode mode )
+  : output_( std::move( output ) ), pending_( make_store( output_.writer(), mode ) )
+{}
+
 void Reassembler::insert( uint64_t first_index, string data, bool is_last_substring )
 {
-  if ( data.empty() && is_last_substring && first_index == next_byte_index() ) {
+  if ( is_last_substring ) {
+    stream_end_ = first_index + data.size();
+  }
+
+  // Keep only the bytes inside the window [next_byte_index(), window_end())
+  const uint64_t next = next_byte_index();
+  const uint64_t end = min( first_index + data.size(), window_end() );
+  if ( first_index < end and end > next ) {
+    if ( first_index < next ) {
+      data.erase( 0, next - first_index );
+      first_index = next;
+    }
+    data.resize( end - first_index );
+
+    if ( first_index == next ) {
+      get_writer().push( move( data ) ); // in-order data goes straight through, without being stored
+      visit( [&]( auto& pending ) { pending.flush( get_writer() ); }, pending_ );
+    } else {
+      visit( [&]( auto& pending ) { pending.store( first_index, move( data ) ); }, pending_ );
+    }
+  }
+
+  if ( stream_end_ == next_byte_index() ) {
     get_writer().close();
-    return;
   }
- 
-  if ( is_last_substring ) {
-    last_byte_ = first_index + data.length() - 1;
-   }
- 
-   // At least one byte of data is available to insert
-   if ( first_index < next_byte_index() + available_capacity() && first_index + data.length() > next_byte_index() ) {
-     uint64_t insert_key = ( first_index >= next_byte_index() ) ? first_index : next_byte_index();
- 
-     unassembled_substrings_.insert(
-       make_pair( insert_key,
-                  data.substr( insert_key - first_index,
-                               min( data.length(), next_byte_index() + available_capacity() - insert_key ) ) ) );
-     merge_substrings();
-     if ( unassembled_substrings_.begin()->first == next_byte_index() ) {
-       get_writer().push( unassembled_substrings_.begin()->second );
-       if ( unassembled_substrings_.begin()->first + unassembled_substrings_.begin()->second.length() - 1
-            == last_byte_ ) {
-         get_writer().close();
-       }
-       unassembled_substrings_.erase( unassembled_substrings_.begin() );
-     }
-   }
- }
- 
- // How many bytes are stored in the Reassembler itself?
- // This function is for testing only; don't add extra state to support it.
- uint64_t Reassembler::count_bytes_pending() const
- {
+}
+
+void Reassembler::set_capacity( uint64_t capacity )
+{
+  const auto ranges = held_ranges();
+  const uint64_t held_end = ranges.empty() ? next_byte_index() : ranges.back().second;
+  get_writer().set_capacity( max( capacity, held_end - reader().bytes_popped() ) );
+  visit( [&]( auto& pending ) { pending.resize( writer().capacity() ); }, pending_ );
+}
+
+vector<pair<uint64_t, uint64_t>> Reassembler::held_ranges() const
+{
+  return visit( []( const auto& pending ) { return pending.held_ranges(); }, pending_ );
+}
 
- 
-   uint64_t count = 0;
-   for ( auto it = unassembled_substrings_.begin(); it != unassembled_substrings_.end(); ++it ) {
-     count += it->second.length();
-   }
-   return count;
- }
- 
- void Reassembler::merge_substrings()
- {
-   if ( unassembled_substrings_.size() <= 1 )
-     return;
- 
-   auto it = unassembled_substrings_.begin();
-   auto next = std::next( it );
- 
-   while ( next != unassembled_substrings_.end() ) {
-     // Overlap or adjacent substrings can be merged
-     if ( it->first + it->second.length() >= next->first ) {
-       // If next is completely contained in it, erase next directly
-       if ( it->first + it->second.length() >= next->first + next->second.length() ) {
-         next = unassembled_substrings_.erase( next );
-         continue;
-       }
- 
-       // Otherwise, merge the overlap
-       uint64_t overlap_index = it->first + it->second.length() - next->first;
-       it->second += next->second.substr( overlap_index );
-       next = unassembled_substrings_.erase( next );
-     } else {
-       ++it;
-       ++next;
-     }
-   }
- }
\ No newline at end of file
+uint64_t Reassembler::count_bytes_pending() const
+{
+  return visit( []( const auto& pending ) { return pending.bytes_pending(); }, pending_ );
+}
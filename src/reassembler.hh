@@ -1,15 +1,28 @@
 #pragma once
 
+#include "bitmap_store.hh"
 #include "byte_stream.hh"
-#include <map>
+#include "interval_store.hh"
+#include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
 
 class Reassembler
 {
 public:
+  // How out-of-order bytes are stored until the gaps before them are filled:
+  //   Intervals: one string per stored substring, in a map keyed by first index
+  //   Bitmap:    copied into a ring of the stream's capacity, with one bit per byte saying whether it arrived;
+  //              memory is fixed at capacity + capacity/8 bytes and storing never allocates
+  enum class Mode : uint8_t
+  {
+    Intervals,
+    Bitmap,
+  };
+
   // Construct Reassembler to write into given ByteStream.
-  explicit Reassembler( ByteStream&& output )
-    : output_( std::move( output ) ), capacity_( writer().available_capacity() )
-  {}
+  explicit Reassembler( ByteStream&& output, Mode mode = Mode::Intervals );
 
   /*
    * Insert a new substring to be reassembled into a ByteStream.
@@ -34,9 +47,20 @@ public:
   void insert( uint64_t first_index, std::string data, bool is_last_substring );
 
   // How many bytes are stored in the Reassembler itself?
-  // This function is for testing only; don't add extra state to support it.
   uint64_t count_bytes_pending() const;
 
+  // The stored bytes, as [first, end) stream indices of each run without a gap, in increasing order
+  std::vector<std::pair<uint64_t, uint64_t>> held_ranges() const;
+
+  // The index just past the last byte, once the last substring has arrived
+  std::optional<uint64_t> stream_end() const { return stream_end_; }
+
+  Mode mode() const { return static_cast<Mode>( pending_.index() ); }
+
+  // Change the capacity of the output stream (see Writer::set_capacity), keeping the bytes held for it:
+  // never to fewer than reach from the first unread byte to the last byte held
+  void set_capacity( uint64_t capacity );
+
   // Access output stream reader
   Reader& reader() { return output_.reader(); }
   const Reader& reader() const { return output_.reader(); }
@@ -47,20 +71,10 @@ public:
 
 private:
   ByteStream output_;
-  uint64_t capacity_;
-  uint64_t last_byte_ = -1; // index of last byte written to the ByteStream
-  std::multimap<uint64_t, std::string> unassembled_substrings_ {};
-  Writer& get_writer() { return output_.writer(); }; // get the writer
-  uint64_t available_capacity() const { return writer().available_capacity(); };
-  uint64_t next_byte_index() const
-  {
-    return writer().bytes_pushed();
-  }; // index of next byte to be written to ByteStream// How many bytes can be buffered in the
-     // Reassembler/ByteStream?
-  uint64_t first_unpopped_index() const
-  {
-    return next_byte_index() + available_capacity() - capacity_;
-  }; // index of first byte that hasn't been popped from the ByteStream yet
+  std::optional<uint64_t> stream_end_ {}; // index just past the last byte, once the last substring is known
+  std::variant<IntervalStore, BitmapStore> pending_; // one alternative per Mode, in the same order
 
-  void merge_substrings(); // merge overlapping/adjacent substrings in unassembled_substrings_
-};
\ No newline at end of file
+  Writer& get_writer() { return output_.writer(); }; // get the writer
+  uint64_t next_byte_index() const { return writer().bytes_pushed(); } // index of next byte to be written
+  uint64_t window_end() const { return next_byte_index() + writer().available_capacity(); } // first index beyond
+};
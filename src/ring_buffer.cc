@@ -0,0 +1,99 @@
+#include "ring_buffer.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+void RingBuffer::push( string data )
+{
+  if ( data.empty() ) {
+    return;
+  }
+
+  const uint64_t capacity = buf_.size();
+  const uint64_t end = ( start_ + size_ ) % capacity;
+
+  // copy in at most two pieces: up to the end of the buffer, then from the front
+  const uint64_t first = min( data.size(), capacity - end );
+  copy_n( data.begin(), first, buf_.begin() + static_cast<ptrdiff_t>( end ) );
+  copy( data.begin() + static_cast<ptrdiff_t>( first ), data.end(), buf_.begin() );
+
+  size_ += data.size();
+}
+
+string_view RingBuffer::peek() const
+{
+  if ( size_ == 0 ) {
+    return {};
+  }
+  return { &buf_[start_], min( size_, buf_.size() - start_ ) };
+}
+
+void RingBuffer::resize( uint64_t capacity )
+{
+  if ( capacity == buf_.size() ) {
+    return;
+  }
+  // the bytes up to the wraparound point, then those from the front
+  vector<char> resized( capacity );
+  const string_view first = peek();
+  const auto rest = copy( first.begin(), first.end(), resized.begin() );
+  copy_n( buf_.begin(), size_ - first.size(), rest );
+  buf_ = move( resized );
+  start_ = 0;
+}
+
+void RingBuffer::pop( uint64_t len )
+{
+  start_ = ( start_ + len ) % buf_.size();
+  size_ -= len;
+}
+
+span<char> RingBuffer::writable_region( uint64_t max_len )
+{
+  if ( buf_.empty() ) {
+    return {};
+  }
+  const uint64_t end = ( start_ + size_ ) % buf_.size();
+  const uint64_t free_until_wrap = ( end < start_ or size_ == buf_.size() ) ? start_ - end : buf_.size() - end;
+  return { buf_.data() + end, min( max_len, free_until_wrap ) };
+}
+
+void RingBuffer::peek_all( uint64_t max_len, vector<string_view>& out ) const
+{
+  const auto first = peek();
+  if ( not first.empty() ) {
+    out.push_back( first );
+  }
+  if ( first.size() < min( max_len, size_ ) ) {
+    out.emplace_back( buf_.data(), size_ - first.size() );
+  }
+}
+
+void RingBuffer::peek_range( uint64_t offset, uint64_t len, vector<string_view>& out ) const
+{
+  const uint64_t start = ( start_ + offset ) % buf_.size();
+  const uint64_t first = min( len, buf_.size() - start );
+  out.emplace_back( &buf_[start], first );
+  if ( first < len ) {
+    out.emplace_back( buf_.data(), len - first );
+  }
+}
+
+void RingBuffer::writable_regions( uint64_t max_len, vector<span<char>>& out )
+{
+  const auto first = writable_region( max_len );
+  if ( not first.empty() ) {
+    out.push_back( first );
+  }
+  const uint64_t free = buf_.size() - size_;
+  const uint64_t second = min( max_len, free ) - first.size();
+  if ( second > 0 ) {
+    out.emplace_back( buf_.data(), second );
+  }
+}
+
+void RingBuffer::commit( uint64_t len )
+{
+  size_ += len;
+}
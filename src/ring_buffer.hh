@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Fixed-capacity circular buffer of bytes, allocated up front.
+// peek() returns the buffered bytes up to the wraparound point.
+class RingBuffer
+{
+public:
+  explicit RingBuffer( uint64_t capacity ) : buf_( capacity ) {}
+
+  void push( std::string data ); // caller guarantees data.size() <= free space
+  std::string_view peek() const;
+  void pop( uint64_t len ); // caller guarantees len <= bytes buffered
+
+  std::span<char> writable_region( uint64_t max_len ); // free space up to the wraparound point
+  void commit( uint64_t len ); // caller guarantees len <= total size of the writable region(s)
+
+  // Append the buffered spans (at most two) covering max_len bytes / the free spans up to max_len (at most two)
+  void peek_all( uint64_t max_len, std::vector<std::string_view>& out ) const;
+  void writable_regions( uint64_t max_len, std::vector<std::span<char>>& out );
+  // Append the spans (at most two) of `len` bytes from `offset` past the front, all buffered
+  void peek_range( uint64_t offset, uint64_t len, std::vector<std::string_view>& out ) const;
+
+  // Reallocate to `capacity` bytes, moving the buffered bytes to the front (caller guarantees they fit)
+  void resize( uint64_t capacity );
+
+private:
+  std::vector<char> buf_;
+  uint64_t start_ {}; // index of the first buffered byte
+  uint64_t size_ {};  // number of buffered bytes
+};
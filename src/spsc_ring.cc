@@ -0,0 +1,104 @@
+#include "spsc_ring.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+void SpscRing::resize( uint64_t capacity ) const
+{
+  if ( capacity > buf_.size() ) {
+    throw runtime_error( "SpscRing: cannot grow past the capacity it was made with" );
+  }
+}
+
+void SpscRing::push( string data )
+{
+  if ( data.empty() ) {
+    return;
+  }
+
+  const uint64_t capacity = buf_.size();
+  const uint64_t end = tail_.owned() % capacity;
+
+  // copy in at most two pieces: up to the end of the buffer, then from the front
+  const uint64_t first = min( data.size(), capacity - end );
+  copy_n( data.begin(), first, buf_.begin() + static_cast<ptrdiff_t>( end ) );
+  copy( data.begin() + static_cast<ptrdiff_t>( first ), data.end(), buf_.begin() );
+
+  tail_.advance( data.size() ); // publish the bytes to the reader
+}
+
+string_view SpscRing::peek() const
+{
+  const uint64_t head = head_.owned();
+  const uint64_t size = tail_.load() - head;
+  if ( size == 0 ) {
+    return {};
+  }
+  const uint64_t start = head % buf_.size();
+  return { &buf_[start], min( size, buf_.size() - start ) };
+}
+
+void SpscRing::pop( uint64_t len )
+{
+  head_.advance( len ); // hand the space back to the writer
+}
+
+span<char> SpscRing::writable_region( uint64_t max_len )
+{
+  if ( buf_.empty() ) {
+    return {};
+  }
+  const uint64_t tail = tail_.owned();
+  const uint64_t free = buf_.size() - ( tail - head_.load() );
+  const uint64_t end = tail % buf_.size();
+  return { buf_.data() + end, min( { max_len, free, buf_.size() - end } ) };
+}
+
+void SpscRing::peek_all( uint64_t max_len, vector<string_view>& out ) const
+{
+  // one snapshot of the writer's index, so both spans describe the same bytes
+  const uint64_t head = head_.owned();
+  const uint64_t size = tail_.load() - head;
+  if ( size == 0 ) {
+    return;
+  }
+  const uint64_t start = head % buf_.size();
+  const uint64_t first = min( size, buf_.size() - start );
+  out.emplace_back( &buf_[start], first );
+  if ( first < min( max_len, size ) ) {
+    out.emplace_back( buf_.data(), size - first );
+  }
+}
+
+void SpscRing::peek_range( uint64_t offset, uint64_t len, vector<string_view>& out ) const
+{
+  const uint64_t start = ( head_.owned() + offset ) % buf_.size();
+  const uint64_t first = min( len, buf_.size() - start );
+  out.emplace_back( &buf_[start], first );
+  if ( first < len ) {
+    out.emplace_back( buf_.data(), len - first );
+  }
+}
+
+void SpscRing::writable_regions( uint64_t max_len, vector<span<char>>& out )
+{
+  // one snapshot of the reader's index, so the second span only starts where the first one wrapped
+  const uint64_t tail = tail_.owned();
+  const uint64_t len = min( max_len, buf_.size() - ( tail - head_.load() ) );
+  if ( len == 0 ) {
+    return;
+  }
+  const uint64_t end = tail % buf_.size();
+  const uint64_t first = min( len, buf_.size() - end );
+  out.emplace_back( buf_.data() + end, first );
+  if ( first < len ) {
+    out.emplace_back( buf_.data(), len - first );
+  }
+}
+
+void SpscRing::commit( uint64_t len )
+{
+  tail_.advance( len ); // publish the bytes to the reader
+}
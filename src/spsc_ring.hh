@@ -0,0 +1,43 @@
+#pragma once
+
+#include "atomic_cell.hh"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Fixed-capacity circular buffer that one writer thread and one reader thread may use at
+// the same time without locks. The writer only advances tail_ and the reader only advances
+// head_; both are running byte counts (never wrapped) on separate cache lines, so each side
+// owns one index and only reads the other's.
+//
+// push(), writable_region(), writable_regions() and commit() belong to the writer;
+// peek(), peek_all(), peek_range() and pop() belong to the reader.
+class SpscRing
+{
+public:
+  explicit SpscRing( uint64_t capacity ) : buf_( capacity ) {}
+
+  void push( std::string data ); // caller guarantees data.size() <= free space
+  std::string_view peek() const;
+  void pop( uint64_t len ); // caller guarantees len <= bytes buffered
+
+  std::span<char> writable_region( uint64_t max_len ); // free space up to the wraparound point
+  void commit( uint64_t len ); // caller guarantees len <= total size of the writable region(s)
+
+  // Append the buffered spans (at most two) covering max_len bytes / the free spans up to max_len (at most two)
+  void peek_all( uint64_t max_len, std::vector<std::string_view>& out ) const;
+  void writable_regions( uint64_t max_len, std::vector<std::span<char>>& out );
+  // Append the spans (at most two) of `len` bytes from `offset` past the front, all buffered
+  void peek_range( uint64_t offset, uint64_t len, std::vector<std::string_view>& out ) const;
+
+  // The buffer is fixed, since the other thread may be using it: throws if `capacity` is more than its size
+  void resize( uint64_t capacity ) const;
+
+private:
+  std::vector<char> buf_;
+  alignas( kCacheLineSize ) AtomicCell<uint64_t> head_ {}; // bytes popped, written by the reader
+  alignas( kCacheLineSize ) AtomicCell<uint64_t> tail_ {}; // bytes pushed, written by the writer
+};
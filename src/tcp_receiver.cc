@@ -1,8 +1,35 @@
 #include "tcp_receiver.hh"
 #include "debug.hh"
+#include <algorithm>
 #include <iostream>
 using namespace std;
 
+namespace {
+constexpr uint8_t MAX_WINDOW_SHIFT = 14; // RFC 7323 section 2.3
+}
+
+TCPReceiver::TCPReceiver( Reassembler&& reassembler,
+                          bool window_scaling,
+                          bool timestamps,
+                          optional<uint64_t> sws_mss,
+                          uint64_t max_capacity )
+  : reassembler_( move( reassembler ) )
+  , timestamps_offered_( timestamps )
+  , sws_mss_( sws_mss )
+  , capacity_( reassembler_.writer().capacity() )
+  , max_capacity_( max( max_capacity, capacity_ ) )
+  , right_edge_( reassembler_.writer().available_capacity() )
+{
+  if ( window_scaling ) {
+    // the smallest shift at which the largest capacity fits in the 16-bit window field
+    uint8_t shift = 0;
+    while ( shift < MAX_WINDOW_SHIFT and ( max_capacity_ >> shift ) > UINT16_MAX ) {
+      ++shift;
+    }
+    window_scale_ = shift;
+  }
+}
+
 void TCPReceiver::receive( TCPSenderMessage message )
 {
   if ( message.RST ) {
@@ -14,6 +41,10 @@ void TCPReceiver::receive( TCPSenderMessage message )
   if ( message.SYN && !isn_set_ ) {
     isn_ = message.seqno;
     isn_set_ = true;
+    sack_permitted_ = message.SACK_permitted;
+    window_shift_ = window_scale_.has_value() and message.window_scale.has_value() ? *window_scale_ : 0;
+    timestamps_ = timestamps_offered_ and message.timestamp.has_value();
+    ts_recent_ = message.timestamp.value_or( 0 );
   }
 
   // If we haven't received a SYN yet, ignore the segment
@@ -28,11 +59,110 @@ void TCPReceiver::receive( TCPSenderMessage message )
   // Calculate the stream index for the first byte of the payload
   uint64_t stream_index = abs_seqno - 1 + message.SYN;
 
+  if ( !check_timestamp( message, abs_seqno ) ) {
+    return;
+  }
+
+  // With SWS avoidance, bytes past the window last advertised are cut off (RFC 9293 section 3.10.7.4), even
+  // if there is room for them: taking a zero-window probe's byte would leave the window to reopen a byte short
+  if ( sws_mss_.has_value() && stream_index + message.payload.size() > right_edge_ ) {
+    message.payload.resize( right_edge_ - min( right_edge_, stream_index ) );
+    message.FIN = false;
+  }
+
+  // Remember where the latest out-of-order data (or FIN) went, for the first SACK block
+  if ( ( !message.payload.empty() || message.FIN ) && stream_index > reassembler_.writer().bytes_pushed() ) {
+    last_out_of_order_ = stream_index;
+  }
+
   // Insert the payload into the reassembler
-  reassembler_.insert( stream_index, message.payload, message.FIN );
+  reassembler_.insert( stream_index, move( message.payload ), message.FIN );
+}
+
+bool TCPReceiver::check_timestamp( const TCPSenderMessage& message, uint64_t abs_seqno )
+{
+  if ( !timestamps_ ) {
+    return true;
+  }
+  // Once timestamps are in use, a segment without one is dropped (RFC 7323 section 3.2), and so is one
+  // whose timestamp is older than TS.Recent: it is an old duplicate, maybe from a wrapped sequence space
+  if ( !message.timestamp.has_value() || static_cast<int32_t>( *message.timestamp - ts_recent_ ) < 0 ) {
+    return false;
+  }
+  // TS.Recent follows the segments that start at or before the ackno, so that the echo times the round trip
+  // of the segment that moves the ackno, not one that arrived early or was delayed
+  if ( abs_seqno <= reassembler_.writer().bytes_pushed() + 1 ) {
+    ts_recent_ = *message.timestamp;
+  }
+  return true;
+}
+
+void TCPReceiver::add_sack_blocks( TCPReceiverMessage& msg ) const
+{
+  // The block holding the most recently received segment goes first (RFC 2018 section 4), then the
+  // others in sequence order, as many as fit. A FIN held beyond a gap takes the index after the last byte.
+  // Walking the held ranges costs as much as the reassembler holds, so in-order data skips it.
+  const optional<uint64_t> fin = reassembler_.stream_end();
+  const bool fin_held = fin.has_value() && *fin > reassembler_.writer().bytes_pushed();
+  if ( reassembler_.count_bytes_pending() == 0 && !fin_held ) {
+    return;
+  }
+  auto ranges = reassembler_.held_ranges();
+  if ( fin_held ) {
+    if ( !ranges.empty() && ranges.back().second == *fin ) {
+      ++ranges.back().second;
+    } else {
+      ranges.emplace_back( *fin, *fin + 1 );
+    }
+  }
+  const auto latest = find_if( ranges.begin(), ranges.end(), [&]( const auto& range ) {
+    return range.first <= last_out_of_order_ and last_out_of_order_ < range.second;
+  } );
+  auto add = [&]( const pair<uint64_t, uint64_t>& range ) {
+    if ( msg.sack.size() < TCPReceiverMessage::MAX_SACK_BLOCKS ) {
+      // stream index i is sequence number i + 1 (after the SYN)
+      msg.sack.push_back( { Wrap32::wrap( range.first + 1, isn_ ), Wrap32::wrap( range.second + 1, isn_ ) } );
+    }
+  };
+  if ( latest != ranges.end() ) {
+    add( *latest );
+  }
+  for ( auto it = ranges.begin(); it != ranges.end(); ++it ) {
+    if ( it != latest ) {
+      add( *it );
+    }
+  }
+}
+
+void TCPReceiver::set_capacity( uint64_t capacity )
+{
+  // the stream keeps room for the window already advertised until the reader has drained it
+  capacity_ = min( capacity, max_capacity_ );
+  reassembler_.set_capacity( max( capacity_, right_edge_ - min( right_edge_, reader().bytes_popped() ) ) );
+}
+
+uint64_t TCPReceiver::window_edge() const
+{
+  // The window reaches as far as the available capacity, or as the capacity set last allows while the
+  // stream still keeps room for a larger window advertised before. Its right edge never moves back, and
+  // with SWS avoidance, it moves forward only by at least an MSS or half the capacity: a reader that frees
+  // a few bytes at a time does not draw a segment of a few bytes for each.
+  const Writer& writer = reassembler_.writer();
+  const uint64_t edge
+    = min( writer.bytes_pushed() + writer.available_capacity(), reader().bytes_popped() + capacity_ );
+  if ( !sws_mss_.has_value() || edge >= right_edge_ + min( *sws_mss_, capacity_ / 2 ) ) {
+    return max( right_edge_, edge );
+  }
+  return right_edge_;
 }
 
-TCPReceiverMessage TCPReceiver::send() const
+TCPReceiverMessage TCPReceiver::send( bool syn )
+{
+  right_edge_ = window_edge();
+  return message( syn );
+}
+
+TCPReceiverMessage TCPReceiver::message( bool syn ) const
 {
   TCPReceiverMessage msg;
 
@@ -49,10 +179,20 @@ TCPReceiverMessage TCPReceiver::send() const
 
     // Convert the absolute sequence number back to a wrapped sequence number
     msg.ackno = Wrap32::wrap( abs_ackno, isn_ );
+
+    if ( sack_permitted_ ) {
+      add_sack_blocks( msg );
+    }
+    if ( timestamps_ ) {
+      msg.timestamp_echo = ts_recent_;
+    }
   }
 
-  // Set the window size to the available capacity, bounded by UINT16_MAX
-  uint64_t window = reassembler_.writer().available_capacity();
+  // Set the window size to what lies before the right edge, scaled down (and so rounded down) by the shift in
+  // effect unless it goes with our SYN, bounded by UINT16_MAX.
+  const uint64_t edge = window_edge();
+  const uint64_t pushed = reassembler_.writer().bytes_pushed();
+  uint64_t window = ( edge - min( edge, pushed ) ) >> ( syn ? 0 : window_shift_ );
   msg.window_size = window > UINT16_MAX ? UINT16_MAX : window;
   msg.RST = reassembler_.writer().has_error();
   return msg;
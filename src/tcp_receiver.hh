@@ -4,11 +4,25 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
+#include <cstdint>
+#include <optional>
+
 class TCPReceiver
 {
 public:
-  // Construct with given Reassembler
-  explicit TCPReceiver( Reassembler&& reassembler ) : reassembler_( std::move( reassembler ) ) {}
+  // Construct with given Reassembler. With `window_scaling`, the receiver picks the shift (RFC 7323) that
+  // lets it advertise its whole capacity; windows are scaled by it once the peer's SYN offers scaling too.
+  // With `timestamps`, once the peer's SYN carries a timestamp too, the receiver echoes the peer's timestamps
+  // and drops segments whose timestamp is older than one it has seen (PAWS, RFC 7323).
+  // With `sws_mss`, the receiver avoids silly window syndrome (RFC 1122 section 4.2.3.3): as the reader
+  // frees room, the window opens only by at least that MSS or half the capacity, whichever is smaller, and
+  // bytes past the window advertised are not taken.
+  // `max_capacity` is the most set_capacity() may grow the capacity to; the window scale covers it.
+  explicit TCPReceiver( Reassembler&& reassembler,
+                        bool window_scaling = false,
+                        bool timestamps = false,
+                        std::optional<uint64_t> sws_mss = std::nullopt,
+                        uint64_t max_capacity = 0 );
 
   /*
    * The TCPReceiver receives TCPSenderMessages, inserting their payload into the Reassembler
@@ -16,8 +30,21 @@ public:
    */
   void receive( TCPSenderMessage message );
 
-  // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
-  TCPReceiverMessage send() const;
+  // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender, with SACK blocks for the bytes it holds
+  // beyond the ackno if the peer's SYN permitted them. The window is not scaled on a message that goes with
+  // our SYN (RFC 7323 section 2.2). Call send() only for a message that goes out: the window it advertises
+  // is the one the receiver holds to from then on.
+  TCPReceiverMessage send( bool syn = false );
+  TCPReceiverMessage message( bool syn = false ) const; // what send() would return now, advertising nothing
+
+  // Grow or shrink the receive buffer, up to the max capacity. The window never shrinks: a smaller capacity
+  // holds the window from opening further until the reader has drained what was advertised, and the stream
+  // gives up its room only once set_capacity() is called again after that.
+  void set_capacity( uint64_t capacity );
+  uint64_t capacity() const { return capacity_; } // as set last, which the stream's may exceed for a while
+
+  // The shift count for our SYN's window scale option, if this receiver scales its windows
+  std::optional<uint8_t> window_scale() const { return window_scale_; }
 
   // Access the output
   const Reassembler& reassembler() const { return reassembler_; }
@@ -27,7 +54,22 @@ public:
   bool is_reset_ { false }; // Whether the connection has been reset
 
 protected:
+  void add_sack_blocks( TCPReceiverMessage& msg ) const;
+  uint64_t window_edge() const; // the right edge the next message advertises
+  bool check_timestamp( const TCPSenderMessage& message, uint64_t abs_seqno ); // PAWS, and TS.Recent
+
   Reassembler reassembler_;
-  Wrap32 isn_ { 0 };       // Initial Sequence Number
-  bool isn_set_ { false }; // Whether we've received a SYN and set the ISN
+  Wrap32 isn_ { 0 };              // Initial Sequence Number
+  bool isn_set_ { false };        // Whether we've received a SYN and set the ISN
+  bool sack_permitted_ { false }; // Whether the SYN allowed selective acknowledgments (RFC 2018)
+  uint64_t last_out_of_order_ {}; // Stream index of the most recent segment that arrived ahead of a gap
+  std::optional<uint8_t> window_scale_ {}; // Shift count offered for the windows this receiver advertises
+  uint8_t window_shift_ { 0 };              // Shift count in effect: 0 unless both SYNs offered scaling
+  bool timestamps_offered_;                 // Whether this receiver takes part in timestamps (RFC 7323)
+  bool timestamps_ { false };               // Timestamps in effect: both SYNs carried one
+  uint32_t ts_recent_ {};                   // TS.Recent: the timestamp to echo
+  std::optional<uint64_t> sws_mss_;         // The least the window opens by, with SWS avoidance
+  uint64_t capacity_;                       // Most the window may reach past the first unread byte
+  uint64_t max_capacity_;                   // Most set_capacity() may grow it to
+  uint64_t right_edge_ {};                  // Stream index just past the window last advertised, which send() moves
 };
@@ -3,20 +3,88 @@
 #include "tcp_config.hh"
 #include <algorithm>
 #include <iostream>
+#include <optional>
 using namespace std;
 
-// This function is for testing only; don't add extra state to support it.
-uint64_t TCPSender::sequence_numbers_in_flight() const
+namespace {
+constexpr uint64_t TLP_MAX_ACK_DELAY_US = 200'000; // WCDelAckT: the longest a lone segment's ACK may be delayed
+constexpr uint64_t TLP_DEFAULT_PTO_US = 1'000'000;  // probe timeout before any RTT has been measured
+} // namespace
+
+TCPSender::TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
+  : TCPSender( std::move( input ), isn, initial_RTO_ms, Options {} )
+{}
+
+TCPSender::TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms, const Options& options )
+  : input_( std::move( input ) )
+  , isn_( isn )
+  , initial_RTO_ms_( initial_RTO_ms )
+  , current_RTO_( initial_RTO_ms )
+  , adaptive_RTO_( options.adaptive_RTO )
+  , outstanding_segments_()
+  , sack_( options.sack )
+  , window_scale_( options.window_scale )
+  , local_mss_( options.mss )
+  , mss_( options.mss )
+  , timestamps_( options.timestamps )
+  , rack_tlp_( options.rack_tlp )
+  , congestion_( CongestionControl::make( options.congestion, options.mss ) )
+{}
+
+void TCPSender::set_peer_window_scale( uint8_t shift )
 {
-  if ( !sender_syn ) {
-    return 0;
+  // Both SYNs must offer scaling for it to apply, and shifts over 14 are taken as 14 (RFC 7323 section 2.3)
+  if ( window_scale_.has_value() ) {
+    window_shift_ = min<uint8_t>( shift, 14 );
   }
+}
 
-  uint64_t bytes_in_flight = 0;
-  for ( const auto& seg : outstanding_segments_ ) {
-    bytes_in_flight += seg.sequence_length();
+void TCPSender::set_peer_mss( uint64_t peer_mss )
+{
+  const uint64_t mss = max<uint64_t>( min( local_mss_, peer_mss ), 1 );
+  if ( mss == mss_ ) {
+    return;
   }
-  return bytes_in_flight;
+  // The controller's windows count in segments of the MSS. Only the SYN has been sent, so a new
+  // controller loses nothing of note.
+  mss_ = mss;
+  congestion_ = CongestionControl::make( congestion_->algorithm(), mss_ );
+}
+
+void TCPSender::set_peer_timestamps( bool offered )
+{
+  timestamps_ = timestamps_ && offered;
+}
+
+void TCPSender::cork( uint64_t timeout_ms )
+{
+  corked_ = true;
+  cork_timeout_us_ = timeout_ms * 1000;
+}
+
+void TCPSender::uncork( const TransmitFunction& transmit )
+{
+  corked_ = false;
+  push_held_ = true;
+  push( transmit );
+  push_held_ = false;
+}
+
+bool TCPSender::hold_short_segment() const
+{
+  if ( push_held_ ) {
+    return false;
+  }
+  if ( corked_ ) {
+    return !held_since_us_.has_value() || now_us_ < *held_since_us_ + cork_timeout_us_;
+  }
+  return nagle_ && bytes_in_flight_ > 0;
+}
+
+// Kept as a running count: push(), receive() and TCPPeer::active() ask for it on every call
+uint64_t TCPSender::sequence_numbers_in_flight() const
+{
+  return bytes_in_flight_;
 }
 
 // This function is for testing only; don't add extra state to support it.
@@ -27,214 +95,792 @@ uint64_t TCPSender::consecutive_retransmissions() const
 
 void TCPSender::push( const TransmitFunction& transmit )
 {
+  pacing_deferred_ = false;
+
   // Handle error case
   if ( reader().has_error() ) {
     TCPSenderMessage msg;
     msg.RST = true;
-    msg.seqno = sender_syn ? next_seqno_ : isn_;
+    msg.seqno = Wrap32::wrap( next_seqno_, isn_ );
+    stamp( msg );
     transmit( msg );
     return;
   }
 
   // Send SYN if not already sent
   if ( !sender_syn ) {
-    TCPSenderMessage msg;
-    msg.SYN = true;
-    msg.seqno = isn_;
     sender_syn = true;
 
-    // Track as outstanding and start timer
-    uint64_t effective_window_size = window_size - msg.sequence_length();
-    if ( reader().bytes_buffered() > 0 && effective_window_size > 0 ) {
-      size_t read_size = min( { TCPConfig::MAX_PAYLOAD_SIZE,
-                                effective_window_size,
-                                static_cast<uint64_t>( reader().bytes_buffered() ) } );
-
-      if ( read_size > 0 ) {
-        read( reader(), read_size, msg.payload );
-      }
-    }
+    // Data the window already has room for goes with the SYN
+    const uint64_t read_size = min( { mss_, max<uint64_t>( window_size, 1 ) - 1, bytes_unsent() } );
 
     // Check if we should also include FIN with SYN
-    if ( reader().is_finished() && !fin_sent_ ) {
-      msg.FIN = true;
+    if ( writer().is_closed() && read_size == bytes_unsent() && !fin_sent_ ) {
       fin_sent_ = true;
     }
 
-    transmit( msg );
-    outstanding_segments_.push_back( msg );
+    // Track as outstanding and start timer
+    Outstanding& seg = track( read_size, true, fin_sent_ );
+    send( seg, transmit );
     if ( !timer_running_ ) {
       start_timer();
     }
-    next_seqno_ = isn_ + msg.sequence_length();
     return;
   }
 
-  // Calculate window size and space
+  // Fast retransmit, and retransmit after a partial ACK in fast recovery: the window does not apply
+  if ( retransmit_due_ ) {
+    retransmit_due_ = false;
+    if ( !outstanding_segments_.empty() ) {
+      Outstanding& first = outstanding_segments_.front();
+      resend_in_recovery( first, transmit );
+      high_rxt_ = max( high_rxt_, first.end() );
+    }
+  }
+
+  // Limited transmit (RFC 3042): each of the first two duplicate ACKs lets one new segment out past cwnd,
+  // so that a small window can still produce the three duplicate ACKs fast retransmit needs
+  uint64_t cwnd = congestion_->cwnd();
+  if ( !fast_recovery_ && dup_acks_ > 0 && dup_acks_ < 3 ) {
+    cwnd += min( dup_acks_ * mss_, UINT64_MAX - cwnd );
+  }
+
+  // In SACK recovery, cwnd limits the pipe rather than everything outstanding, and the holes deemed lost
+  // go out before new data (RFC 6675 NextSeg rule 1)
+  const bool sack_recovery = fast_recovery_ && sack_seen_;
+  if ( sack_recovery ) {
+    while ( retransmit_hole( transmit, cwnd, true ) ) {}
+  }
+
+  // Calculate window size and space: the receiver's window (1 when it is zero), capped by the congestion window
   uint64_t bytes_in_flight = sequence_numbers_in_flight();
-  uint64_t effective_window_size = window_size > 0 ? window_size : 1;
+  const uint64_t receive_window = window_size > 0 ? window_size : 1;
+  const uint64_t in_cwnd = sack_recovery ? pipe() : bytes_in_flight;
 
   // Only proceed if we have window space
-  if ( bytes_in_flight >= effective_window_size ) {
+  if ( bytes_in_flight >= receive_window || in_cwnd >= cwnd ) {
     return; // Window is full
   }
 
-  uint64_t remaining_window = effective_window_size - bytes_in_flight;
+  uint64_t remaining_window = min( receive_window - bytes_in_flight, cwnd - in_cwnd );
+
+  // With pacing, segments go out no faster than the congestion controller's rate. Those that fell
+  // due since the previous tick may go now; time before that was idle, not credit for a burst.
+  const uint64_t pacing_rate = congestion_->pacing_rate();
+  next_send_us_ = max( next_send_us_, last_tick_us_ );
 
   // Continue sending data and FIN while we have window space
   while ( remaining_window > 0 ) {
-    TCPSenderMessage msg;
-    msg.seqno = next_seqno_;
-    bool segment_sent = false;
+    if ( pacing_rate > 0 && next_send_us_ > now_us_ ) {
+      pacing_deferred_ = bytes_unsent() > 0 || ( writer().is_closed() && !fin_sent_ );
+      break; // tick() will push again when the next segment is due
+    }
 
     // Send data if available and window has space
-    if ( reader().bytes_buffered() > 0 && remaining_window > 0 ) {
-      size_t read_size = min(
-        { TCPConfig::MAX_PAYLOAD_SIZE, remaining_window, static_cast<uint64_t>( reader().bytes_buffered() ) } );
+    const uint64_t read_size = min( { mss_, remaining_window, bytes_unsent() } );
 
-      if ( read_size > 0 ) {
-        read( reader(), read_size, msg.payload );
-        segment_sent = true;
-      }
+    // Add FIN if stream is finished and we have room and haven't sent FIN yet
+    const bool fin = writer().is_closed() && !fin_sent_ && read_size + 1 <= remaining_window
+                     && read_size == bytes_unsent();
+
+    // Send the segment if it contains data or flags
+    if ( read_size == 0 && !fin ) {
+      break; // No more data to send
     }
 
-    // Add FIN if stream is finished and we have room and haven't sent FIN yet
-    if ( writer().is_closed() && !fin_sent_ && msg.sequence_length() + 1 <= remaining_window
-         && reader().bytes_buffered() == 0 ) {
-      msg.FIN = true;
-      fin_sent_ = true;
-      segment_sent = true;
+    // A segment short of the MSS because the stream has no more data may have to wait for more
+    if ( !fin && read_size < mss_ && read_size == bytes_unsent() && hold_short_segment() ) {
+      held_since_us_ = held_since_us_.value_or( now_us_ );
+      break;
     }
+    held_since_us_.reset();
+    fin_sent_ = fin_sent_ || fin;
 
-    // Send the segment if it contains data or flags
-    if ( segment_sent ) {
-      uint64_t seg_length = msg.sequence_length();
-      next_seqno_ = next_seqno_ + seg_length;
-
-      // Track as outstanding and start timer if needed
-      outstanding_segments_.push_back( msg );
-      if ( !timer_running_ ) {
-        start_timer();
-      }
+    // Track as outstanding and start timer if needed
+    Outstanding& seg = track( read_size, false, fin );
+    if ( !timer_running_ ) {
+      start_timer();
+    }
+    arm_loss_probe();
 
-      transmit( msg );
-      remaining_window -= seg_length;
+    send( seg, transmit );
+    remaining_window -= seg.length;
+    if ( pacing_rate > 0 ) {
+      next_send_us_ += seg.length * 1'000'000 / pacing_rate;
+    }
 
-      // Break after sending FIN - nothing more to send
-      if ( msg.FIN ) {
-        break;
-      }
-    } else {
-      break; // No more data to send
+    // Break after sending FIN - nothing more to send
+    if ( fin ) {
+      break;
     }
   }
+
+  // Rule 3: with no new data to fill the window, resend one more hole even if not yet deemed lost
+  if ( sack_recovery && !pacing_deferred_ ) {
+    retransmit_hole( transmit, cwnd, false );
+  }
 }
 
 TCPSenderMessage TCPSender::make_empty_message() const
 {
   TCPSenderMessage msg;
-  msg.seqno = sender_syn ? next_seqno_ : isn_;
+  msg.seqno = Wrap32::wrap( next_seqno_, isn_ );
 
   // FIXED: Set RST flag if the stream has an error
   if ( reader().has_error() ) {
     msg.RST = true;
   }
+  stamp( msg );
 
   return msg;
 }
 
-void TCPSender::receive( const TCPReceiverMessage& msg )
+void TCPSender::receive( const TCPReceiverMessage& msg, bool with_data )
 {
   if ( msg.RST ) {
     writer().set_error();
     return;
   }
 
-  // Update window size
-  window_size = msg.window_size;
+  // Update window size, in sequence numbers once window scaling is in effect
+  const uint32_t prior_window_size = window_size;
+  window_size = static_cast<uint32_t>( msg.window_size ) << window_shift_;
 
   // If no ackno is present, nothing else to process
   if ( !msg.ackno.has_value() ) {
     return;
   }
 
-  Wrap32 ackno = msg.ackno.value();
-  uint64_t abs_next_seqno = next_seqno_.unwrap( isn_, 0 );
-  uint64_t abs_ackno = ackno.unwrap( isn_, abs_next_seqno );
+  uint64_t abs_ackno = msg.ackno->unwrap( isn_, next_seqno_ );
 
   // Check if this ackno is valid (not acknowledging unsent data)
-  if ( abs_ackno > abs_next_seqno ) {
+  if ( abs_ackno > next_seqno_ ) {
     return; // Invalid ackno, ignore
   }
 
+  // Mark what the SACK blocks cover, before deciding whether this is a duplicate ACK
+  const uint64_t newly_sacked = update_scoreboard( msg );
+
   // Check if this ackno acknowledges new data
   bool acknowledged_new_data = false;
-  uint64_t abs_last_ackno = last_ackno_.unwrap( isn_, abs_next_seqno );
+  const uint64_t abs_last_ackno = last_ackno_;
+
+  uint64_t newly_acked = 0;
 
   if ( abs_ackno > abs_last_ackno ) {
     acknowledged_new_data = true;
-    last_ackno_ = ackno;
+    last_ackno_ = abs_ackno;
+    // the SYN does not count towards the congestion window's growth
+    newly_acked = abs_ackno - max<uint64_t>( abs_last_ackno, 1 );
+  } else if ( abs_ackno == abs_last_ackno && abs_ackno > 0 && !outstanding_segments_.empty()
+              && ( sack_seen_ ? newly_sacked > 0
+                              : !with_data && window_size > 0 && window_size == prior_window_size ) ) {
+    // Duplicate ACK (RFC 5681, or with SACK, RFC 6675: one that SACKs more data): a segment after the first
+    // outstanding one has arrived. Fast retransmit and fast recovery are part of congestion control;
+    // without a controller, only the timer resends.
+    if ( congestion_->algorithm() != CongestionControl::Algorithm::None ) {
+      rack_detect_losses();
+      duplicate_ack();
+    }
+    return;
   }
 
-  // Remove fully acknowledged segments
-  auto it = outstanding_segments_.begin();
-  while ( it != outstanding_segments_.end() ) {
-    uint64_t seg_start = it->seqno.unwrap( isn_, abs_next_seqno );
-    uint64_t seg_end = seg_start + it->sequence_length();
+  // A duplicate ACK of the end of a loss probe, with nothing new SACKed: the probe was a copy of a segment
+  // that had arrived, so nothing was lost (RFC 8985 section 7.4.2)
+  if ( tlp_end_.has_value() && abs_ackno == abs_last_ackno && abs_ackno == *tlp_end_ && msg.sack.empty() ) {
+    tlp_end_.reset();
+  }
 
-    if ( seg_end <= abs_ackno ) {
-      // Segment is fully acknowledged
-      it = outstanding_segments_.erase( it );
-    } else {
-      ++it;
+  // Remove fully acknowledged segments, keeping the last one sent to measure the path with, and free
+  // their payload from the stream. The queue is in sequence order, so they are all at the front.
+  optional<Outstanding> newest_acked;
+  uint64_t acked_payload = 0;
+  while ( !outstanding_segments_.empty() && outstanding_segments_.front().end() <= abs_ackno ) {
+    const Outstanding& seg = outstanding_segments_.front();
+    if ( !seg.sacked ) {
+      rack_update( seg, seg.end() );
     }
+    forget( seg );
+    bytes_in_flight_ -= seg.length;
+    acked_payload += seg.payload_size();
+    newest_acked = seg;
+    outstanding_segments_.pop_front();
+  }
+  reader().pop( acked_payload );
+  // Runs wholly acknowledged go; one partly acknowledged still says which of the rest are SACKed
+  while ( !sacked_ranges_.empty() && sacked_ranges_.begin()->second <= abs_ackno ) {
+    sacked_ranges_.erase( sacked_ranges_.begin() );
   }
 
   // Handle timer and RTO based on new acknowledgments
   if ( acknowledged_new_data ) {
-    // Reset RTO to initial value
-    current_RTO_ = initial_RTO_ms_;
+    // Karn's rule: the ACK of a resent segment could be for either copy, so it gives no RTT. With
+    // timestamps, the echo says which copy, so every such ACK does (RFC 7323 section 4).
+    optional<uint64_t> rtt_us;
+    if ( timestamps_ && msg.timestamp_echo.has_value() ) {
+      rtt_us = timestamp_rtt( *msg.timestamp_echo, newest_acked );
+    } else if ( newest_acked.has_value() && !newest_acked->retransmitted ) {
+      rtt_us = now_us_ - newest_acked->sent_us;
+    }
+    if ( rtt_us.has_value() ) {
+      update_rtt( *rtt_us );
+    }
+
+    if ( !adaptive_RTO_ ) {
+      // Reset RTO to initial value
+      current_RTO_ = initial_RTO_ms_;
+    } else if ( rtt_us.has_value() ) {
+      // RTO = SRTT + max(G, 4 * RTTVAR), with a clock granularity G of 1 ms; a backed-off RTO stays
+      // until a segment sent only once is acknowledged
+      const uint64_t rto_us = srtt_us_ + max<uint64_t>( 1000, 4 * rttvar_us_ );
+      current_RTO_ = clamp( ( rto_us + 999 ) / 1000, adaptive_RTO_->min_ms, adaptive_RTO_->max_ms );
+    }
 
     // Reset consecutive retransmissions
     consecutive_retrans_count_ = 0;
 
+    // A partial ACK in fast recovery means the next segment was lost too: resend it straight away
+    dup_acks_ = 0;
+    if ( fast_recovery_ ) {
+      fast_recovery_ = abs_ackno <= recover_;
+      retransmit_due_ = fast_recovery_ && !sack_seen_ && !outstanding_segments_.empty();
+      high_rxt_ = max( high_rxt_, abs_ackno );
+    }
+    mark_losses();
+
+    // Past the end of a loss probe, with more data acknowledged after it: the probe repaired a loss, which
+    // calls for the same response as any other
+    if ( tlp_end_.has_value() && abs_ackno > *tlp_end_ ) {
+      tlp_end_.reset();
+      if ( !fast_recovery_ ) {
+        congestion_->on_loss( congestion_event( 0 ) );
+      }
+    }
+
+    // RACK: segments sent before one that has now been delivered, and not delivered within a reordering
+    // window after it, are lost
+    if ( congestion_->algorithm() != CongestionControl::Algorithm::None && rack_detect_losses()
+         && !fast_recovery_ ) {
+      const CongestionControl::Event event = congestion_event( 0 );
+      if ( event.ackno > recover_ ) {
+        enter_recovery( event );
+      }
+    }
+
     // Restart timer if we still have outstanding data
     if ( !outstanding_segments_.empty() ) {
       start_timer();
     } else {
       timer_running_ = false;
     }
+    arm_loss_probe();
+
+    delivered_ += abs_ackno - abs_last_ackno;
+    delivered_us_ = now_us_;
+
+    if ( newly_acked > 0 ) {
+      CongestionControl::Event event = congestion_event( newly_acked );
+      event.rtt_us = rtt_us;
+      if ( newest_acked.has_value() ) {
+        // Delivery rate: what was acknowledged between that segment going out and its ACK
+        if ( now_us_ > newest_acked->delivered_us ) {
+          event.delivery_rate
+            = ( delivered_ - newest_acked->delivered ) * 1'000'000 / ( now_us_ - newest_acked->delivered_us );
+        }
+      }
+      congestion_->on_ack( event );
+    }
   }
 }
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
-  timer_elapsed_ += ms_since_last_tick;
+  tick_us( ms_since_last_tick * 1000, transmit );
+}
+
+void TCPSender::tick_us( uint64_t us_since_last_tick, const TransmitFunction& transmit )
+{
+  timer_elapsed_us_ += us_since_last_tick;
+  last_tick_us_ = now_us_;
+  now_us_ += us_since_last_tick;
+
+  // RACK's reordering window ran out for a segment sent before one that was delivered: it is lost
+  if ( rack_timer_us_.has_value() && now_us_ >= *rack_timer_us_ ) {
+    rack_timer_us_.reset();
+    if ( rack_detect_losses() ) {
+      const CongestionControl::Event event = congestion_event( 0 );
+      if ( !fast_recovery_ && event.ackno > recover_ ) {
+        enter_recovery( event );
+      }
+      push( transmit );
+    }
+  }
+
+  // Tail loss probe: nothing has been heard of the flight for about two round trips. Resend its last
+  // segment, so that the ACK of the probe, with SACK, shows RACK what else is missing.
+  if ( tlp_timer_us_.has_value() && now_us_ >= *tlp_timer_us_ ) {
+    tlp_timer_us_.reset();
+    if ( timer_running_ && !outstanding_segments_.empty() && !outstanding_segments_.back().sacked ) {
+      retransmit( outstanding_segments_.back(), transmit );
+      tlp_end_ = outstanding_segments_.back().end();
+      ++loss_probes_;
+      start_timer();
+    }
+  }
 
   // Check if timer has expired'
-  if ( timer_running_ && timer_elapsed_ >= current_RTO_ ) {
+  if ( timer_running_ && timer_elapsed_us_ >= current_RTO_ * 1000 ) {
 
     // Timer expired - retransmit earliest outstanding segment
     if ( !outstanding_segments_.empty() ) {
       // Find earliest segment (should be first in queue)
-      TCPSenderMessage earliest_seg = outstanding_segments_.front();
+      Outstanding& earliest_seg = outstanding_segments_.front();
 
       // Retransmit it
-      transmit( earliest_seg );
+      retransmit( earliest_seg, transmit );
+      // A timeout ends fast recovery, and duplicate ACKs for what was sent before it start none
+      dup_acks_ = 0;
+      fast_recovery_ = false;
+      retransmit_due_ = false;
+      recover_ = next_seqno_ - 1;
+      forget_losses();
+      tlp_end_.reset();
       // Handle backoff only if window size is nonzero
       if ( window_size > 0 ) {
+        // Only the first timeout of a series is a new congestion event
+        if ( consecutive_retrans_count_ == 0 ) {
+          congestion_->on_timeout( congestion_event( 0 ) );
+        }
         consecutive_retrans_count_++;
         current_RTO_ *= 2; // Exponential backoff
+        if ( adaptive_RTO_ ) {
+          current_RTO_ = min( current_RTO_, adaptive_RTO_->max_ms );
+        }
       }
 
       // Restart timer
       start_timer();
     }
   }
+
+  // Send whatever pacing held back and is now due, and a short segment the cork has held long enough
+  if ( pacing_deferred_ || ( corked_ && held_since_us_.has_value() && !hold_short_segment() ) ) {
+    push( transmit );
+  }
+}
+
+void TCPSender::duplicate_ack()
+{
+  const CongestionControl::Event event = congestion_event( 0 );
+  congestion_->on_ack( event );
+  if ( fast_recovery_ ) {
+    return;
+  }
+
+  // Fast retransmit on the third, or with SACK once the first segment is deemed lost, unless the ACK has not
+  // yet passed the last loss (RFC 6582 section 3.2, RFC 6675 section 5)
+  const bool lost = ++dup_acks_ == 3 || outstanding_segments_.front().lost;
+  if ( lost && event.ackno > recover_ ) {
+    mark_lost( outstanding_segments_.front() );
+    enter_recovery( event );
+  }
+}
+
+void TCPSender::enter_recovery( const CongestionControl::Event& event )
+{
+  recover_ = event.next_seqno - 1;
+  fast_recovery_ = true;
+  retransmit_due_ = outstanding_segments_.front().lost;
+  high_rxt_ = event.ackno;
+  forget_resends();
+  tlp_timer_us_.reset();
+  tlp_end_.reset();
+  congestion_->on_loss( event );
+}
+
+uint64_t TCPSender::update_scoreboard( const TCPReceiverMessage& msg )
+{
+  if ( !sack_ || msg.sack.empty() ) {
+    return 0;
+  }
+  sack_seen_ = true;
+
+  // A segment counts as SACKed once a block covers all of it. Blocks repeat what earlier ones reported, so
+  // the runs of segments SACKed already are skipped, and only the gaps a block fills are visited.
+  uint64_t newly_sacked = 0;
+  for ( const auto& block : msg.sack ) {
+    const uint64_t left = block.left.unwrap( isn_, next_seqno_ );
+    const uint64_t right = block.right.unwrap( isn_, next_seqno_ );
+    auto it = find_segment( left );
+    while ( it != outstanding_segments_.end() && it->end() <= right ) {
+      const auto run = sacked_ranges_.upper_bound( it->start );
+      if ( run != sacked_ranges_.begin() && prev( run )->second > it->start ) {
+        it = find_segment( prev( run )->second );
+        continue;
+      }
+      mark_sacked( *it );
+      rack_update( *it, it->end() );
+      newly_sacked += it->length;
+      highest_sacked_end_ = max( highest_sacked_end_, it->end() );
+      ++it;
+    }
+  }
+  mark_losses();
+  return newly_sacked;
+}
+
+void TCPSender::mark_losses()
+{
+  if ( !sack_seen_ ) {
+    return;
+  }
+  // IsLost: three SACKed segments above, or more than two segments' worth of SACKed bytes. Once that holds
+  // for a segment, walking down from the highest SACKed one, it holds for every segment below. Those below
+  // lost_below_ have been marked already, so only the range from there up to the new point is marked.
+  uint64_t sacked_segments = 0;
+  uint64_t sacked_bytes = 0;
+  uint64_t lost_end = lost_below_;
+  for ( auto it = make_reverse_iterator( find_segment( highest_sacked_end_ ) );
+        it != outstanding_segments_.rend() && it->start >= lost_below_;
+        ++it ) {
+    if ( sacked_segments >= 3 || sacked_bytes > 2 * mss_ ) {
+      lost_end = it->end();
+      break;
+    }
+    if ( it->sacked ) {
+      ++sacked_segments;
+      sacked_bytes += it->length;
+    }
+  }
+  for ( auto it = find_segment( lost_below_ ); it != outstanding_segments_.end() && it->end() <= lost_end; ++it ) {
+    if ( !it->sacked ) {
+      mark_lost( *it );
+    }
+  }
+  lost_below_ = lost_end;
+}
+
+deque<TCPSender::Outstanding>::iterator TCPSender::find_segment( uint64_t seqno )
+{
+  return partition_point( outstanding_segments_.begin(),
+                          outstanding_segments_.end(),
+                          [seqno]( const Outstanding& seg ) { return seg.start < seqno; } );
+}
+
+// SetPipe (RFC 6675): each sequence number outstanding that is neither SACKed nor deemed lost, and again
+// each one resent in this recovery and not SACKed since, from the counts the scoreboard keeps
+uint64_t TCPSender::pipe() const
+{
+  return bytes_in_flight_ - sacked_bytes_ - lost_bytes_ + retransmitted_in_pipe_;
+}
+
+void TCPSender::mark_sacked( Outstanding& seg )
+{
+  seg.sacked = true;
+  sacked_bytes_ += seg.length;
+
+  // Join the run that ends where it starts, and the one that starts where it ends
+  uint64_t start = seg.start;
+  uint64_t end = seg.end();
+  auto next = sacked_ranges_.lower_bound( start );
+  if ( next != sacked_ranges_.begin() && prev( next )->second == start ) {
+    start = prev( next )->first;
+  }
+  if ( next != sacked_ranges_.end() && next->first == end ) {
+    end = next->second;
+    sacked_ranges_.erase( next );
+  }
+  sacked_ranges_[start] = end;
+
+  if ( seg.lost ) {
+    lost_bytes_ -= seg.length;
+  }
+  if ( seg.resent_in_recovery ) {
+    retransmitted_in_pipe_ -= seg.length;
+  }
+}
+
+void TCPSender::mark_lost( Outstanding& seg )
+{
+  if ( seg.lost ) {
+    return;
+  }
+  seg.lost = true;
+  if ( !seg.sacked ) {
+    lost_bytes_ += seg.length;
+  }
+}
+
+void TCPSender::resend_in_recovery( Outstanding& seg, const TransmitFunction& transmit )
+{
+  retransmit( seg, transmit );
+  if ( !seg.resent_in_recovery && !seg.sacked ) {
+    seg.resent_in_recovery = true;
+    retransmitted_in_pipe_ += seg.length;
+  }
+}
+
+void TCPSender::forget( const Outstanding& seg )
+{
+  if ( seg.sacked ) {
+    sacked_bytes_ -= seg.length;
+    return;
+  }
+  if ( seg.lost ) {
+    lost_bytes_ -= seg.length;
+  }
+  if ( seg.resent_in_recovery ) {
+    retransmitted_in_pipe_ -= seg.length;
+  }
+}
+
+void TCPSender::forget_resends()
+{
+  if ( retransmitted_in_pipe_ == 0 ) {
+    return; // only SACKed segments can still be marked, and they no longer count
+  }
+  for ( auto& seg : outstanding_segments_ ) {
+    seg.resent_in_recovery = false;
+  }
+  retransmitted_in_pipe_ = 0;
+}
+
+// After a timeout, recovery starts over (RFC 6675 section 5.1, RFC 8985 section 7.3): the SACKs that follow
+// deem segments lost afresh, and NextSeg starts again from the front. SACKed segments stay SACKed, and a
+// resent segment stays `retransmitted`, which Karn's rule still needs.
+void TCPSender::forget_losses()
+{
+  forget_resends();
+  for ( auto& seg : outstanding_segments_ ) {
+    seg.lost = false;
+  }
+  lost_bytes_ = 0;
+  lost_below_ = 0;
+  rack_checked_ = 0;
+  high_rxt_ = 0;
+}
+
+bool TCPSender::retransmit_hole( const TransmitFunction& transmit, uint64_t cwnd, bool lost_only )
+{
+  // NextSeg: the first segment that is not SACKed, has not been resent in this recovery and lies below
+  // the highest SACKed one; for rule 1 it must also be deemed lost
+  if ( pipe() >= cwnd ) {
+    return false;
+  }
+  // SACKed segments stay SACKed, so high_rxt_ moves past those at the start of the range, and later calls
+  // need not look at them again
+  bool settled = true;
+  for ( auto it = find_segment( high_rxt_ );
+        it != outstanding_segments_.end() && it->end() < highest_sacked_end_;
+        ++it ) {
+    if ( it->sacked ) {
+      if ( settled ) {
+        high_rxt_ = it->end();
+      }
+      continue;
+    }
+    if ( lost_only && !it->lost ) {
+      settled = false;
+      continue;
+    }
+    resend_in_recovery( *it, transmit );
+    high_rxt_ = it->end();
+    return true;
+  }
+  return false;
 }
 
 void TCPSender::start_timer()
 {
   timer_running_ = true;
-  timer_elapsed_ = 0;
-}
\ No newline at end of file
+  timer_elapsed_us_ = 0;
+}
+
+void TCPSender::stamp( TCPSenderMessage& msg ) const
+{
+  if ( timestamps_ ) {
+    msg.timestamp = static_cast<uint32_t>( now_us_ / 1000 );
+  }
+}
+
+void TCPSender::retransmit( Outstanding& seg, const TransmitFunction& transmit )
+{
+  seg.last_sent_us = now_us_;
+  seg.retransmitted = true;
+  send( seg, transmit );
+}
+
+void TCPSender::send( Outstanding& seg, const TransmitFunction& transmit )
+{
+  TCPSenderMessage msg = segment( seg );
+  stamp( msg );
+  seg.timestamp = msg.timestamp;
+  transmit( msg );
+}
+
+TCPSenderMessage TCPSender::segment( const Outstanding& seg ) const
+{
+  TCPSenderMessage msg;
+  msg.seqno = Wrap32::wrap( seg.start, isn_ );
+  if ( seg.SYN ) {
+    msg.SYN = true;
+    msg.SACK_permitted = sack_;
+    msg.window_scale = window_scale_;
+    msg.MSS = static_cast<uint16_t>( min<uint64_t>( local_mss_, UINT16_MAX ) );
+  }
+  // The payload's place in the stream: the SYN takes sequence number 0, and the stream starts after it
+  const uint64_t offset = seg.start + seg.SYN - 1 - reader().bytes_popped();
+  msg.payload.reserve( seg.payload_size() );
+  for ( const auto region : reader().peek_range( offset, seg.payload_size() ) ) {
+    msg.payload.append( region );
+  }
+  msg.FIN = seg.FIN;
+  return msg;
+}
+
+optional<uint64_t> TCPSender::timestamp_rtt( uint32_t echo, const optional<Outstanding>& newest_acked ) const
+{
+  // The echo of the newest acknowledged segment's latest copy: that copy's send time, to the microsecond
+  if ( newest_acked.has_value() && newest_acked->timestamp == echo ) {
+    return now_us_ - newest_acked->last_sent_us;
+  }
+  // Otherwise, to the millisecond the echoed timestamp counts in, unless it is from the future
+  const uint32_t elapsed_ms = static_cast<uint32_t>( now_us_ / 1000 ) - echo;
+  if ( elapsed_ms > INT32_MAX ) {
+    return nullopt;
+  }
+  return uint64_t { elapsed_ms } * 1000;
+}
+
+void TCPSender::update_rtt( uint64_t rtt_us )
+{
+  if ( rtt_samples_ == 0 ) {
+    srtt_us_ = rtt_us;
+    rttvar_us_ = rtt_us / 2;
+  } else {
+    // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R
+    const uint64_t deviation = srtt_us_ > rtt_us ? srtt_us_ - rtt_us : rtt_us - srtt_us_;
+    rttvar_us_ = ( 3 * rttvar_us_ + deviation ) / 4;
+    srtt_us_ = ( 7 * srtt_us_ + rtt_us ) / 8;
+  }
+  ++rtt_samples_;
+  min_rtt_us_ = min( min_rtt_us_, rtt_us );
+}
+
+void TCPSender::rack_update( const Outstanding& seg, uint64_t end )
+{
+  if ( !rack_tlp_ ) {
+    return;
+  }
+  // An ACK sooner than any round trip so far, of a resent segment, is for an earlier copy: it says
+  // nothing of when the latest copy arrived (RFC 8985 section 6.2, step 2)
+  const uint64_t rtt_us = now_us_ - seg.last_sent_us;
+  if ( seg.retransmitted && rtt_us < min_rtt_us_ ) {
+    return;
+  }
+  min_rtt_us_ = min( min_rtt_us_, rtt_us );
+
+  // Delivered below data delivered before it, without having been resent: the path reorders
+  if ( !seg.retransmitted && end < rack_fack_ ) {
+    rack_reordering_ = true;
+  }
+  rack_fack_ = max( rack_fack_, end );
+
+  if ( seg.last_sent_us > rack_xmit_us_ || ( seg.last_sent_us == rack_xmit_us_ && end > rack_end_ ) ) {
+    rack_xmit_us_ = seg.last_sent_us;
+    rack_end_ = end;
+    rack_rtt_us_ = rtt_us;
+  }
+}
+
+bool TCPSender::rack_detect_losses()
+{
+  rack_timer_us_.reset();
+  if ( !rack_tlp_ || !sack_seen_ || rack_end_ == 0 ) {
+    return false;
+  }
+  // The reordering window: a quarter of the minimum RTT, unless in recovery on a path not seen to reorder
+  const uint64_t reo_wnd_us = rack_reordering_ || !fast_recovery_ ? min( min_rtt_us_ / 4, srtt_us_ ) : 0;
+
+  // Each segment sent before the most recently sent one that was delivered is lost once a round trip and
+  // the reordering window have passed since it went out; until then, the timer waits for the first of them.
+  // Segments first went out in sequence order, so the walk stops at the first one sent after that one.
+  // Segments SACKed or lost stay so, and the walk starts after those at the front of the queue.
+  bool marked = false;
+  bool settled = true;
+  for ( auto it = find_segment( rack_checked_ ); it != outstanding_segments_.end(); ++it ) {
+    Outstanding& seg = *it;
+    if ( seg.sent_us > rack_xmit_us_ || ( seg.sent_us == rack_xmit_us_ && seg.end() > rack_end_ ) ) {
+      break;
+    }
+    const bool sent_before
+      = seg.last_sent_us < rack_xmit_us_ || ( seg.last_sent_us == rack_xmit_us_ && seg.end() <= rack_end_ );
+    if ( !seg.sacked && !seg.lost && sent_before ) {
+      const uint64_t deadline_us = seg.last_sent_us + rack_rtt_us_ + reo_wnd_us;
+      if ( now_us_ >= deadline_us ) {
+        mark_lost( seg );
+        marked = true;
+      } else if ( !rack_timer_us_.has_value() || deadline_us < *rack_timer_us_ ) {
+        rack_timer_us_ = deadline_us;
+      }
+    }
+    settled = settled && ( seg.sacked || seg.lost );
+    if ( settled ) {
+      rack_checked_ = seg.end();
+    }
+  }
+  return marked;
+}
+
+void TCPSender::arm_loss_probe()
+{
+  // One probe per episode, outside recovery, for data after the handshake; with SACK, the probe's ACK
+  // lets RACK find the rest of the losses
+  tlp_timer_us_.reset();
+  if ( !rack_tlp_ || !sack_ || congestion_->algorithm() == CongestionControl::Algorithm::None || fast_recovery_
+       || tlp_end_.has_value() || outstanding_segments_.empty() || outstanding_segments_.front().SYN ) {
+    return;
+  }
+  // PTO = 2 * SRTT, plus the longest an ACK may be delayed if only one segment is out to draw it, but never
+  // later than the retransmission timer (RFC 8985 section 7.2)
+  uint64_t pto_us = rtt_samples_ > 0 ? 2 * srtt_us_ : TLP_DEFAULT_PTO_US;
+  if ( outstanding_segments_.size() == 1 ) {
+    pto_us += TLP_MAX_ACK_DELAY_US;
+  }
+  const uint64_t rto_us = current_RTO_ * 1000;
+  pto_us = min( pto_us, rto_us - min( timer_elapsed_us_, rto_us ) );
+  tlp_timer_us_ = now_us_ + pto_us;
+}
+
+TCPSender::Outstanding& TCPSender::track( uint64_t payload_size, bool SYN, bool FIN )
+{
+  const uint64_t length = SYN + payload_size + FIN;
+  outstanding_segments_.push_back( { next_seqno_,
+                                     length,
+                                     SYN,
+                                     FIN,
+                                     nullopt,
+                                     now_us_,
+                                     now_us_,
+                                     delivered_,
+                                     delivered_us_,
+                                     false,
+                                     false,
+                                     false,
+                                     false } );
+  next_seqno_ += length;
+  bytes_sent_ += payload_size;
+  bytes_in_flight_ += length;
+  return outstanding_segments_.back();
+}
+
+CongestionControl::Event TCPSender::congestion_event( uint64_t newly_acked ) const
+{
+  return { .now_us = now_us_,
+           .ackno = last_ackno_,
+           .next_seqno = next_seqno_,
+           .in_flight = sequence_numbers_in_flight(),
+           .newly_acked = newly_acked,
+           .srtt_us = srtt_us_,
+           .sack = sack_seen_ };
+}
@@ -1,30 +1,68 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "congestion_control.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
 #include <deque>
 #include <functional>
+#include <map>
+#include <memory>
+#include <optional>
 class TCPSender
 {
 public:
-  /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
-  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
-    : input_( std::move( input ) )
-    , isn_( isn )
-    , next_seqno_( isn )
-    , last_ackno_( isn )
-    , initial_RTO_ms_( initial_RTO_ms )
-    , current_RTO_( initial_RTO_ms )
-    , outstanding_segments_()
-  {}
+  /* Bounds on a Retransmission Timeout estimated from round-trip times (RFC 6298) */
+  struct RTOBounds
+  {
+    uint64_t min_ms;
+    uint64_t max_ms;
+  };
+
+  /* What the sender does beyond the basics; by default, none of it.
+     Without a congestion controller, only the receiver's window limits the sender. With RTO bounds, the RTO
+     adapts to the measured round-trip time; without, it stays at the default. With `sack`, the SYN offers
+     selective acknowledgments, and SACK blocks from the peer steer loss recovery (RFC 6675). With
+     `window_scale`, the SYN offers window scaling (RFC 7323) with that shift count for the windows our
+     receiver advertises. Segments carry at most `mss` bytes of payload, or the peer's MSS if that is
+     smaller; the SYN offers `mss` as the largest this side receives. With `timestamps`, the SYN offers the
+     timestamps option (RFC 7323), and if the peer's does too, every segment carries one and every ACK of
+     new data gives an RTT sample. With `rack_tlp`, a segment counts as lost once one sent after it has been
+     SACKed and a reordering window has passed (RACK), and a tail of the flight that draws no ACK is probed
+     by resending its last segment after about two round trips (TLP), both as in RFC 8985. */
+  struct Options
+  {
+    CongestionControl::Algorithm congestion = CongestionControl::Algorithm::None;
+    std::optional<RTOBounds> adaptive_RTO = std::nullopt;
+    bool sack = false;
+    std::optional<uint8_t> window_scale = std::nullopt;
+    uint64_t mss = TCPConfig::MAX_PAYLOAD_SIZE;
+    bool timestamps = false;
+    bool rack_tlp = false;
+  };
+
+  /* Construct TCP sender with given default Retransmission Timeout, possible ISN and options */
+  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms );
+  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms, const Options& options );
 
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
 
-  /* Receive and process a TCPReceiverMessage from the peer's receiver */
-  void receive( const TCPReceiverMessage& msg );
+  /* Receive and process a TCPReceiverMessage from the peer's receiver. An ACK that arrives with data
+     (`with_data`) is never taken as a duplicate ACK. */
+  void receive( const TCPReceiverMessage& msg, bool with_data = false );
+
+  /* The peer's SYN offered window scaling with this shift count: if ours did too, the windows in the
+     peer's later messages are in units of 2^shift */
+  void set_peer_window_scale( uint8_t shift );
+
+  /* The peer's SYN announced the largest segment it receives: segments are no larger than it, or ours */
+  void set_peer_mss( uint64_t peer_mss );
+
+  /* Whether the peer's SYN offered timestamps: segments carry them from then on only if it did */
+  void set_peer_timestamps( bool offered );
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
   using TransmitFunction = std::function<void( const TCPSenderMessage& )>;
@@ -34,10 +72,39 @@ public:
 
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called */
   void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
+  void tick_us( uint64_t us_since_last_tick, const TransmitFunction& transmit ); // the same, in microseconds
+
+  /* Nagle's algorithm (RFC 896): while data is unacknowledged, a segment short of the MSS waits for more
+     data or for the ACK, unless it carries the FIN. Off unless enabled. */
+  void set_nagle( bool enabled ) { nagle_ = enabled; }
+
+  /* While corked, only full-sized segments (or the FIN) go out; a shorter one waits at most `timeout_ms`.
+     Uncorking sends what was held at once, whatever Nagle would say. */
+  void cork( uint64_t timeout_ms );
+  void uncork( const TransmitFunction& transmit );
 
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // For testing: how many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // For testing: how many consecutive retransmissions have happened?
+  const CongestionControl& congestion_control() const { return *congestion_; }
+  uint64_t mss() const { return mss_; } // Largest payload in a segment: the smaller of ours and the peer's MSS
+  bool pacing_deferred() const { return pacing_deferred_; } // Is data waiting for tick() to pace it out?
+  uint64_t duplicate_acks() const { return dup_acks_; }      // Duplicate ACKs in a row, outside fast recovery
+  bool in_fast_recovery() const { return fast_recovery_; }
+  uint64_t pipe() const; // Sequence numbers estimated to be in the network: not SACKed or lost, plus resent ones
+  uint64_t loss_probes() const { return loss_probes_; } // Tail loss probes sent so far
+  uint64_t bytes_unsent() const { return writer().bytes_pushed() - bytes_sent_; } // Stream bytes not sent yet
+  bool corked() const { return corked_; }
+
+  /* Round-trip time estimate (RFC 6298), kept whether or not the RTO adapts to it */
+  struct RTTEstimate
+  {
+    uint64_t srtt_us;   // smoothed round-trip time
+    uint64_t rttvar_us; // round-trip time variation
+    uint64_t rto_ms;    // current Retransmission Timeout, including any backoff
+    uint64_t samples;   // round-trip times measured so far
+  };
+  RTTEstimate rtt_estimate() const { return { srtt_us_, rttvar_us_, current_RTO_, rtt_samples_ }; }
   const Writer& writer() const { return input_.writer(); }
   const Reader& reader() const { return input_.reader(); }
   Writer& writer() { return input_.writer(); }
@@ -45,20 +112,132 @@ public:
 private:
   Reader& reader() { return input_.reader(); }
   void start_timer();
+  void duplicate_ack();
+  void enter_recovery( const CongestionControl::Event& event );
+  uint64_t update_scoreboard( const TCPReceiverMessage& msg );
+  void mark_losses();
+  bool retransmit_hole( const TransmitFunction& transmit, uint64_t cwnd, bool lost_only );
+  void forget_resends(); // a new recovery, or a timeout: no segment counts twice in pipe() any more
+  void forget_losses();  // a timeout: no segment is deemed lost or resent in recovery until SACKs say so again
+  void stamp( TCPSenderMessage& msg ) const; // sets the timestamp (in ms), if timestamps are in use
+  void update_rtt( uint64_t rtt_us );
+  bool rack_detect_losses(); // marks the segments RACK deems lost; returns whether it marked any
+  void arm_loss_probe();
+  bool hold_short_segment() const; // does Nagle or the cork hold back a segment short of the MSS?
+  CongestionControl::Event congestion_event( uint64_t newly_acked ) const;
+
+  // A segment awaiting acknowledgment, with what the sender knew when it went out. Its payload stays in
+  // the outbound stream until it is acknowledged, so a copy to (re)transmit is built from there.
+  struct Outstanding
+  {
+    uint64_t start;  // absolute sequence number of its first byte, or its SYN
+    uint64_t length; // sequence numbers it takes, SYN and FIN included
+    bool SYN;
+    bool FIN;
+    std::optional<uint32_t> timestamp; // the TSval of its last copy
+    uint64_t sent_us;      // when it was first sent
+    uint64_t last_sent_us; // when it was last sent, with timestamp
+    uint64_t delivered;    // delivered_ at that time
+    uint64_t delivered_us; // delivered_us_ at that time
+    bool retransmitted;
+    bool sacked;             // a SACK block covers it
+    bool lost;               // enough data above it has been SACKed to deem it lost (RFC 6675 IsLost)
+    bool resent_in_recovery; // resent in this recovery, so counted twice in pipe()
+
+    uint64_t end() const { return start + length; }
+    uint64_t payload_size() const { return length - SYN - FIN; }
+  };
+  // Take the next `payload_size` bytes of the stream (and SYN, FIN) as a new outstanding segment
+  Outstanding& track( uint64_t payload_size, bool SYN, bool FIN );
+  TCPSenderMessage segment( const Outstanding& seg ) const; // a copy of the segment, to transmit
+  // Scoreboard changes, which keep the counts pipe() is made of
+  void mark_sacked( Outstanding& seg );
+  void mark_lost( Outstanding& seg );
+  void resend_in_recovery( Outstanding& seg, const TransmitFunction& transmit );
+  void forget( const Outstanding& seg ); // acknowledged, and about to leave the queue
+  void send( Outstanding& seg, const TransmitFunction& transmit ); // stamp a copy and transmit it
+  // The first outstanding segment that starts at or after `seqno` (absolute)
+  std::deque<Outstanding>::iterator find_segment( uint64_t seqno );
+  void retransmit( Outstanding& seg, const TransmitFunction& transmit );
+  void rack_update( const Outstanding& seg, uint64_t end ); // seg, which ends at `end`, has been delivered
+  // RTT from a timestamp echo, given the newest segment the ACK covers
+  std::optional<uint64_t> timestamp_rtt( uint32_t echo, const std::optional<Outstanding>& newest_acked ) const;
 
   ByteStream input_;
   Wrap32 isn_;
-  Wrap32 next_seqno_;
-  Wrap32 last_ackno_;
+  uint64_t next_seqno_ { 0 }; // absolute: every ackno and SACK block is unwrapped against it
+  uint64_t last_ackno_ { 0 }; // absolute
   uint64_t initial_RTO_ms_;
   uint64_t current_RTO_;
+  // RTT estimation (RFC 6298)
+  std::optional<RTOBounds> adaptive_RTO_;
+  uint64_t srtt_us_ { 0 };
+  uint64_t rttvar_us_ { 0 };
+  uint64_t rtt_samples_ { 0 };
   bool sender_syn { false };
   bool fin_sent_ { false };
-  uint16_t window_size { 1 };
+  uint32_t window_size { 1 }; // the peer's window, scaled (RFC 7323)
+  uint64_t bytes_sent_ { 0 };  // stream bytes sent; those not yet popped from the stream are unacknowledged
   // Timer state
   bool timer_running_ { false };
-  uint64_t timer_elapsed_ { 0 };
-  // Retransmission tracking
+  uint64_t timer_elapsed_us_ { 0 };
+  // Retransmission tracking: the outstanding segments in sequence order, and their sequence numbers in total
   uint64_t consecutive_retrans_count_ { 0 };
-  std::deque<TCPSenderMessage> outstanding_segments_;
+  std::deque<Outstanding> outstanding_segments_;
+  uint64_t bytes_in_flight_ { 0 };
+  // Loss recovery: fast retransmit on the third duplicate ACK, then NewReno fast recovery (RFC 5681, RFC 6582)
+  uint64_t dup_acks_ { 0 };
+  bool fast_recovery_ { false };
+  uint64_t recover_ { 0 };        // highest sequence number sent when a loss was last detected (absolute)
+  bool retransmit_due_ { false }; // push() resends the first outstanding segment
+  // SACK scoreboard (RFC 6675): in use once the peer has sent a SACK block
+  bool sack_;
+  bool sack_seen_ { false };
+  uint64_t high_rxt_ { 0 };           // NextSeg starts here: below, each segment is SACKed or resent (absolute)
+  uint64_t highest_sacked_end_ { 0 }; // end of the highest segment SACKed (absolute)
+  uint64_t lost_below_ { 0 };         // every segment below this that is not SACKed is deemed lost (absolute)
+  std::map<uint64_t, uint64_t> sacked_ranges_ {}; // runs of SACKed segments, start to end (absolute)
+  // What pipe() subtracts from and adds to the sequence numbers in flight, kept as the scoreboard changes
+  uint64_t sacked_bytes_ { 0 };          // in SACKed segments
+  uint64_t lost_bytes_ { 0 };            // in segments deemed lost and not SACKed
+  uint64_t retransmitted_in_pipe_ { 0 }; // in segments resent in this recovery and not SACKed
+  // Window scaling (RFC 7323): the shift our SYN offers, and the one the peer's windows are scaled by
+  std::optional<uint8_t> window_scale_;
+  uint8_t window_shift_ { 0 };
+  // Maximum segment size: ours, which the SYN offers, and the one in use once the peer's is known
+  uint64_t local_mss_;
+  uint64_t mss_;
+  // Timestamps (RFC 7323): offered on the SYN, and in use after it unless the peer's SYN had none
+  bool timestamps_;
+  // RACK-TLP (RFC 8985): the most recently sent segment known to be delivered (its send time, end and RTT),
+  // the highest end delivered, whether segments were seen to arrive out of order, and the timers
+  bool rack_tlp_;
+  uint64_t min_rtt_us_ { UINT64_MAX };
+  uint64_t rack_xmit_us_ { 0 };
+  uint64_t rack_end_ { 0 };
+  uint64_t rack_rtt_us_ { 0 };
+  uint64_t rack_fack_ { 0 };
+  bool rack_reordering_ { false };
+  uint64_t rack_checked_ { 0 }; // every segment below this is SACKed or lost, so RACK need not look (absolute)
+  std::optional<uint64_t> rack_timer_us_ {}; // when a segment's reordering window runs out
+  std::optional<uint64_t> tlp_timer_us_ {};  // when to send a loss probe
+  std::optional<uint64_t> tlp_end_ {};       // end of the probe of the current episode (absolute)
+  uint64_t loss_probes_ { 0 };
+  // Congestion control: the window it allows, and the clock it sees (total time passed to tick)
+  std::unique_ptr<CongestionControl> congestion_;
+  uint64_t now_us_ { 0 };
+  uint64_t last_tick_us_ { 0 };
+  // Delivery rate: sequence numbers acknowledged so far, and when the count last grew
+  uint64_t delivered_ { 0 };
+  uint64_t delivered_us_ { 0 };
+  // Pacing: when the next segment is due to go out, and whether push() held one back for it
+  uint64_t next_send_us_ { 0 };
+  bool pacing_deferred_ { false };
+  // Nagle and cork: whether each is on, since when a short segment has been held, and whether the next
+  // push() sends it regardless
+  bool nagle_ { false };
+  bool corked_ { false };
+  uint64_t cork_timeout_us_ { 0 };
+  std::optional<uint64_t> held_since_us_ {};
+  bool push_held_ { false };
 };
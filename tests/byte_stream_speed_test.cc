@@ -7,6 +7,7 @@
 #include <iostream>
 #include <queue>
 #include <random>
+#include <utility>
 
 using namespace std;
 using namespace std::chrono;
@@ -16,7 +17,10 @@ double speed_test( fstream& debug_output,
                    const size_t capacity,    // NOLINT(bugprone-easily-swappable-parameters)
                    const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
                    const size_t write_size,  // NOLINT(bugprone-easily-swappable-parameters)
-                   const size_t read_size )  // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t read_size,   // NOLINT(bugprone-easily-swappable-parameters)
+                   const ByteStream::Storage storage,
+                   string_view storage_name,
+                   const bool gather ) // pop read_size bytes gathered from peek_all() rather than one peek()
 {
   // Generate the data to be written
   const string data = [&random_seed, &input_len] {
@@ -35,7 +39,7 @@ double speed_test( fstream& debug_output,
     split_data.emplace( data.substr( i, write_size ) );
   }
 
-  ByteStream bs { capacity };
+  ByteStream bs { capacity, storage };
   string output_data;
   output_data.reserve( data.size() );
 
@@ -52,7 +56,18 @@ double speed_test( fstream& debug_output,
       }
     }
 
-    if ( bs.reader().bytes_buffered() ) {
+    if ( gather ) {
+      size_t gathered = 0;
+      for ( auto view : bs.reader().peek_all( read_size ) ) {
+        view = view.substr( 0, read_size - gathered );
+        output_data += view;
+        gathered += view.size();
+        if ( gathered == read_size ) {
+          break;
+        }
+      }
+      bs.reader().pop( gathered );
+    } else if ( bs.reader().bytes_buffered() ) {
       auto peeked = bs.reader().peek().substr( 0, read_size );
       if ( peeked.empty() ) {
         throw runtime_error( "ByteStream::reader().peek() returned empty view" );
@@ -73,13 +88,15 @@ double speed_test( fstream& debug_output,
   auto bits_per_second = 8 * bytes_per_second;
   auto gigabits_per_second = bits_per_second / 1e9;
 
-  cout << "ByteStream with capacity=" << capacity << ", write_size=" << write_size << ", read_size=" << read_size
-       << " reached " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
+  const string_view peek_name = gather ? "peek_all" : "peek    ";
+  cout << storage_name << " ByteStream with capacity=" << capacity << ", write_size=" << write_size
+       << ", read_size=" << read_size << ", " << peek_name << " reached " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s.\n";
 
   auto read_s = to_string( read_size );
   const string fill( 5 - read_s.size(), ' ' );
-  debug_output << "        ByteStream throughput (pop length " << read_s << "):" << fill << fixed
-               << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+  debug_output << "        " << storage_name << " ByteStream throughput (" << peek_name << ", pop length " << read_s
+               << "):" << fill << fixed << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
 
   if ( gigabits_per_second < 0.1 ) {
     throw runtime_error( "ByteStream did not meet minimum speed of 0.1 Gbit/s" );
@@ -93,9 +110,17 @@ void program_body()
   fstream debug_output;
   debug_output.open( "/dev/tty" );
 
-  speed_test( debug_output, 1e7, 32768, 789, 1500, 4096 );
-  speed_test( debug_output, 1e7, 32768, 789, 1500, 128 );
-  speed_test( debug_output, 1e7, 32768, 789, 1500, 32 );
+  for ( const auto& [storage, name] : { pair { ByteStream::Storage::Chunked, "Chunked " },
+                                        pair { ByteStream::Storage::Ring, "Ring    " },
+                                        pair { ByteStream::Storage::Mirrored, "Mirrored" },
+                                        pair { ByteStream::Storage::Paged, "Paged   " },
+                                        pair { ByteStream::Storage::Spsc, "Spsc    " } } ) {
+    for ( const size_t read_size : { 16384, 4096, 128, 32 } ) {
+      for ( const bool gather : { false, true } ) {
+        speed_test( debug_output, 1e7, 32768, 789, 1500, read_size, storage, name, gather );
+      }
+    }
+  }
 }
 
 int main()
@@ -0,0 +1,211 @@
+#include "byte_stream.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+enum class Handoff : uint8_t
+{
+  SocketPair, // the bytes cross the kernel, as between TCPMinnowSocket and its application
+  SpscSpin,   // Spsc ByteStream shared by both threads, idle side spins (yielding its time slice)
+  SpscWakeup, // Spsc ByteStream shared by both threads, idle side sleeps on its event fd
+};
+
+string_view handoff_name( Handoff handoff )
+{
+  switch ( handoff ) {
+    case Handoff::SocketPair:
+      return "socketpair ";
+    case Handoff::SpscSpin:
+      return "Spsc (spin)";
+    case Handoff::SpscWakeup:
+      return "Spsc (wake)";
+  }
+  return "unknown";
+}
+
+// Block until `event` is signalled, then reset it
+void sleep_on( FileDescriptor& event )
+{
+  pollfd pfd { event.fd_num(), POLLIN, 0 };
+  CheckSystemCall( "poll", ::poll( &pfd, 1, -1 ) );
+  string counter;
+  event.read( counter );
+}
+
+// Idle side of a Spsc handoff: wait for the other thread to make progress
+void wait( auto& side, FileDescriptor& event, Handoff handoff )
+{
+  if ( handoff == Handoff::SpscSpin ) {
+    this_thread::yield();
+  } else if ( side.arm_wakeup() ) {
+    sleep_on( event );
+  }
+}
+
+// Writer thread: push `data` in pieces of `write_size`, then close
+void produce( ByteStream& stream, const string& data, size_t write_size, Handoff handoff )
+{
+  size_t sent = 0;
+  while ( sent < data.size() ) {
+    const auto region = stream.writer().writable_region();
+    if ( region.empty() ) {
+      wait( stream.writer(), stream.writable_event(), handoff );
+      continue;
+    }
+    const size_t len = min( { region.size(), write_size, data.size() - sent } );
+    copy_n( data.begin() + static_cast<ptrdiff_t>( sent ), len, region.begin() );
+    stream.writer().commit( len );
+    sent += len;
+  }
+  stream.writer().close();
+}
+
+// Reader thread: drain the stream into `out`
+void consume( ByteStream& stream, string& out, Handoff handoff )
+{
+  while ( not stream.reader().is_finished() ) {
+    uint64_t len = 0;
+    for ( const auto view : stream.reader().peek_all() ) {
+      out += view;
+      len += view.size();
+    }
+    if ( len == 0 ) {
+      wait( stream.reader(), stream.readable_event(), handoff );
+      continue;
+    }
+    stream.reader().pop( len );
+  }
+}
+
+void socketpair_handoff( const string& data, size_t write_size, size_t capacity, string& out )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_STREAM, 0, fds.data() ) );
+  FileDescriptor writer_end { fds[0] };
+  FileDescriptor reader_end { fds[1] };
+
+  // each side keeps its own ByteStream, as TCPMinnowSocket and its application do
+  thread writer_thread { [&] {
+    ByteStream outbound { capacity, ByteStream::Storage::Ring };
+    size_t sent = 0;
+    while ( sent < data.size() or outbound.reader().bytes_buffered() ) {
+      if ( sent < data.size() and outbound.writer().available_capacity() > 0 ) {
+        const uint64_t before = outbound.writer().bytes_pushed();
+        outbound.writer().push( data.substr( sent, write_size ) );
+        sent += outbound.writer().bytes_pushed() - before;
+      }
+      outbound.reader().write_to( writer_end );
+    }
+    writer_end.close();
+  } };
+
+  ByteStream inbound { capacity, ByteStream::Storage::Ring };
+  while ( not reader_end.eof() ) {
+    inbound.writer().read_from( reader_end );
+    for ( const auto view : inbound.reader().peek_all() ) {
+      out += view;
+    }
+    inbound.reader().pop( inbound.reader().bytes_buffered() );
+  }
+  writer_thread.join();
+}
+
+double speed_test( fstream& debug_output,
+                   const size_t input_len,   // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t capacity,    // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+                   const size_t write_size,  // NOLINT(bugprone-easily-swappable-parameters)
+                   const Handoff handoff )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  string output_data;
+  output_data.reserve( data.size() );
+
+  const auto start_time = steady_clock::now();
+  if ( handoff == Handoff::SocketPair ) {
+    socketpair_handoff( data, write_size, capacity, output_data );
+  } else {
+    ByteStream stream { capacity, ByteStream::Storage::Spsc };
+    stream.enable_wakeups();
+    thread writer_thread { [&] { produce( stream, data, write_size, handoff ); } };
+    consume( stream, output_data, handoff );
+    writer_thread.join();
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto bytes_per_second = static_cast<double>( input_len ) / test_duration.count();
+  auto bits_per_second = 8 * bytes_per_second;
+  auto gigabits_per_second = bits_per_second / 1e9;
+
+  cout << handoff_name( handoff ) << " two-thread handoff with capacity=" << capacity
+       << ", write_size=" << write_size << " reached " << fixed << setprecision( 2 ) << gigabits_per_second
+       << " Gbit/s.\n";
+
+  auto write_s = to_string( write_size );
+  const string fill( 5 - write_s.size(), ' ' );
+  debug_output << "        " << handoff_name( handoff ) << " handoff throughput (write length " << write_s
+               << "):" << fill << fixed << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "two-thread handoff did not meet minimum speed of 0.1 Gbit/s" );
+  }
+
+  return gigabits_per_second;
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  for ( const auto handoff : { Handoff::SocketPair, Handoff::SpscSpin, Handoff::SpscWakeup } ) {
+    for ( const size_t write_size : { 16384, 1500, 128 } ) {
+      speed_test( debug_output, 1e7, 65536, 789, write_size, handoff );
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,359 @@
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+int main()
+{
+  try {
+    for ( const auto storage : { ByteStream::Storage::Ring,
+                                 ByteStream::Storage::Chunked,
+                                 ByteStream::Storage::Mirrored,
+                                 ByteStream::Storage::Paged,
+                                 ByteStream::Storage::Spsc } ) {
+      {
+        ByteStreamTestHarness test { "wraparound (" + storage_name( storage ) + ")", 8, storage };
+        test.execute( Push { "abcdef" } );
+        test.execute( Pop { 5 } );
+        test.execute( Push { "ghijkl" } );
+        test.execute( BytesBuffered { 7 } );
+        test.execute( AvailableCapacity { 1 } );
+        test.execute( Peek { "fghijkl" } );
+        test.execute( Pop { 3 } );
+        test.execute( Push { "mnop" } );
+        test.execute( BytesPushed { 16 } );
+        test.execute( BytesPopped { 8 } );
+        test.execute( PeekRange { 2, 4, "klmn" } );
+        test.execute( PeekRange { 6, 4, "op" } );
+        test.execute( ReadAll { "ijklmnop" } );
+      }
+
+      {
+        ByteStreamTestHarness test { "truncating push (" + storage_name( storage ) + ")", 4, storage };
+        test.execute( Push { "abcdefg" } );
+        test.execute( BytesPushed { 4 } );
+        test.execute( AvailableCapacity { 0 } );
+        test.execute( Push { "h" } );
+        test.execute( BytesPushed { 4 } );
+        test.execute( Peek { "abcd" } );
+      }
+
+      {
+        ByteStreamTestHarness test { "pop spanning pushes (" + storage_name( storage ) + ")", 15, storage };
+        test.execute( Push { "ab" } );
+        test.execute( Push { "cd" } );
+        test.execute( Push { "ef" } );
+        test.execute( Pop { 3 } );
+        test.execute( BytesBuffered { 3 } );
+        test.execute( Peek { "def" } );
+        test.execute( Pop { 100 } );
+        test.execute( BufferEmpty { true } );
+        test.execute( BytesPopped { 6 } );
+        test.execute( Close {} );
+        test.execute( IsFinished { true } );
+      }
+
+      {
+        ByteStreamTestHarness test { "direct writes (" + storage_name( storage ) + ")", 15, storage };
+        test.execute( WriteDirect { "hello" } );
+        test.execute( BytesPushed { 5 } );
+        test.execute( AvailableCapacity { 10 } );
+        test.execute( Push { "world" } );
+        test.execute( WriteDirect { "0123456789abcdef" } );
+        test.execute( BytesPushed { 15 } );
+        test.execute( WritableRegionSize { 0 } );
+        test.execute( Peek { "helloworld01234" } );
+        test.execute( Close {} );
+        test.execute( WritableRegionSize { 0 } );
+      }
+
+      {
+        ByteStreamTestHarness test { "fd transfers (" + storage_name( storage ) + ")", 10, storage };
+        test.execute( Push { "abcdef" } );
+        test.execute( Pop { 4 } );
+        test.execute( ReadFromPipe { "ghijklmnop", 8 } );
+        test.execute( BytesPushed { 14 } );
+        test.execute( AvailableCapacity { 0 } );
+        test.execute( WriteToPipe { "efghijklmn" } );
+        test.execute( BytesPopped { 14 } );
+        test.execute( ReadFromPipe { "xyz", 3 } );
+        test.execute( WriteToPipe { "xyz" } );
+        test.execute( BufferEmpty { true } );
+        test.execute( Close {} );
+        test.execute( ReadFromPipe { "closed", 0 } );
+      }
+    }
+
+    for ( const auto storage :
+          { ByteStream::Storage::Ring, ByteStream::Storage::Chunked, ByteStream::Storage::Paged } ) {
+      // the buffered bytes survive a change of capacity, which never drops below them
+      ByteStreamTestHarness test { "set_capacity (" + storage_name( storage ) + ")", 8, storage };
+      test.execute( Push { "abcdef" } );
+      test.execute( Pop { 5 } );
+      test.execute( Push { "ghijk" } );
+      test.execute( SetCapacity { 12 } );
+      test.execute( AvailableCapacity { 6 } );
+      test.execute( Push { "lmnopqr" } );
+      test.execute( Peek { "fghijklmnopq" } );
+      test.execute( SetCapacity { 4 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Pop { 10 } );
+      test.execute( AvailableCapacity { 10 } );
+      test.execute( SetCapacity { 4 } );
+      test.execute( AvailableCapacity { 2 } );
+      test.execute( Push { "stuv" } );
+      test.execute( ReadAll { "pqst" } );
+      test.execute( BytesPushed { 19 } );
+    }
+
+    for ( const auto storage : { ByteStream::Storage::Mirrored, ByteStream::Storage::Spsc } ) {
+      // fixed storage takes a smaller capacity and back, but cannot grow past what it was made with
+      ByteStreamTestHarness test { "set_capacity (" + storage_name( storage ) + ")", 8, storage };
+      test.execute( Push { "abcdef" } );
+      test.execute( SetCapacity { 6 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Pop { 5 } );
+      test.execute( SetCapacity { 8 } );
+      test.execute( Push { "ghijklmn" } );
+      test.execute( ReadAll { "fghijklm" } );
+      ByteStream stream { 8, storage };
+      bool threw = false;
+      try {
+        stream.writer().set_capacity( 1 << 20 );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      if ( not threw or stream.writer().capacity() != 8 ) {
+        throw runtime_error( storage_name( storage ) + " ByteStream grew past its storage" );
+      }
+    }
+
+    {
+      ByteStreamTestHarness test { "peek returns whole front chunk", 15, ByteStream::Storage::Chunked };
+      test.execute( Push { "hello" } );
+      test.execute( Push { "world" } );
+      test.execute( PeekOnce { "hello" } );
+      test.execute( Pop { 2 } );
+      test.execute( PeekOnce { "llo" } );
+      test.execute( Pop { 3 } );
+      test.execute( PeekOnce { "world" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek_all returns every chunk", 15, ByteStream::Storage::Chunked };
+      test.execute( PeekAll { {} } );
+      test.execute( Push { "ab" } );
+      test.execute( Push { "cd" } );
+      test.execute( Push { "ef" } );
+      test.execute( Pop { 1 } );
+      test.execute( PeekAll { { "b", "cd", "ef" } } );
+      test.execute( PeekAll { { "b", "cd" }, 2 } );
+      test.execute( PeekAll { { "b", "cd" }, 3 } );
+      test.execute( ReadAll { "bcdef" } );
+      test.execute( PeekAll { {} } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek returns bytes up to wraparound", 8, ByteStream::Storage::Ring };
+      test.execute( Push { "abcdef" } );
+      test.execute( PeekOnce { "abcdef" } );
+      test.execute( Pop { 5 } );
+      test.execute( Push { "ghijk" } );
+      test.execute( PeekOnce { "fgh" } );
+      test.execute( Pop { 3 } );
+      test.execute( PeekOnce { "ijk" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek_all returns both sides of wraparound", 8, ByteStream::Storage::Ring };
+      test.execute( Push { "abcdef" } );
+      test.execute( Pop { 5 } );
+      test.execute( Push { "ghijk" } );
+      test.execute( PeekAll { { "fgh", "ijk" } } );
+      test.execute( PeekAll { { "fgh" }, 3 } );
+      test.execute( Pop { 4 } );
+      test.execute( PeekAll { { "jk" } } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek_range starts partway into the chunks", 15, ByteStream::Storage::Chunked };
+      test.execute( Push { "ab" } );
+      test.execute( Push { "cd" } );
+      test.execute( Push { "ef" } );
+      test.execute( Pop { 1 } );
+      test.execute( PeekRange { 2, 2, "de" } );
+      test.execute( PeekRange { 3, 1, "e" } );
+      test.execute( PeekRange { 5, 1, "" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek_all returns one region", 8, ByteStream::Storage::Mirrored };
+      test.execute( Push { "abcdef" } );
+      test.execute( Pop { 5 } );
+      test.execute( Push { "ghijk" } );
+      test.execute( PeekAll { { "fghijk" } } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek_all returns one region per page", 64000, ByteStream::Storage::Paged };
+      test.execute( Push { string( 5000, 'a' ) + string( 4000, 'b' ) } );
+      test.execute( Pop { 100 } );
+      test.execute(
+        PeekAll { { string( 3996, 'a' ), string( 904, 'a' ) + string( 3192, 'b' ), string( 808, 'b' ) } } );
+      test.execute( PeekAll { { string( 3996, 'a' ), string( 904, 'a' ) + string( 3192, 'b' ) }, 4000 } );
+      test.execute( PeekRange { 3990, 20, string( 20, 'a' ) } );
+      test.execute( PeekRange { 4890, 20, string( 10, 'a' ) + string( 10, 'b' ) } );
+      test.execute( PeekRange { 8890, 20, string( 10, 'b' ) } );
+      test.execute( ReadAll { string( 4900, 'a' ) + string( 4000, 'b' ) } );
+    }
+
+    {
+      const string first( 4000, 'x' );
+      const string second( 100, 'y' );
+      ByteStreamTestHarness test { "peek returns all buffered bytes", 4096, ByteStream::Storage::Mirrored };
+      test.execute( Push { first } );
+      test.execute( Pop { 3990 } );
+      test.execute( Push { second } );
+      test.execute( PeekOnce { string( 10, 'x' ) + second } );
+      test.execute( WritableRegionSize { 3986 } );
+      test.execute( WriteDirect { string( 3986, 'z' ) } );
+      test.execute( PeekOnce { string( 10, 'x' ) + second + string( 3986, 'z' ) } );
+      test.execute( Pop { 4096 } );
+      test.execute( BufferEmpty { true } );
+    }
+
+    {
+      ByteStreamTestHarness test { "writable region stops at wraparound", 8, ByteStream::Storage::Ring };
+      test.execute( Push { "abcdef" } );
+      test.execute( Pop { 4 } );
+      test.execute( WritableRegionSize { 2 } );
+      test.execute( WriteDirect { "gh" } );
+      test.execute( WritableRegionSize { 4 } );
+      test.execute( WriteDirect { "ijkl" } );
+      test.execute( Peek { "efghijkl" } );
+    }
+
+    {
+      ByteStreamTestHarness test {
+        "pages allocated on demand, released as drained", 64000, ByteStream::Storage::Paged };
+      test.execute( PagesInUse { 0 } );
+      test.execute( AvailableCapacity { 64000 } );
+      test.execute( Push { string( 5000, 'a' ) } );
+      test.execute( PagesInUse { 2 } );
+      test.execute( Pop { 4096 } );
+      test.execute( PagesInUse { 1 } );
+      test.execute( WriteDirect { string( 100, 'b' ) } );
+      test.execute( PagesInUse { 1 } );
+      test.execute( Pop { 1004 } );
+      test.execute( PagesInUse { 0 } );
+      test.execute( BytesPopped { 5100 } );
+      test.execute( WriteDirect { "" } ); // a page set aside for the region, then nothing written into it
+      test.execute( PagesInUse { 0 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "wakeups signal the sleeping side", 8, ByteStream::Storage::Spsc };
+      test.execute( EnableWakeups {} );
+      test.execute( ArmReaderWakeup { true } );
+      test.execute( EventSignalled { true, false } );
+      test.execute( Push { "abcdefgh" } );
+      test.execute( EventSignalled { true, true } );
+      test.execute( ArmReaderWakeup { false } );
+      test.execute( ArmWriterWakeup { true } );
+      test.execute( Push { "i" } );
+      test.execute( EventSignalled { false, false } );
+      test.execute( Pop { 3 } );
+      test.execute( EventSignalled { false, true } );
+      test.execute( Pop { 3 } );
+      test.execute( EventSignalled { false, false } );
+      test.execute( ArmWriterWakeup { false } );
+      test.execute( Pop { 2 } );
+      test.execute( ArmReaderWakeup { true } );
+      test.execute( Close {} );
+      test.execute( EventSignalled { true, true } );
+      test.execute( ArmReaderWakeup { false } );
+    }
+
+    {
+      // the writer and the reader on different threads
+      constexpr uint64_t total = 1 << 22;
+      ByteStream stream { 4096, ByteStream::Storage::Spsc };
+      thread writer_thread { [&] {
+        uint64_t sent = 0;
+        while ( sent < total ) {
+          const auto region = stream.writer().writable_region();
+          if ( region.empty() ) {
+            this_thread::yield();
+          }
+          const uint64_t len = min<uint64_t>( region.size(), total - sent );
+          for ( uint64_t i = 0; i < len; ++i ) {
+            region[i] = static_cast<char>( ( sent + i ) % 251 );
+          }
+          stream.writer().commit( len );
+          sent += len;
+        }
+        stream.writer().close();
+      } };
+      uint64_t received = 0;
+      bool intact = true;
+      while ( not stream.reader().is_finished() ) {
+        const uint64_t before = received;
+        for ( const auto view : stream.reader().peek_all() ) {
+          for ( const char c : view ) {
+            intact = intact and c == static_cast<char>( received++ % 251 );
+          }
+        }
+        if ( received == before ) {
+          this_thread::yield();
+        }
+        stream.reader().pop( received - before );
+      }
+      writer_thread.join();
+      if ( not intact or received != total ) {
+        throw runtime_error( "Spsc ByteStream corrupted bytes passed between threads" );
+      }
+    }
+
+    for ( const auto storage : { ByteStream::Storage::Ring, ByteStream::Storage::Paged } ) {
+      // however much capacity is free, read_from() reads (and takes pages for) at most a batch at once
+      ByteStream stream { 4 << 20, storage };
+      auto [read_end, write_end] = make_pipe();
+      if ( fcntl( write_end.fd_num(), F_SETPIPE_SZ, 1 << 20 ) < 0 ) {
+        throw runtime_error( "could not enlarge the pipe" );
+      }
+      write_end.write( string( 3 * Writer::READ_BATCH, 'r' ) );
+      const uint64_t pages_before = PagePool::global().pages_in_use();
+      const uint64_t len = stream.writer().read_from( read_end );
+      const uint64_t pages_taken = PagePool::global().pages_in_use() - pages_before;
+      if ( len != Writer::READ_BATCH or pages_taken > len / PagePool::kPageSize ) {
+        throw runtime_error( "read_from() on a " + storage_name( storage ) + " stream read " + to_string( len )
+                             + " bytes" );
+      }
+    }
+
+    {
+      PagePool::global().set_memory_limit( PagePool::global().bytes_reserved() );
+      const uint64_t pool_bytes = PagePool::global().pages_available() * PagePool::kPageSize;
+      ByteStreamTestHarness test {
+        "memory limit caps available capacity", pool_bytes * 2, ByteStream::Storage::Paged };
+      test.execute( AvailableCapacity { pool_bytes } );
+      test.execute( Push { string( pool_bytes + 1000, 'c' ) } );
+      test.execute( BytesPushed { pool_bytes } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Pop { PagePool::kPageSize + 1 } );
+      test.execute( AvailableCapacity { PagePool::kPageSize } );
+      PagePool::global().set_memory_limit( numeric_limits<uint64_t>::max() );
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
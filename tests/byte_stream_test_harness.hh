@@ -2,9 +2,14 @@
 
 #include "byte_stream.hh"
 #include "common.hh"
+#include "file_descriptor.hh"
 #include "helpers.hh"
 
+#include <algorithm>
+#include <array>
+#include <unistd.h>
 #include <utility>
+#include <vector>
 
 static_assert( sizeof( Reader ) == sizeof( ByteStream ),
                "Please add member variables to the ByteStream base, not the ByteStream Reader." );
@@ -12,6 +17,23 @@ static_assert( sizeof( Reader ) == sizeof( ByteStream ),
 static_assert( sizeof( Writer ) == sizeof( ByteStream ),
                "Please add member variables to the ByteStream base, not the ByteStream Writer." );
 
+inline std::string storage_name( ByteStream::Storage storage )
+{
+  switch ( storage ) {
+    case ByteStream::Storage::Ring:
+      return "Ring";
+    case ByteStream::Storage::Chunked:
+      return "Chunked";
+    case ByteStream::Storage::Mirrored:
+      return "Mirrored";
+    case ByteStream::Storage::Paged:
+      return "Paged";
+    case ByteStream::Storage::Spsc:
+      return "Spsc";
+  }
+  return "unknown";
+}
+
 class ByteStreamTestHarness : public TestHarness<ByteStream>
 {
 public:
@@ -19,9 +41,23 @@ public:
     : TestHarness( move( test_name ), "capacity=" + std::to_string( capacity ), ByteStream { capacity } )
   {}
 
+  ByteStreamTestHarness( std::string test_name, uint64_t capacity, ByteStream::Storage storage )
+    : TestHarness( move( test_name ),
+                   "capacity=" + std::to_string( capacity ) + ", storage=" + storage_name( storage ),
+                   ByteStream { capacity, storage } )
+  {}
+
   size_t peek_size() { return object().reader().peek().size(); }
 };
 
+// connected pipe: { read end, write end }
+inline std::pair<FileDescriptor, FileDescriptor> make_pipe()
+{
+  std::array<int, 2> fds {};
+  CheckSystemCall( "pipe", ::pipe( fds.data() ) );
+  return { FileDescriptor { fds[0] }, FileDescriptor { fds[1] } };
+}
+
 /* actions */
 
 struct Push : public Action<ByteStream>
@@ -34,6 +70,136 @@ struct Push : public Action<ByteStream>
   constexpr std::string obj() const override { return "Writer"; }
 };
 
+struct WriteDirect : public Action<ByteStream>
+{
+  std::string data_;
+
+  explicit WriteDirect( std::string data ) : data_( move( data ) ) {}
+  std::string description() const override
+  {
+    return "copy \"" + pretty_print( data_ ) + "\" into writable_region() and commit";
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    const auto region = bs.writer().writable_region();
+    const auto len = std::min( region.size(), data_.size() );
+    std::copy_n( data_.begin(), len, region.begin() );
+    bs.writer().commit( len );
+  }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct ReadFromPipe : public Action<ByteStream>
+{
+  std::string data_;
+  uint64_t expected_len_;
+
+  ReadFromPipe( std::string data, uint64_t expected_len ) : data_( move( data ) ), expected_len_( expected_len ) {}
+  std::string description() const override
+  {
+    return "read_from( pipe holding \"" + pretty_print( data_ ) + "\" ) returns " + std::to_string( expected_len_ );
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    auto [read_end, write_end] = make_pipe();
+    write_end.write( data_ );
+    const uint64_t len = bs.writer().read_from( read_end );
+    if ( len != expected_len_ ) {
+      throw ExpectationViolation { "read_from()", expected_len_, len };
+    }
+  }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct WriteToPipe : public Action<ByteStream>
+{
+  std::string output_;
+
+  explicit WriteToPipe( std::string output ) : output_( move( output ) ) {}
+  std::string description() const override
+  {
+    return "write_to( pipe ) and expect the pipe to hold \"" + pretty_print( output_ ) + "\"";
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    auto [read_end, write_end] = make_pipe();
+    bs.reader().write_to( write_end );
+    write_end.close();
+    std::string got;
+    std::string chunk;
+    while ( not read_end.eof() ) {
+      chunk.clear();
+      read_end.read( chunk );
+      got += chunk;
+    }
+    if ( got != output_ ) {
+      throw ExpectationViolation { "should have written \"" + pretty_print( output_ ) + "\", but found \""
+                                   + pretty_print( got ) + "\"" };
+    }
+  }
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
+struct EnableWakeups : public Action<ByteStream>
+{
+  std::string description() const override { return "enable_wakeups"; }
+  void execute( ByteStream& bs ) const override { bs.enable_wakeups(); }
+};
+
+struct ArmReaderWakeup : public Action<ByteStream>
+{
+  bool armed_;
+
+  explicit ArmReaderWakeup( bool armed ) : armed_( armed ) {}
+  std::string description() const override { return "arm_wakeup() returns " + to_string( armed_ ); }
+  void execute( ByteStream& bs ) const override
+  {
+    if ( bs.reader().arm_wakeup() != armed_ ) {
+      throw ExpectationViolation { "arm_wakeup()", armed_, not armed_ };
+    }
+  }
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
+struct ArmWriterWakeup : public Action<ByteStream>
+{
+  bool armed_;
+
+  explicit ArmWriterWakeup( bool armed ) : armed_( armed ) {}
+  std::string description() const override { return "arm_wakeup() returns " + to_string( armed_ ); }
+  void execute( ByteStream& bs ) const override
+  {
+    if ( bs.writer().arm_wakeup() != armed_ ) {
+      throw ExpectationViolation { "arm_wakeup()", armed_, not armed_ };
+    }
+  }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+// Reads (and so resets) the event fd
+struct EventSignalled : public Action<ByteStream>
+{
+  bool readable_event_;
+  bool signalled_;
+
+  EventSignalled( bool readable_event, bool signalled )
+    : readable_event_( readable_event ), signalled_( signalled )
+  {}
+  std::string description() const override
+  {
+    return std::string { readable_event_ ? "readable_event()" : "writable_event()" } + " signalled = "
+           + to_string( signalled_ );
+  }
+  void execute( ByteStream& bs ) const override
+  {
+    std::string counter;
+    ( readable_event_ ? bs.readable_event() : bs.writable_event() ).read( counter );
+    if ( counter.empty() == signalled_ ) {
+      throw ExpectationViolation { "event signalled", signalled_, not signalled_ };
+    }
+  }
+};
+
 struct Close : public Action<ByteStream>
 {
   std::string description() const override { return "close"; }
@@ -47,6 +213,16 @@ struct SetError : public Action<ByteStream>
   void execute( ByteStream& bs ) const override { bs.set_error(); }
 };
 
+struct SetCapacity : public Action<ByteStream>
+{
+  uint64_t capacity_;
+
+  explicit SetCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+  std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+  void execute( ByteStream& bs ) const override { bs.writer().set_capacity( capacity_ ); }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
 struct Pop : public Action<ByteStream>
 {
   size_t len_;
@@ -119,6 +295,95 @@ struct PeekOnce : public Peek
   }
 };
 
+struct PeekAll : public Expectation<ByteStream>
+{
+  std::vector<std::string> regions_;
+  uint64_t max_len_;
+
+  explicit PeekAll( std::vector<std::string> regions, uint64_t max_len = UINT64_MAX )
+    : regions_( move( regions ) ), max_len_( max_len )
+  {}
+
+  static std::string pretty( const auto& regions )
+  {
+    std::string ret = "{";
+    for ( const auto& region : regions ) {
+      ret += " \"" + pretty_print( std::string { region } ) + "\"";
+    }
+    return ret + " }";
+  }
+
+  std::string description() const override
+  {
+    const std::string arg = max_len_ == UINT64_MAX ? "" : " " + std::to_string( max_len_ ) + " ";
+    return "peek_all(" + arg + ") gives exactly " + pretty( regions_ );
+  }
+
+  void execute( const ByteStream& bs ) const override
+  {
+    const auto peeked = bs.reader().peek_all( max_len_ );
+    if ( not std::equal( peeked.begin(), peeked.end(), regions_.begin(), regions_.end() ) ) {
+      throw ExpectationViolation { "peek_all() should have returned " + pretty( regions_ )
+                                   + ", but instead returned " + pretty( peeked ) };
+    }
+  }
+
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
+struct PeekRange : public Expectation<ByteStream>
+{
+  uint64_t offset_;
+  uint64_t len_;
+  std::string output_;
+
+  PeekRange( uint64_t offset, uint64_t len, std::string output )
+    : offset_( offset ), len_( len ), output_( move( output ) )
+  {}
+
+  std::string description() const override
+  {
+    return "peek_range( " + std::to_string( offset_ ) + ", " + std::to_string( len_ ) + " ) gives \""
+           + pretty_print( output_ ) + "\"";
+  }
+
+  void execute( const ByteStream& bs ) const override
+  {
+    std::string got;
+    for ( const auto region : bs.reader().peek_range( offset_, len_ ) ) {
+      if ( region.empty() ) {
+        throw ExpectationViolation { "peek_range() returned an empty region" };
+      }
+      got += region;
+    }
+    if ( got != output_ ) {
+      throw ExpectationViolation { "peek_range() should have returned \"" + pretty_print( output_ )
+                                   + "\", but instead returned \"" + pretty_print( got ) + "\"" };
+    }
+  }
+
+  constexpr std::string obj() const override { return "Reader"; }
+};
+
+struct WritableRegionSize : public ExpectNumber<ByteStream, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "writable_region().size()"; }
+  size_t value( const ByteStream& bs ) const override
+  {
+    ByteStream local_copy = bs;
+    return local_copy.writer().writable_region().size();
+  }
+  constexpr std::string obj() const override { return "Writer"; }
+};
+
+struct PagesInUse : public ExpectNumber<ByteStream, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "PagePool::global().pages_in_use()"; }
+  uint64_t value( const ByteStream& /*unused*/ ) const override { return PagePool::global().pages_in_use(); }
+};
+
 struct IsClosed : public ExpectBool<ByteStream>
 {
   using ExpectBool::ExpectBool;
@@ -0,0 +1,200 @@
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t BULK_LENGTH = 1'000'000;
+constexpr uint64_t REQUESTS = 200;
+constexpr uint64_t MESSAGE_LENGTH = 100;
+constexpr uint64_t ONE_WAY_DELAY_MS = 10;
+
+enum class Workload : uint8_t
+{
+  Bulk,            // the client sends BULK_LENGTH bytes as fast as the window allows
+  RequestResponse, // the client sends REQUESTS requests, one at a time, each answered at once
+};
+
+string workload_name( Workload workload )
+{
+  switch ( workload ) {
+    case Workload::Bulk:
+      return "bulk";
+    case Workload::RequestResponse:
+      return "request_response";
+  }
+  throw runtime_error( "unknown workload" );
+}
+
+struct Result
+{
+  uint64_t server_segments; // everything the server sent
+  uint64_t pure_acks;       // of those, segments with nothing but an ACK
+  uint64_t completion_ms;   // until the client's last byte was read, or its last response
+};
+
+// A client and a server ONE_WAY_DELAY_MS apart; each segment goes through the TCP header on its way. The
+// server's application reads everything as soon as it arrives. Time advances in 1 ms ticks.
+Result run( Workload workload, uint64_t delayed_ack_ms )
+{
+  TCPConfig cfg;
+  cfg.delayed_ack_ms = delayed_ack_ms;
+  TCPPeer client { cfg };
+  TCPPeer server { cfg };
+
+  using Queue = deque<pair<uint64_t, TCPMessage>>;
+  Queue to_server;
+  Queue to_client;
+  uint64_t now = 0;
+  uint64_t server_segments = 0;
+  uint64_t pure_acks = 0;
+  const auto transmit = [&]( Queue& queue ) {
+    return [&]( const TCPMessage& message ) {
+      if ( &queue == &to_client ) {
+        ++server_segments;
+        pure_acks += message.sender->sequence_length() == 0;
+      }
+      TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+      segment.compute_checksum( 0 );
+      TCPSegment parsed;
+      if ( not parse( parsed, vector<string> { concat( serialize( segment ) ) }, 0 ) ) {
+        throw runtime_error( "segment did not parse" );
+      }
+      queue.emplace_back( now + ONE_WAY_DELAY_MS, move( parsed.message ) );
+    };
+  };
+  const auto deliver = [&]( Queue& queue, TCPPeer& peer, Queue& replies ) {
+    while ( not queue.empty() and queue.front().first <= now ) {
+      peer.receive( move( queue.front().second ), transmit( replies ) );
+      queue.pop_front();
+    }
+  };
+
+  client.push( transmit( to_server ) );
+  uint64_t written = 0;
+  uint64_t requests_answered = 0;
+  bool awaiting_response = false;
+  const auto done = [&] {
+    return workload == Workload::Bulk ? server.inbound_reader().bytes_popped() == BULK_LENGTH
+                                      : requests_answered == REQUESTS;
+  };
+  while ( not done() ) {
+    if ( now > 60'000 ) {
+      throw runtime_error( workload_name( workload ) + " did not finish in a minute" );
+    }
+    ++now;
+    client.tick( 1, transmit( to_server ) );
+    server.tick( 1, transmit( to_client ) );
+    deliver( to_server, server, to_client );
+    deliver( to_client, client, to_server );
+
+    if ( not client.has_ackno() ) {
+      continue;
+    }
+    Writer& writer = client.outbound_writer();
+    if ( workload == Workload::Bulk ) {
+      const uint64_t size = min( writer.available_capacity(), BULK_LENGTH - written );
+      writer.push( string( size, 'x' ) );
+      written += size;
+      client.push( transmit( to_server ) );
+      server.inbound_reader().pop( server.inbound_reader().bytes_buffered() );
+      continue;
+    }
+
+    // each full request read draws a response, which carries the ACK of the request
+    Reader& requests = server.inbound_reader();
+    while ( requests.bytes_buffered() >= MESSAGE_LENGTH ) {
+      requests.pop( MESSAGE_LENGTH );
+      server.outbound_writer().push( string( MESSAGE_LENGTH, 'r' ) );
+      server.push( transmit( to_client ) );
+    }
+    Reader& responses = client.inbound_reader();
+    if ( awaiting_response and responses.bytes_buffered() >= MESSAGE_LENGTH ) {
+      responses.pop( MESSAGE_LENGTH );
+      ++requests_answered;
+      awaiting_response = false;
+    }
+    if ( not awaiting_response and written < REQUESTS * MESSAGE_LENGTH ) {
+      writer.push( string( MESSAGE_LENGTH, 'q' ) );
+      written += MESSAGE_LENGTH;
+      awaiting_response = true;
+      client.push( transmit( to_server ) );
+    }
+  }
+
+  return { server_segments, pure_acks, now };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  // one JSON object per line on stdout; a table on the terminal
+  debug_output << "        " << BULK_LENGTH << " bytes in bulk, or " << REQUESTS << " requests of "
+               << MESSAGE_LENGTH << " bytes; " << 2 * ONE_WAY_DELAY_MS << " ms RTT\n";
+  debug_output << "                workload   delayed ACK ms   server segments   pure ACKs   completion ms\n";
+  vector<Result> results;
+  for ( const Workload workload : { Workload::Bulk, Workload::RequestResponse } ) {
+    for ( const uint64_t delayed_ack_ms : { 0, 40 } ) {
+      const Result r = run( workload, delayed_ack_ms );
+      results.push_back( r );
+
+      cout << R"({"workload":")" << workload_name( workload ) << R"(","delayed_ack_ms":)" << delayed_ack_ms
+           << R"(,"server_segments":)" << r.server_segments << R"(,"pure_acks":)" << r.pure_acks
+           << R"(,"completion_ms":)" << r.completion_ms << "}\n";
+
+      debug_output << "        " << setw( 16 ) << workload_name( workload ) << setw( 17 ) << delayed_ack_ms
+                   << setw( 18 ) << r.server_segments << setw( 12 ) << r.pure_acks << setw( 16 )
+                   << r.completion_ms << "\n";
+    }
+  }
+
+  // bulk data draws an ACK per two segments, without slowing the transfer much; a response carries the ACK
+  // of its request
+  const Result& bulk_each = results.at( 0 );
+  const Result& bulk_delayed = results.at( 1 );
+  const Result& rr_each = results.at( 2 );
+  const Result& rr_delayed = results.at( 3 );
+  if ( bulk_delayed.pure_acks * 10 > bulk_each.pure_acks * 6
+       or bulk_delayed.completion_ms * 10 > bulk_each.completion_ms * 11 ) {
+    throw runtime_error( "bulk transfer with delayed ACKs drew " + to_string( bulk_delayed.pure_acks )
+                         + " pure ACKs in " + to_string( bulk_delayed.completion_ms ) + " ms, against "
+                         + to_string( bulk_each.pure_acks ) + " in " + to_string( bulk_each.completion_ms )
+                         + " ms without" );
+  }
+  if ( rr_delayed.pure_acks * 10 > rr_each.pure_acks or rr_delayed.completion_ms > rr_each.completion_ms ) {
+    throw runtime_error( "requests with delayed ACKs drew " + to_string( rr_delayed.pure_acks )
+                         + " pure ACKs in " + to_string( rr_delayed.completion_ms ) + " ms, against "
+                         + to_string( rr_each.pure_acks ) + " in " + to_string( rr_each.completion_ms )
+                         + " ms without" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
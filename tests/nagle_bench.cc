@@ -0,0 +1,185 @@
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t STREAM_LENGTH = 20000;
+constexpr uint64_t WRITES_PER_MS = 10;
+constexpr uint64_t ONE_WAY_DELAY_MS = 10;
+
+enum class Mode : uint8_t
+{
+  NoDelay,
+  Nagle,
+  Cork,
+};
+
+string mode_name( Mode mode )
+{
+  switch ( mode ) {
+    case Mode::NoDelay:
+      return "nodelay";
+    case Mode::Nagle:
+      return "nagle";
+    case Mode::Cork:
+      return "cork";
+  }
+  throw runtime_error( "unknown mode" );
+}
+
+struct Result
+{
+  uint64_t segments;      // data segments the client sent
+  double segments_per_kb; // data segments per 1000 bytes of the stream
+  double header_share;    // TCP and IPv4 headers as a share of the bytes the client put on the wire
+  double mean_latency_ms; // from a byte's write to its arrival at the server's reader
+  uint64_t completion_ms; // until the server read the last byte
+};
+
+// The client writes the stream one byte at a time, WRITES_PER_MS bytes each ms, to a server ONE_WAY_DELAY_MS
+// away, pushing after each write. Time advances in 1 ms ticks.
+Result run( Mode mode )
+{
+  TCPConfig cfg;
+  cfg.nagle = mode == Mode::Nagle;
+  TCPPeer client { cfg };
+  TCPPeer server { cfg };
+  if ( mode == Mode::Cork ) {
+    client.cork();
+  }
+
+  using Queue = deque<pair<uint64_t, TCPMessage>>;
+  Queue to_server;
+  Queue to_client;
+  uint64_t now = 0;
+  uint64_t segments = 0;
+  uint64_t payload_bytes = 0;
+  uint64_t wire_bytes = 0;
+  const auto transmit = [&]( Queue& queue ) {
+    return [&]( const TCPMessage& message ) {
+      TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+      segment.compute_checksum( 0 );
+      const string wire = concat( serialize( segment ) );
+      if ( &queue == &to_server and not message.sender->payload.empty() ) {
+        ++segments;
+        payload_bytes += message.sender->payload.size();
+        wire_bytes += 20 + wire.size(); // with an IPv4 header
+      }
+      TCPSegment parsed;
+      if ( not parse( parsed, vector<string> { wire }, 0 ) ) {
+        throw runtime_error( "segment did not parse" );
+      }
+      queue.emplace_back( now + ONE_WAY_DELAY_MS, move( parsed.message ) );
+    };
+  };
+  const auto deliver = [&]( Queue& queue, TCPPeer& peer, Queue& replies ) {
+    while ( not queue.empty() and queue.front().first <= now ) {
+      peer.receive( move( queue.front().second ), transmit( replies ) );
+      queue.pop_front();
+    }
+  };
+
+  client.push( transmit( to_server ) );
+  uint64_t written = 0;
+  uint64_t write_start = 0;
+  uint64_t read = 0;
+  uint64_t total_latency_ms = 0;
+  while ( read < STREAM_LENGTH ) {
+    if ( now > 60'000 ) {
+      throw runtime_error( mode_name( mode ) + " transfer did not finish in a minute" );
+    }
+    ++now;
+    client.tick( 1, transmit( to_server ) );
+    server.tick( 1, transmit( to_client ) );
+    deliver( to_server, server, to_client );
+    deliver( to_client, client, to_server );
+
+    for ( uint64_t i = 0; i < WRITES_PER_MS and written < STREAM_LENGTH and client.has_ackno(); ++i ) {
+      write_start = written == 0 ? now : write_start;
+      client.outbound_writer().push( "x" );
+      if ( ++written == STREAM_LENGTH ) {
+        client.outbound_writer().close();
+      }
+      client.push( transmit( to_server ) );
+    }
+
+    // byte i was written i / WRITES_PER_MS ms after the first
+    Reader& reader = server.inbound_reader();
+    for ( ; read < reader.bytes_popped() + reader.bytes_buffered(); ++read ) {
+      total_latency_ms += now - ( write_start + read / WRITES_PER_MS );
+    }
+    reader.pop( reader.bytes_buffered() );
+  }
+
+  return { segments,
+           static_cast<double>( segments ) * 1000 / static_cast<double>( STREAM_LENGTH ),
+           1 - static_cast<double>( payload_bytes ) / static_cast<double>( wire_bytes ),
+           static_cast<double>( total_latency_ms ) / static_cast<double>( STREAM_LENGTH ),
+           now };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  // one JSON object per line on stdout; a table on the terminal
+  debug_output << "        " << STREAM_LENGTH << " one-byte writes, " << WRITES_PER_MS << " per ms, "
+               << 2 * ONE_WAY_DELAY_MS << " ms RTT\n";
+  debug_output << "           mode   segments   segments/KB   header share   mean latency ms   completion ms\n";
+  vector<Result> results;
+  for ( const Mode mode : { Mode::NoDelay, Mode::Nagle, Mode::Cork } ) {
+    const Result r = run( mode );
+    results.push_back( r );
+
+    cout << R"({"mode":")" << mode_name( mode ) << R"(","segments":)" << r.segments << R"(,"segments_per_kb":)"
+         << fixed << setprecision( 2 ) << r.segments_per_kb << R"(,"header_share":)" << setprecision( 4 )
+         << r.header_share << R"(,"mean_latency_ms":)" << setprecision( 1 ) << r.mean_latency_ms
+         << R"(,"completion_ms":)" << r.completion_ms << "}\n";
+
+    debug_output << "        " << setw( 7 ) << mode_name( mode ) << setw( 11 ) << r.segments << fixed
+                 << setprecision( 2 ) << setw( 14 ) << r.segments_per_kb << setprecision( 4 ) << setw( 15 )
+                 << r.header_share << setprecision( 1 ) << setw( 18 ) << r.mean_latency_ms << setw( 16 )
+                 << r.completion_ms << "\n";
+  }
+
+  // Nagle sends one segment per round trip's worth of writes; the cork, one per MSS of them
+  const Result& nodelay = results.at( 0 );
+  const Result& nagle = results.at( 1 );
+  const Result& cork = results.at( 2 );
+  if ( nagle.segments_per_kb * 10 > nodelay.segments_per_kb ) {
+    throw runtime_error( "with Nagle, " + to_string( nagle.segments_per_kb ) + " segments per KB, against "
+                         + to_string( nodelay.segments_per_kb ) + " without" );
+  }
+  if ( cork.segments > STREAM_LENGTH / TCPConfig::MAX_PAYLOAD_SIZE + 1 ) {
+    throw runtime_error( "corked, " + to_string( cork.segments ) + " segments" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,332 @@
+#include "reassembler.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Heap accounting for the whole process: every allocation goes through these replacements
+namespace {
+size_t heap_in_use = 0;
+size_t heap_peak = 0;
+
+void* counted_alloc( size_t size )
+{
+  void* ptr = malloc( size == 0 ? 1 : size ); // NOLINT(*-no-malloc, *-owning-memory)
+  if ( ptr == nullptr ) {
+    throw bad_alloc {};
+  }
+  heap_in_use += malloc_usable_size( ptr );
+  heap_peak = max( heap_peak, heap_in_use );
+  return ptr;
+}
+
+void counted_free( void* ptr ) noexcept
+{
+  if ( ptr != nullptr ) {
+    heap_in_use -= malloc_usable_size( ptr );
+    free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+  }
+}
+} // namespace
+
+void* operator new( size_t size )
+{
+  return counted_alloc( size );
+}
+void* operator new[]( size_t size )
+{
+  return counted_alloc( size );
+}
+void operator delete( void* ptr ) noexcept
+{
+  counted_free( ptr );
+}
+void operator delete[]( void* ptr ) noexcept
+{
+  counted_free( ptr );
+}
+void operator delete( void* ptr, size_t /*size*/ ) noexcept
+{
+  counted_free( ptr );
+}
+void operator delete[]( void* ptr, size_t /*size*/ ) noexcept
+{
+  counted_free( ptr );
+}
+
+namespace {
+
+// Each payload is cut from the stream just before it is inserted (outside the timed region), as a
+// freshly read segment would be, so the heap the Reassembler keeps by holding on to it is counted.
+struct Segment
+{
+  uint64_t first_index;
+  uint64_t len;
+  bool is_last;
+};
+
+// A workload turns the stream into the segments to insert, in arrival order. The stream is cut
+// into blocks of `capacity` bytes; since the reader drains after every insert, each block's
+// segments arrive while the window covers that block (plus whatever of the next one fits).
+using Workload = vector<Segment> ( * )( const string& data, uint64_t capacity, default_random_engine& rd );
+
+constexpr uint64_t kChunk = 1000; // typical segment payload
+
+void add( vector<Segment>& out, const string& data, uint64_t first_index, uint64_t len )
+{
+  if ( first_index < data.size() ) {
+    len = min( len, data.size() - first_index );
+    out.push_back( { first_index, len, first_index + len >= data.size() } );
+  }
+}
+
+// Segments of each block, arriving in a random order
+vector<Segment> random_reordering( const string& data, uint64_t capacity, default_random_engine& rd )
+{
+  vector<Segment> out;
+  for ( uint64_t block = 0; block < data.size(); block += capacity ) {
+    const size_t begin = out.size();
+    for ( uint64_t i = block; i < min<uint64_t>( block + capacity, data.size() ); i += kChunk ) {
+      add( out, data, i, min( kChunk, block + capacity - i ) );
+    }
+    shuffle( out.begin() + static_cast<ptrdiff_t>( begin ), out.end(), rd );
+  }
+  return out;
+}
+
+// Segments starting every kChunk/10 bytes, so each byte arrives ten times, in a random order
+vector<Segment> heavy_overlap( const string& data, uint64_t capacity, default_random_engine& rd )
+{
+  vector<Segment> out;
+  for ( uint64_t block = 0; block < data.size(); block += capacity ) {
+    const size_t begin = out.size();
+    for ( uint64_t i = block; i < min<uint64_t>( block + capacity, data.size() ); i += kChunk / 10 ) {
+      add( out, data, i, min( kChunk, block + capacity - i ) );
+    }
+    shuffle( out.begin() + static_cast<ptrdiff_t>( begin ), out.end(), rd );
+  }
+  return out;
+}
+
+// Every segment of each block arrives eight times, in a random order
+vector<Segment> duplicate_storm( const string& data, uint64_t capacity, default_random_engine& rd )
+{
+  vector<Segment> out;
+  for ( uint64_t block = 0; block < data.size(); block += capacity ) {
+    const size_t begin = out.size();
+    for ( int copy = 0; copy < 8; ++copy ) {
+      for ( uint64_t i = block; i < min<uint64_t>( block + capacity, data.size() ); i += kChunk ) {
+        add( out, data, i, min( kChunk, block + capacity - i ) );
+      }
+    }
+    shuffle( out.begin() + static_cast<ptrdiff_t>( begin ), out.end(), rd );
+  }
+  return out;
+}
+
+// 16-byte segments: every other one arrives first, leaving a 16-byte hole between each pair,
+// then the holes are filled from the back of the block
+vector<Segment> tiny_holes( const string& data, uint64_t capacity, default_random_engine& /*unused*/ )
+{
+  constexpr uint64_t tiny = 16;
+  vector<Segment> out;
+  for ( uint64_t block = 0; block < data.size(); block += capacity ) {
+    const uint64_t end = min<uint64_t>( block + capacity, data.size() );
+    for ( uint64_t i = block + tiny; i < end; i += 2 * tiny ) {
+      add( out, data, i, min( tiny, end - i ) );
+    }
+    for ( uint64_t i = block + ( ( end - block - 1 ) / ( 2 * tiny ) ) * 2 * tiny;; i -= 2 * tiny ) {
+      add( out, data, i, min( tiny, end - i ) );
+      if ( i == block ) {
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+// The last byte of the stream arrives first, then each block arrives back to front
+vector<Segment> last_byte_first( const string& data, uint64_t capacity, default_random_engine& /*unused*/ )
+{
+  vector<Segment> out;
+  add( out, data, data.size() - 1, 1 );
+  for ( uint64_t block = 0; block < data.size(); block += capacity ) {
+    const uint64_t end = min<uint64_t>( block + capacity, data.size() );
+    for ( uint64_t i = block + ( ( end - block - 1 ) / kChunk ) * kChunk;; i -= kChunk ) {
+      add( out, data, i, min( kChunk, end - i ) );
+      if ( i == block ) {
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+// Before each block arrives in order, segments straddling the end of the window arrive and
+// have to be trimmed (their bytes beyond the window are dropped and sent again later)
+vector<Segment> window_edge_trimming( const string& data, uint64_t capacity, default_random_engine& rd )
+{
+  vector<Segment> out;
+  uniform_int_distribution<uint64_t> straddle { 1, kChunk - 1 };
+  for ( uint64_t block = 0; block < data.size(); block += capacity ) {
+    for ( int i = 0; i < 8; ++i ) {
+      const uint64_t inside = min( straddle( rd ), capacity - 1 );
+      add( out, data, block + capacity - inside, kChunk );
+    }
+    for ( uint64_t i = block; i < min<uint64_t>( block + capacity, data.size() ); i += kChunk ) {
+      add( out, data, i, min( kChunk, block + capacity - i ) );
+    }
+  }
+  return out;
+}
+
+struct Result
+{
+  uint64_t bytes_inserted {};
+  uint64_t inserts {};
+  double gigabits_per_second {};
+  uint64_t peak_pending {};
+  uint64_t peak_heap {};
+  uint64_t p50_ns {};
+  uint64_t p99_ns {};
+  uint64_t p999_ns {};
+  uint64_t max_ns {};
+};
+
+Result run( const string& data, const vector<Segment>& segments, uint64_t capacity, Reassembler::Mode mode )
+{
+  Result result;
+  result.inserts = segments.size();
+  for ( const auto& segment : segments ) {
+    result.bytes_inserted += segment.len;
+  }
+
+  vector<uint64_t> latencies;
+  latencies.reserve( segments.size() );
+  string output;
+  output.reserve( data.size() );
+
+  const size_t heap_baseline = heap_in_use;
+  heap_peak = heap_in_use;
+
+  {
+    Reassembler reassembler { ByteStream { capacity, ByteStream::Storage::Ring }, mode };
+    nanoseconds total {};
+    for ( const auto& [first_index, len, is_last] : segments ) {
+      string payload = data.substr( first_index, len );
+      const auto start = steady_clock::now();
+      reassembler.insert( first_index, move( payload ), is_last );
+      const auto elapsed = steady_clock::now() - start;
+
+      total += elapsed;
+      latencies.push_back( duration_cast<nanoseconds>( elapsed ).count() );
+      result.peak_pending = max( result.peak_pending, reassembler.count_bytes_pending() );
+
+      for ( const auto view : reassembler.reader().peek_all() ) {
+        output += view;
+      }
+      reassembler.reader().pop( reassembler.reader().bytes_buffered() );
+    }
+
+    if ( not reassembler.reader().is_finished() or output != data ) {
+      throw runtime_error( "Reassembler did not reassemble the stream" );
+    }
+    result.gigabits_per_second
+      = 8 * static_cast<double>( data.size() ) / static_cast<double>( duration_cast<nanoseconds>( total ).count() );
+  }
+  result.peak_heap = heap_peak - heap_baseline;
+
+  sort( latencies.begin(), latencies.end() );
+  const auto percentile = [&]( double p ) {
+    const auto rank = static_cast<size_t>( p * static_cast<double>( latencies.size() ) );
+    return latencies[min( latencies.size() - 1, rank )];
+  };
+  result.p50_ns = percentile( 0.5 );
+  result.p99_ns = percentile( 0.99 );
+  result.p999_ns = percentile( 0.999 );
+  result.max_ns = latencies.back();
+  return result;
+}
+
+string_view mode_name( Reassembler::Mode mode )
+{
+  return mode == Reassembler::Mode::Bitmap ? "Bitmap" : "Intervals";
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  constexpr uint64_t stream_len = 1 << 22;
+  const string data = [] {
+    default_random_engine rd { 5150 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( uint64_t i = 0; i < stream_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  const vector<pair<string_view, Workload>> workloads { { "random_reordering", random_reordering },
+                                                        { "heavy_overlap", heavy_overlap },
+                                                        { "duplicate_storm", duplicate_storm },
+                                                        { "tiny_holes", tiny_holes },
+                                                        { "last_byte_first", last_byte_first },
+                                                        { "window_edge_trimming", window_edge_trimming } };
+
+  // one JSON object per line on stdout; a table on the terminal
+  debug_output << "        workload              mode       capacity   Gbit/s  peak pending  peak heap"
+                  "   p50 ns   p99 ns  p99.9 ns    max ns\n";
+  for ( const auto& [name, workload] : workloads ) {
+    for ( const uint64_t capacity : { 4096, 65536, 1048576 } ) {
+      for ( const auto mode : { Reassembler::Mode::Intervals, Reassembler::Mode::Bitmap } ) {
+        default_random_engine rd { 8675309 };
+        const Result r = run( data, workload( data, capacity, rd ), capacity, mode );
+
+        cout << R"({"workload":")" << name << R"(","mode":")" << mode_name( mode ) << R"(","capacity":)"
+             << capacity << R"(,"bytes_inserted":)" << r.bytes_inserted << R"(,"inserts":)" << r.inserts
+             << R"(,"gbit_per_s":)" << fixed << setprecision( 3 ) << r.gigabits_per_second
+             << R"(,"peak_pending":)" << r.peak_pending << R"(,"peak_heap":)" << r.peak_heap << R"(,"p50_ns":)"
+             << r.p50_ns << R"(,"p99_ns":)" << r.p99_ns << R"(,"p999_ns":)" << r.p999_ns << R"(,"max_ns":)"
+             << r.max_ns << "}\n";
+
+        debug_output << "        " << left << setw( 22 ) << name << setw( 10 ) << mode_name( mode ) << right
+                     << setw( 9 ) << capacity << fixed << setprecision( 2 ) << setw( 9 ) << r.gigabits_per_second
+                     << setw( 14 ) << r.peak_pending << setw( 11 ) << r.peak_heap << setw( 9 ) << r.p50_ns
+                     << setw( 9 ) << r.p99_ns << setw( 10 ) << r.p999_ns << setw( 10 ) << r.max_ns << "\n";
+
+        if ( r.gigabits_per_second < 0.1 ) {
+          throw runtime_error( "Reassembler did not meet minimum speed of 0.1 Gbit/s on " + string( name ) );
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
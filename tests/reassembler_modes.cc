@@ -0,0 +1,154 @@
+#include "byte_stream_test_harness.hh"
+#include "reassembler_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+int main()
+{
+  try {
+    for ( const auto mode : { Reassembler::Mode::Intervals, Reassembler::Mode::Bitmap } ) {
+      {
+        ReassemblerTestHarness test { "overlapping stored substrings (" + mode_name( mode ) + ")", 16, mode };
+        test.execute( Insert { "def", 3 } );
+        test.execute( Insert { "ghij", 6 } );
+        test.execute( Insert { "efgh", 4 } );
+        test.execute( BytesPending { 7 } );
+        test.execute( Insert { "ab", 0 } );
+        test.execute( BytesPushed { 2 } );
+        test.execute( BytesPending { 7 } );
+        test.execute( Insert { "abcd", 0 } );
+        test.execute( BytesPushed { 10 } );
+        test.execute( BytesPending { 0 } );
+        test.execute( ReadAll { "abcdefghij" } );
+      }
+
+      {
+        ReassemblerTestHarness test { "in-order push covers stored bytes (" + mode_name( mode ) + ")", 16, mode };
+        test.execute( Insert { "cd", 2 } );
+        test.execute( Insert { "gh", 6 } );
+        test.execute( BytesPending { 4 } );
+        test.execute( HeldRanges { { { 2, 4 }, { 6, 8 } } } );
+        test.execute( Insert { "abcde", 0 } );
+        test.execute( BytesPushed { 5 } );
+        test.execute( BytesPending { 2 } );
+        test.execute( HeldRanges { { { 6, 8 } } } );
+        test.execute( Insert { "f", 5 } );
+        test.execute( BytesPushed { 8 } );
+        test.execute( BytesPending { 0 } );
+        test.execute( ReadAll { "abcdefgh" } );
+      }
+
+      {
+        // capacity 100 is not a whole number of bitmap words, and the window wraps around the ring
+        ReassemblerTestHarness test { "window wraps around (" + mode_name( mode ) + ")", 100, mode };
+        test.execute( Insert { string( 90, 'a' ), 0 } );
+        test.execute( ReadAll { string( 90, 'a' ) } );
+        test.execute( Insert { string( 80, 'c' ), 111 } );
+        test.execute( Insert { string( 80, 'c' ), 150 } );
+        test.execute( BytesPending { 79 } );
+        test.execute( HeldRanges { { { 111, 190 } } } );
+        test.execute( Insert { string( 20, 'b' ), 90 } );
+        test.execute( BytesPushed { 110 } );
+        test.execute( BytesPending { 79 } );
+        test.execute( ReadAll { string( 20, 'b' ) } );
+        test.execute( Insert { string( 120, 'c' ), 110 } );
+        test.execute( BytesPushed { 210 } );
+        test.execute( BytesPending { 0 } );
+        test.execute( ReadAll { string( 100, 'c' ) } );
+      }
+
+      {
+        // held bytes survive a change of capacity, which never drops below the last of them
+        ReassemblerTestHarness test { "set_capacity keeps held bytes (" + mode_name( mode ) + ")", 8, mode };
+        test.execute( Insert { "cd", 2 } );
+        test.execute( Insert { "gh", 6 } );
+        test.execute( SetReassemblerCapacity { 16 } );
+        test.execute( Insert { "ijkl", 8 } );
+        test.execute( HeldRanges { { { 2, 4 }, { 6, 12 } } } );
+        test.execute( Insert { "ab", 0 } );
+        test.execute( Insert { "ef", 4 } );
+        test.execute( BytesPushed { 12 } );
+        test.execute( ReadAll { "abcdefghijkl" } );
+        test.execute( Insert { "opq", 14 } );
+        test.execute( SetReassemblerCapacity { 2 } );
+        test.execute( Insert { "mnopqrst", 12 } );
+        test.execute( BytesPushed { 17 } );
+        test.execute( ReadAll { "mnopq" } );
+        test.execute( SetReassemblerCapacity { 2 } );
+        test.execute( Insert { "rstu", 17 } );
+        test.execute( ReadAll { "rs" } );
+      }
+
+      {
+        ReassemblerTestHarness test { "long run across many words (" + mode_name( mode ) + ")", 4096, mode };
+        test.execute( Insert { string( 4000, 'y' ), 1 } );
+        test.execute( Insert { string( 4, 'z' ), 4092 } );
+        test.execute( BytesPending { 4004 } );
+        test.execute( HeldRanges { { { 1, 4001 }, { 4092, 4096 } } } );
+        test.execute( Insert { "x", 0 } );
+        test.execute( BytesPushed { 4001 } );
+        test.execute( BytesPending { 4 } );
+        test.execute( Insert { string( 91, 'y' ), 4001 } );
+        test.execute( BytesPushed { 4096 } );
+        test.execute( BytesPending { 0 } );
+        test.execute( ReadAll { "x" + string( 4091, 'y' ) + string( 4, 'z' ) } );
+        test.execute( Insert { "w", 4096 }.is_last() );
+        test.execute( ReadAll { "w" } );
+        test.execute( IsFinished { true } );
+      }
+    }
+
+    {
+      // random overlapping substrings: the bitmap, with either scan, must match the interval map
+      constexpr uint64_t capacity = 1000;
+      constexpr uint64_t total = 100000;
+      default_random_engine rd { 2718 };
+      string data;
+      for ( uint64_t i = 0; i < total; ++i ) {
+        data += static_cast<char>( rd() );
+      }
+
+      for ( const bool vector_scan : { true, false } ) {
+        BitmapStore::use_vector_scan( vector_scan );
+        Reassembler intervals { ByteStream { capacity }, Reassembler::Mode::Intervals };
+        Reassembler bitmap { ByteStream { capacity }, Reassembler::Mode::Bitmap };
+        string intervals_out;
+        string bitmap_out;
+        while ( intervals_out.size() < total ) {
+          const uint64_t next = intervals.writer().bytes_pushed();
+          const uint64_t first = min( total - 1, next + uniform_int_distribution<uint64_t> { 0, capacity }( rd ) );
+          const string substring = data.substr( first, uniform_int_distribution<uint64_t> { 1, 300 }( rd ) );
+          const bool last = first + substring.size() == total;
+          intervals.insert( first, substring, last );
+          bitmap.insert( first, substring, last );
+          if ( intervals.count_bytes_pending() != bitmap.count_bytes_pending()
+               or intervals.writer().bytes_pushed() != bitmap.writer().bytes_pushed()
+               or intervals.held_ranges() != bitmap.held_ranges() ) {
+            throw runtime_error( "Bitmap Reassembler diverged from Intervals" );
+          }
+          if ( rd() % 4 == 0 ) {
+            string chunk;
+            read( intervals.reader(), intervals.reader().bytes_buffered(), chunk );
+            intervals_out += chunk;
+            read( bitmap.reader(), bitmap.reader().bytes_buffered(), chunk );
+            bitmap_out += chunk;
+          }
+        }
+        if ( intervals_out != data or bitmap_out != data or not bitmap.reader().is_finished() ) {
+          throw runtime_error( "Bitmap Reassembler did not reassemble random substrings" );
+        }
+      }
+      BitmapStore::use_vector_scan( true );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
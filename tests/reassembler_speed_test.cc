@@ -8,16 +8,25 @@
 #include <queue>
 #include <random>
 #include <tuple>
+#include <vector>
 
 using namespace std;
 using namespace std::chrono;
 
+namespace {
+string mode_name( Reassembler::Mode mode )
+{
+  return mode == Reassembler::Mode::Bitmap ? "Bitmap   " : "Intervals";
+}
+} // namespace
+
 void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t chunk_size,  // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t overlap,     // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t capacity,    // NOLINT(bugprone-easily-swappable-parameters)
                  const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
-                 string_view scenario )
+                 string_view scenario,
+                 const Reassembler::Mode mode )
 {
   // Generate the data to be written
   const string data = [&] {
@@ -46,7 +55,7 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
     }
   }
 
-  Reassembler reassembler { ByteStream { capacity } };
+  Reassembler reassembler { ByteStream { capacity, ByteStream::Storage::Ring }, mode };
 
   string output_data;
   output_data.reserve( data.size() );
@@ -81,21 +90,82 @@ void speed_test( const size_t num_chunks,  // NOLINT(bugprone-easily-swappable-p
   fstream debug_output;
   debug_output.open( "/dev/tty" );
 
-  cout << "Reassembler to ByteStream with capacity=" << capacity << " reached " << fixed << setprecision( 2 )
-       << gigabits_per_second << " Gbit/s.\n";
+  cout << mode_name( mode ) << " Reassembler to ByteStream with capacity=" << capacity << " reached " << fixed
+       << setprecision( 2 ) << gigabits_per_second << " Gbit/s.\n";
 
-  debug_output << "        Reassembler throughput " << scenario << fixed << setprecision( 2 ) << setw( 5 )
-               << gigabits_per_second << " Gbit/s\n";
+  debug_output << "        " << mode_name( mode ) << " Reassembler throughput " << scenario << fixed
+               << setprecision( 2 ) << setw( 5 ) << gigabits_per_second << " Gbit/s\n";
 
   if ( gigabits_per_second < 0.1 ) {
     throw runtime_error( "Reassembler did not meet minimum speed of 0.1 Gbit/s." );
   }
 }
 
+// Per-segment cost with `num_holes` gaps outstanding: every other chunk arrives first, then
+// the gaps are filled from the back, so each fill lands among num_holes stored substrings.
+void holes_test( const size_t num_holes,  // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t chunk_size, // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t random_seed,
+                 const Reassembler::Mode mode )
+{
+  const size_t num_chunks = 2 * num_holes;
+  const string data = [&] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < num_chunks * chunk_size; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  vector<tuple<uint64_t, string, bool>> segments;
+  for ( size_t i = 1; i < num_chunks; i += 2 ) {
+    segments.emplace_back( i * chunk_size, data.substr( i * chunk_size, chunk_size ), i == num_chunks - 1 );
+  }
+  for ( size_t i = num_chunks; i >= 2; i -= 2 ) {
+    segments.emplace_back( ( i - 2 ) * chunk_size, data.substr( ( i - 2 ) * chunk_size, chunk_size ), false );
+  }
+
+  Reassembler reassembler { ByteStream { data.size(), ByteStream::Storage::Ring }, mode };
+
+  const auto start_time = steady_clock::now();
+  for ( auto& [first_index, segment, is_last] : segments ) {
+    reassembler.insert( first_index, move( segment ), is_last );
+  }
+  const auto stop_time = steady_clock::now();
+
+  string output_data;
+  read( reassembler.reader(), data.size(), output_data );
+  if ( not reassembler.reader().is_finished() or data != output_data ) {
+    throw runtime_error( "Mismatch between data written and read" );
+  }
+
+  const auto ns_per_segment
+    = duration_cast<duration<double, nano>>( stop_time - start_time ).count() / static_cast<double>( num_chunks );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << mode_name( mode ) << " Reassembler with " << num_holes << " holes outstanding took " << fixed
+       << setprecision( 0 ) << ns_per_segment << " ns per segment.\n";
+
+  auto holes_s = to_string( num_holes );
+  const string fill( 5 - holes_s.size(), ' ' );
+  debug_output << "        " << mode_name( mode ) << " Reassembler per-segment cost (" << holes_s
+               << " holes):" << fill << fixed << setprecision( 0 ) << setw( 6 ) << ns_per_segment << " ns\n";
+}
+
 void program_body()
 {
-  speed_test( 1000, 1500, 1500, 32768, 1370, "(no overlap):  " );
-  speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap): " );
+  for ( const auto mode : { Reassembler::Mode::Intervals, Reassembler::Mode::Bitmap } ) {
+    speed_test( 1000, 1500, 1500, 32768, 1370, "(no overlap):  ", mode );
+    speed_test( 1000, 1500, 150, 32768, 6163, "(10x overlap): ", mode );
+
+    for ( const size_t num_holes : { 10, 100, 1000, 10000 } ) {
+      holes_test( num_holes, 100, 4217, mode );
+    }
+  }
 }
 
 int main()
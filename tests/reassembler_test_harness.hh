@@ -6,6 +6,18 @@
 
 #include <sstream>
 #include <utility>
+#include <vector>
+
+inline std::string mode_name( Reassembler::Mode mode )
+{
+  switch ( mode ) {
+    case Reassembler::Mode::Intervals:
+      return "Intervals";
+    case Reassembler::Mode::Bitmap:
+      return "Bitmap";
+  }
+  return "unknown";
+}
 
 template<std::derived_from<TestStep<ByteStream>> T>
 struct ReassemblerTestStep : public TestStep<Reassembler>
@@ -31,6 +43,12 @@ public:
                    { Reassembler { ByteStream { capacity } } } )
   {}
 
+  ReassemblerTestHarness( std::string test_name, uint64_t capacity, Reassembler::Mode mode )
+    : TestHarness( move( test_name ),
+                   "capacity=" + std::to_string( capacity ) + ", mode=" + mode_name( mode ),
+                   { Reassembler { ByteStream { capacity }, mode } } )
+  {}
+
   template<std::derived_from<TestStep<ByteStream>> T>
   void execute( const T& test )
   {
@@ -47,6 +65,44 @@ struct BytesPending : public ExpectNumber<Reassembler, uint64_t>
   uint64_t value( const Reassembler& r ) const override { return r.count_bytes_pending(); }
 };
 
+struct HeldRanges : public Expectation<Reassembler>
+{
+  std::vector<std::pair<uint64_t, uint64_t>> ranges_;
+
+  explicit HeldRanges( std::vector<std::pair<uint64_t, uint64_t>> ranges ) : ranges_( std::move( ranges ) ) {}
+
+  static std::string format( const std::vector<std::pair<uint64_t, uint64_t>>& ranges )
+  {
+    std::ostringstream ss;
+    ss << "{";
+    for ( const auto& [first, end] : ranges ) {
+      ss << " [" << first << ", " << end << ")";
+    }
+    ss << " }";
+    return ss.str();
+  }
+
+  std::string description() const override { return "held_ranges = " + format( ranges_ ); }
+
+  void execute( const Reassembler& r ) const override
+  {
+    const auto actual = r.held_ranges();
+    if ( actual != ranges_ ) {
+      throw ExpectationViolation( "should have had held_ranges = " + format( ranges_ ) + ", but instead it was "
+                                  + format( actual ) );
+    }
+  }
+};
+
+struct SetReassemblerCapacity : public Action<Reassembler>
+{
+  uint64_t capacity_;
+
+  explicit SetReassemblerCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+  std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+  void execute( Reassembler& r ) const override { r.set_capacity( capacity_ ); }
+};
+
 struct Insert : public Action<Reassembler>
 {
   std::string data_;
@@ -7,6 +7,7 @@
 #include <optional>
 #include <sstream>
 #include <utility>
+#include <vector>
 
 template<std::derived_from<TestStep<Reassembler>> T>
 struct DirectReassemblerTest : public TestStep<TCPReceiver>
@@ -37,10 +38,16 @@ struct DirectByteStreamTest : public TestStep<TCPReceiver>
 class TCPReceiverTestHarness : public TestHarness<TCPReceiver>
 {
 public:
-  TCPReceiverTestHarness( std::string test_name, uint64_t capacity )
+  TCPReceiverTestHarness( std::string test_name,
+                          uint64_t capacity,
+                          std::optional<uint64_t> sws_mss = std::nullopt,
+                          uint64_t max_capacity = 0 )
     : TestHarness( move( test_name ),
-                   "capacity=" + std::to_string( capacity ),
-                   { TCPReceiver { Reassembler { ByteStream { capacity } } } } )
+                   "capacity=" + std::to_string( capacity )
+                     + ( sws_mss ? ", sws_mss=" + std::to_string( *sws_mss ) : "" )
+                     + ( max_capacity ? ", max_capacity=" + std::to_string( max_capacity ) : "" ),
+                   { TCPReceiver {
+                     Reassembler { ByteStream { capacity } }, false, false, sws_mss, max_capacity } } )
   {}
 
   template<std::derived_from<TestStep<Reassembler>> T>
@@ -62,14 +69,14 @@ struct ExpectWindow : public ExpectNumber<TCPReceiver, uint16_t>
 {
   using ExpectNumber::ExpectNumber;
   std::string name() const override { return "window_size"; }
-  uint16_t value( const TCPReceiver& rs ) const override { return rs.send().window_size; }
+  uint16_t value( const TCPReceiver& rs ) const override { return rs.message().window_size; }
 };
 
 struct ExpectAckno : public ExpectNumber<TCPReceiver, std::optional<Wrap32>>
 {
   using ExpectNumber::ExpectNumber;
   std::string name() const override { return "ackno"; }
-  std::optional<Wrap32> value( const TCPReceiver& rs ) const override { return rs.send().ackno; }
+  std::optional<Wrap32> value( const TCPReceiver& rs ) const override { return rs.message().ackno; }
 };
 
 struct ExpectReset : public ExpectBool<TCPReceiver>
@@ -77,7 +84,7 @@ struct ExpectReset : public ExpectBool<TCPReceiver>
   using ExpectBool::ExpectBool;
   std::string name() const override { return "RST"; }
 
-  bool value( const TCPReceiver& rs ) const override { return rs.send().RST; }
+  bool value( const TCPReceiver& rs ) const override { return rs.message().RST; }
 };
 
 struct ExpectAcknoBetween : public Expectation<TCPReceiver>
@@ -96,7 +103,7 @@ struct ExpectAcknoBetween : public Expectation<TCPReceiver>
 
   void execute( const TCPReceiver& rs ) const override
   {
-    auto ackno = rs.send().ackno;
+    auto ackno = rs.message().ackno;
     if ( not ackno.has_value() ) {
       throw ExpectationViolation( "ackno did not have value" );
     }
@@ -108,11 +115,60 @@ struct ExpectAcknoBetween : public Expectation<TCPReceiver>
   }
 };
 
+struct ExpectSACK : public Expectation<TCPReceiver>
+{
+  std::vector<std::pair<Wrap32, Wrap32>> blocks_;
+
+  explicit ExpectSACK( std::vector<std::pair<Wrap32, Wrap32>> blocks ) : blocks_( std::move( blocks ) ) {}
+
+  template<class Blocks>
+  static std::string format( const Blocks& blocks )
+  {
+    std::ostringstream ss;
+    ss << "{";
+    for ( const auto& [left, right] : blocks ) {
+      ss << " [" << left << ", " << right << ")";
+    }
+    ss << " }";
+    return ss.str();
+  }
+
+  std::string description() const override { return "SACK blocks = " + format( blocks_ ); }
+
+  void execute( const TCPReceiver& rs ) const override
+  {
+    const auto sack = rs.message().sack;
+    std::vector<std::pair<Wrap32, Wrap32>> actual;
+    for ( const auto& block : sack ) {
+      actual.emplace_back( block.left, block.right );
+    }
+    if ( actual != blocks_ ) {
+      throw ExpectationViolation( "should have had SACK blocks = " + format( blocks_ ) + ", but instead it was "
+                                  + format( actual ) );
+    }
+  }
+};
+
 struct HasAckno : public ExpectBool<TCPReceiver>
 {
   using ExpectBool::ExpectBool;
   std::string name() const override { return "ackno.has_value()"; }
-  bool value( const TCPReceiver& rs ) const override { return rs.send().ackno.has_value(); }
+  bool value( const TCPReceiver& rs ) const override { return rs.message().ackno.has_value(); }
+};
+
+struct SendMessage : public Action<TCPReceiver>
+{
+  std::string description() const override { return "send a message, advertising the window"; }
+  void execute( TCPReceiver& rs ) const override { rs.send(); }
+};
+
+struct SetReceiverCapacity : public Action<TCPReceiver>
+{
+  uint64_t capacity_;
+
+  explicit SetReceiverCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+  std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+  void execute( TCPReceiver& rs ) const override { rs.set_capacity( capacity_ ); }
 };
 
 struct SegmentArrives : public Action<TCPReceiver>
@@ -138,6 +194,12 @@ struct SegmentArrives : public Action<TCPReceiver>
     return *this;
   }
 
+  SegmentArrives& with_sack_permitted()
+  {
+    msg_.SACK_permitted = true;
+    return *this;
+  }
+
   SegmentArrives& with_seqno( Wrap32 seqno_ )
   {
     msg_.seqno = seqno_;
@@ -0,0 +1,177 @@
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t STREAM_LENGTH = 4'000'000;
+constexpr double RATE = 2000; // bytes per ms at the bottleneck, from the client to the server
+constexpr uint64_t ONE_WAY_DELAY_MS = 50;
+constexpr uint64_t SLOW_READ_PER_MS = 200;
+
+enum class Buffer : uint8_t
+{
+  Fixed, // the default receive buffer
+  Tuned, // the default to start with, tuned up to max_recv_capacity
+  Large, // max_recv_capacity from the start
+};
+
+string buffer_name( Buffer buffer )
+{
+  switch ( buffer ) {
+    case Buffer::Fixed:
+      return "fixed";
+    case Buffer::Tuned:
+      return "tuned";
+    case Buffer::Large:
+      return "large";
+  }
+  throw runtime_error( "unknown buffer" );
+}
+
+struct Result
+{
+  uint64_t completion_ms;  // until the server's application read the whole stream
+  uint64_t peak_capacity;  // the largest the server's receive buffer grew to
+  uint64_t final_capacity; // its size at the end
+};
+
+// A client sends STREAM_LENGTH bytes to a server over a path with a bottleneck of RATE bytes per ms and
+// ONE_WAY_DELAY_MS of propagation delay each way, so that its bandwidth-delay product is three times the
+// default receive buffer. Each segment goes through the TCP header on its way. The server's application
+// reads `read_per_ms` bytes each ms, or everything that has arrived. Time advances in 1 ms ticks.
+Result run( Buffer buffer, uint64_t read_per_ms )
+{
+  TCPConfig cfg;
+  cfg.send_capacity = STREAM_LENGTH;
+  if ( buffer == Buffer::Fixed ) {
+    cfg.max_recv_capacity = cfg.recv_capacity;
+  } else if ( buffer == Buffer::Large ) {
+    cfg.recv_capacity = cfg.max_recv_capacity;
+  }
+  TCPPeer client { cfg };
+  TCPPeer server { cfg };
+
+  using Queue = deque<pair<double, TCPMessage>>;
+  Queue to_server;
+  Queue to_client;
+  uint64_t now = 0;
+  double link_free = 0;
+  const auto transmit = [&]( Queue& queue ) {
+    return [&]( const TCPMessage& message ) {
+      double sent = static_cast<double>( now );
+      if ( &queue == &to_server ) {
+        link_free = max( link_free, sent ) + static_cast<double>( message.sender->sequence_length() ) / RATE;
+        sent = link_free;
+      }
+      TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+      segment.compute_checksum( 0 );
+      TCPSegment parsed;
+      if ( not parse( parsed, vector<string> { concat( serialize( segment ) ) }, 0 ) ) {
+        throw runtime_error( "segment did not parse" );
+      }
+      queue.emplace_back( sent + ONE_WAY_DELAY_MS, move( parsed.message ) );
+    };
+  };
+  const auto deliver = [&]( Queue& queue, TCPPeer& peer, Queue& replies ) {
+    while ( not queue.empty() and queue.front().first <= static_cast<double>( now ) ) {
+      peer.receive( move( queue.front().second ), transmit( replies ) );
+      queue.pop_front();
+    }
+  };
+
+  client.outbound_writer().push( string( STREAM_LENGTH, 'x' ) );
+  client.push( transmit( to_server ) );
+  uint64_t peak_capacity = 0;
+  Reader& reader = server.inbound_reader();
+  while ( reader.bytes_popped() < STREAM_LENGTH ) {
+    if ( now > 120'000 ) {
+      throw runtime_error( "transfer did not finish in two minutes" );
+    }
+    ++now;
+    client.tick( 1, transmit( to_server ) );
+    server.tick( 1, transmit( to_client ) );
+    deliver( to_server, server, to_client );
+    deliver( to_client, client, to_server );
+    reader.pop( min( read_per_ms, reader.bytes_buffered() ) );
+    peak_capacity = max( peak_capacity, server.receiver().capacity() );
+  }
+
+  return { now, peak_capacity, server.receiver().capacity() };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  // one JSON object per line on stdout; a table on the terminal
+  debug_output << "        " << STREAM_LENGTH << " bytes at up to " << RATE << " bytes/ms; "
+               << 2 * ONE_WAY_DELAY_MS << " ms RTT\n";
+  debug_output << "          reader   buffer   completion ms   bytes/ms   peak capacity   final capacity\n";
+  vector<Result> results;
+  for ( const uint64_t read_per_ms : { STREAM_LENGTH, SLOW_READ_PER_MS } ) {
+    const string reader = read_per_ms == SLOW_READ_PER_MS ? "slow" : "fast";
+    for ( const Buffer buffer : { Buffer::Fixed, Buffer::Tuned, Buffer::Large } ) {
+      const Result r = run( buffer, read_per_ms );
+      results.push_back( r );
+      const double throughput = static_cast<double>( STREAM_LENGTH ) / static_cast<double>( r.completion_ms );
+
+      cout << R"({"reader":")" << reader << R"(","buffer":")" << buffer_name( buffer )
+           << R"(","completion_ms":)" << r.completion_ms << R"(,"bytes_per_ms":)" << throughput
+           << R"(,"peak_capacity":)" << r.peak_capacity << R"(,"final_capacity":)" << r.final_capacity << "}\n";
+
+      debug_output << "        " << setw( 8 ) << reader << setw( 9 ) << buffer_name( buffer ) << setw( 16 )
+                   << r.completion_ms << setw( 11 ) << fixed << setprecision( 0 ) << throughput << setw( 16 )
+                   << r.peak_capacity << setw( 17 ) << r.final_capacity << "\n";
+    }
+  }
+
+  // a reader that keeps up lets the buffer grow to about the bandwidth-delay product, which is nearly as
+  // fast as the largest buffer from the start, in a fraction of its memory; one that falls behind keeps the
+  // buffer at the default
+  const Result& fast_fixed = results.at( 0 );
+  const Result& fast_tuned = results.at( 1 );
+  const Result& fast_large = results.at( 2 );
+  const Result& slow_tuned = results.at( 4 );
+  if ( fast_tuned.completion_ms * 2 > fast_fixed.completion_ms
+       or fast_tuned.completion_ms * 10 > fast_large.completion_ms * 11 ) {
+    throw runtime_error( "tuned transfer took " + to_string( fast_tuned.completion_ms ) + " ms, against "
+                         + to_string( fast_fixed.completion_ms ) + " ms with a fixed buffer and "
+                         + to_string( fast_large.completion_ms ) + " ms with a large one" );
+  }
+  if ( fast_tuned.peak_capacity * 4 > fast_large.peak_capacity ) {
+    throw runtime_error( "tuned buffer grew to " + to_string( fast_tuned.peak_capacity ) + " bytes" );
+  }
+  if ( slow_tuned.peak_capacity > TCPConfig::DEFAULT_CAPACITY ) {
+    throw runtime_error( "a slow reader's buffer grew to " + to_string( slow_tuned.peak_capacity ) + " bytes" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
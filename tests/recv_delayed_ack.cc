@@ -0,0 +1,203 @@
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+const Wrap32 isn = TCPConfig {}.isn;                     // the client's
+constexpr uint32_t start = TCPPeer::QUICK_ACKS * MSS; // bytes the client sent before each test's own
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// Serialize a message into a TCP segment on the wire, and parse it back
+TCPMessage round_trip( const TCPMessage& message )
+{
+  TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+  segment.compute_checksum( 0 );
+  TCPSegment parsed;
+  if ( not parse( parsed, vector<string> { concat( serialize( segment ) ) }, 0 ) ) {
+    throw runtime_error( "segment did not parse: " + segment.to_string() );
+  }
+  return move( parsed.message );
+}
+
+// A server peer, fed segments by hand from a client that has completed the handshake with it, and sent
+// enough data after it to use up the server's quick ACKs. The client's segments from then on are kept, so
+// that the test can deliver them in any order.
+class Connection
+{
+public:
+  explicit Connection( const TCPConfig& cfg ) : client_( cfg ), server_( cfg )
+  {
+    client_.push( to( to_server_ ) );
+    deliver_all();
+    expect( client_.has_ackno() and to_server_.empty(), "handshake did not complete" );
+    client_.outbound_writer().push( string( TCPPeer::QUICK_ACKS * MSS, 'x' ) );
+    client_.push( to( to_server_ ) );
+    deliver_all();
+    server_.inbound_reader().pop( TCPPeer::QUICK_ACKS * MSS );
+    expect( to_server_.empty(), "client did not send all its data" );
+  }
+
+  // Have the client send `data`, keeping its segments, and return how many there were
+  uint64_t write( const string& data )
+  {
+    client_.outbound_writer().push( data );
+    const uint64_t before = to_server_.size();
+    client_.push( to( to_server_ ) );
+    return to_server_.size() - before;
+  }
+
+  void close()
+  {
+    client_.outbound_writer().close();
+    client_.push( to( to_server_ ) );
+  }
+
+  // Deliver the client's `i`th kept segment to the server, and return how many messages the server sent
+  uint64_t deliver( uint64_t i )
+  {
+    const uint64_t before = to_client_.size();
+    server_.receive( round_trip( to_server_.at( i ) ), to( to_client_ ) );
+    return to_client_.size() - before;
+  }
+
+  uint64_t tick( uint64_t ms )
+  {
+    const uint64_t before = to_client_.size();
+    server_.tick( ms, to( to_client_ ) );
+    return to_client_.size() - before;
+  }
+
+  TCPPeer& server() { return server_; }
+  const TCPMessage& last_from_server() const { return to_client_.back(); }
+
+private:
+  static TCPPeer::TransmitFunction to( vector<TCPMessage>& queue )
+  {
+    return [&queue]( const TCPMessage& message ) { queue.push_back( round_trip( message ) ); };
+  }
+
+  void deliver_all()
+  {
+    while ( not to_server_.empty() or not to_client_.empty() ) {
+      vector<TCPMessage> messages = move( to_server_ );
+      to_server_.clear();
+      for ( TCPMessage& message : messages ) {
+        server_.receive( move( message ), to( to_client_ ) );
+      }
+      messages = move( to_client_ );
+      to_client_.clear();
+      for ( TCPMessage& message : messages ) {
+        client_.receive( move( message ), to( to_server_ ) );
+      }
+    }
+  }
+
+  TCPPeer client_;
+  TCPPeer server_;
+  vector<TCPMessage> to_server_ {};
+  vector<TCPMessage> to_client_ {};
+};
+
+TCPConfig config()
+{
+  TCPConfig cfg;
+  cfg.nagle = false;
+  return cfg;
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // Every second full-sized segment is ACKed at once; the one after it waits for the timer
+      Connection c { config() };
+      expect( c.write( string( 3 * MSS, 'x' ) ) == 3, "client did not send three segments" );
+      expect( c.deliver( 0 ) == 0, "first segment was ACKed at once" );
+      expect( c.deliver( 1 ) == 1, "second segment was not ACKed at once" );
+      expect( c.last_from_server().receiver->ackno == isn + 1 + start + 2 * MSS, "wrong ackno" );
+      expect( c.deliver( 2 ) == 0, "third segment was ACKed at once" );
+      expect( c.tick( 39 ) == 0, "delayed ACK went before the timer" );
+      expect( c.tick( 1 ) == 1, "delayed ACK did not go after 40 ms" );
+      expect( c.last_from_server().receiver->ackno == isn + 1 + start + 3 * MSS, "wrong delayed ackno" );
+      expect( c.tick( 100 ) == 0, "delayed ACK was sent twice" );
+    }
+
+    {
+      // Short segments wait for the timer, which runs from the first of them
+      Connection c { config() };
+      c.write( "a" );
+      expect( c.deliver( 0 ) == 0, "short segment was ACKed at once" );
+      expect( c.tick( 20 ) == 0, "delayed ACK went before the timer" );
+      c.write( "b" );
+      expect( c.deliver( 1 ) == 0, "a second short segment was ACKed at once" );
+      expect( c.tick( 19 ) == 0, "delayed ACK went before the timer" );
+      expect( c.tick( 1 ) == 1, "delayed ACK did not go 40 ms after the first segment" );
+      expect( c.last_from_server().receiver->ackno == isn + 3 + start, "wrong delayed ackno" );
+    }
+
+    {
+      // Out-of-order data is ACKed at once, and so is the segment that fills the gap
+      Connection c { config() };
+      c.write( string( 3 * MSS, 'x' ) );
+      expect( c.deliver( 1 ) == 1, "out-of-order segment was not ACKed at once" );
+      expect( c.last_from_server().receiver->ackno == isn + 1 + start, "out-of-order ackno moved" );
+      expect( c.deliver( 0 ) == 1, "segment that filled a gap was not ACKed at once" );
+      expect( c.last_from_server().receiver->ackno == isn + 1 + start + 2 * MSS, "gap was not filled" );
+      // a duplicate too
+      expect( c.deliver( 0 ) == 1, "duplicate segment was not ACKed at once" );
+    }
+
+    {
+      // A FIN is ACKed at once
+      Connection c { config() };
+      c.write( "abc" );
+      c.close();
+      expect( c.deliver( 0 ) == 0, "short segment was ACKed at once" );
+      expect( c.deliver( 1 ) == 1, "FIN was not ACKed at once" );
+      expect( c.last_from_server().receiver->ackno == isn + 5 + start, "wrong ackno of FIN" );
+    }
+
+    {
+      // Data the server sends carries the ACK, and the timer stops
+      Connection c { config() };
+      c.write( "abc" );
+      expect( c.deliver( 0 ) == 0, "short segment was ACKed at once" );
+      c.server().outbound_writer().push( "reply" );
+      c.server().push( []( const TCPMessage& ) {} );
+      expect( c.tick( 100 ) == 0, "ACK was sent again after data carried it" );
+    }
+
+    {
+      // With no delay, each segment is ACKed at once
+      TCPConfig cfg = config();
+      cfg.delayed_ack_ms = 0;
+      Connection c { cfg };
+      c.write( string( 2 * MSS, 'x' ) );
+      expect( c.deliver( 0 ) == 1 and c.deliver( 1 ) == 1, "segments were not each ACKed" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+#include "byte_stream_test_harness.hh"
+#include "helpers.hh"
+#include "random.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "SACK blocks for held data, most recent first", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      test.execute( ExpectAckno { isn + 1 } );
+      test.execute( ExpectSACK { {} } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 3 ).with_data( "cd" ) );
+      test.execute( ExpectAckno { isn + 1 } );
+      test.execute( ExpectSACK { { { isn + 3, isn + 5 } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ).with_data( "gh" ) );
+      test.execute( ExpectSACK { { { isn + 7, isn + 9 }, { isn + 3, isn + 5 } } } );
+      // filling the gap between them makes one block
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "ef" ) );
+      test.execute( ExpectSACK { { { isn + 3, isn + 9 } } } );
+      // and once the data before it arrives, there is nothing beyond the ackno
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "ab" ) );
+      test.execute( ExpectAckno { isn + 9 } );
+      test.execute( ExpectSACK { {} } );
+      test.execute( ReadAll { "abcdefgh" } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "At most four SACK blocks", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      for ( const uint32_t offset : { 3, 6, 12, 15, 18, 9 } ) {
+        test.execute( SegmentArrives {}.with_seqno( isn + offset ).with_data( "x" ) );
+      }
+      test.execute( ExpectSACK { { { isn + 9, isn + 10 },
+                                   { isn + 3, isn + 4 },
+                                   { isn + 6, isn + 7 },
+                                   { isn + 12, isn + 13 } } } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "No SACK blocks unless the SYN permitted them", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 3 ).with_data( "cd" ) );
+      test.execute( ExpectAckno { isn + 1 } );
+      test.execute( ExpectSACK { {} } );
+    }
+
+    {
+      const Wrap32 isn( rd() );
+      TCPReceiverTestHarness test { "A FIN beyond a gap is SACKed with the data before it", 4000 };
+      test.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 5 ).with_data( "ef" ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 7 ).with_fin() );
+      test.execute( ExpectSACK { { { isn + 5, isn + 8 } } } );
+      // it stays SACKed until the gap before it fills
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "ab" ) );
+      test.execute( ExpectAckno { isn + 3 } );
+      test.execute( ExpectSACK { { { isn + 5, isn + 8 } } } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 3 ).with_data( "cdef" ) );
+      test.execute( ExpectAckno { isn + 8 } );
+      test.execute( ExpectSACK { {} } );
+
+      TCPReceiverTestHarness alone { "A FIN alone beyond a gap is SACKed", 4000 };
+      alone.execute( SegmentArrives {}.with_syn().with_sack_permitted().with_seqno( isn ) );
+      alone.execute( SegmentArrives {}.with_seqno( isn + 3 ).with_data( "cd" ) );
+      alone.execute( SegmentArrives {}.with_seqno( isn + 9 ).with_fin() );
+      alone.execute( ExpectSACK { { { isn + 9, isn + 10 }, { isn + 3, isn + 5 } } } );
+    }
+
+    {
+      // SACK-permitted and SACK blocks survive the trip through the TCP header's options
+      const Wrap32 isn( rd() );
+      TCPSegment segment;
+      segment.message.sender
+        = TCPSenderMessage { .seqno = isn, .SYN = true, .payload = "hi", .SACK_permitted = true };
+      TCPReceiverMessage ack { .ackno = isn + 10, .window_size = 1234 };
+      for ( uint32_t i = 0; i < TCPReceiverMessage::MAX_SACK_BLOCKS; ++i ) {
+        ack.sack.push_back( { isn + 20 + 10 * i, isn + 25 + 10 * i } );
+      }
+      segment.message.receiver = TCPReceiverMessage { ack };
+      segment.compute_checksum( 0 );
+
+      TCPSegment parsed;
+      if ( not parse( parsed, serialize( segment ), 0 ) ) {
+        throw runtime_error( "segment with SACK options did not parse" );
+      }
+      const TCPSenderMessage& sender = parsed.message.sender;
+      const TCPReceiverMessage& receiver = parsed.message.receiver;
+      if ( not sender.SYN or not sender.SACK_permitted or sender.payload != "hi" or sender.seqno != isn ) {
+        throw runtime_error( "SYN with SACK-permitted came back as " + parsed.to_string() );
+      }
+      if ( receiver.ackno != ack.ackno or receiver.window_size != 1234
+           or receiver.sack.size() != ack.sack.size() ) {
+        throw runtime_error( "ACK with SACK blocks came back as " + parsed.to_string() );
+      }
+      for ( size_t i = 0; i < ack.sack.size(); ++i ) {
+        if ( receiver.sack[i].left != ack.sack[i].left or receiver.sack[i].right != ack.sack[i].right ) {
+          throw runtime_error( "SACK block " + to_string( i ) + " came back as " + parsed.to_string() );
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
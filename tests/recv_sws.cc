@@ -0,0 +1,278 @@
+#include "byte_stream_test_harness.hh"
+#include "helpers.hh"
+#include "receiver_test_harness.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = 1000;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// Serialize a message into a TCP segment on the wire, and parse it back
+TCPMessage round_trip( const TCPMessage& message )
+{
+  TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+  segment.compute_checksum( 0 );
+  TCPSegment parsed;
+  if ( not parse( parsed, vector<string> { concat( serialize( segment ) ) }, 0 ) ) {
+    throw runtime_error( "segment did not parse: " + segment.to_string() );
+  }
+  return move( parsed.message );
+}
+
+// A client sends a long stream to a server 5 ms away, whose application reads only a few bytes each ms from
+// a receive buffer of a few segments. Time advances in 1 ms ticks.
+class SlowReader
+{
+public:
+  static constexpr uint64_t stream_length = 20000;
+  static constexpr uint64_t read_per_ms = 10;
+  static constexpr uint64_t delay = 5;
+
+  explicit SlowReader( bool sws_avoidance )
+  {
+    TCPConfig cfg;
+    cfg.recv_capacity = cfg.max_recv_capacity = 4 * MSS; // not tuned, and so not scaled
+    cfg.sws_avoidance = sws_avoidance;
+    cfg.delayed_ack_ms = 0; // delayed ACKs hold back small window updates too, and would hide the difference
+    client_.emplace( cfg );
+    server_.emplace( cfg );
+    client_->outbound_writer().push( string( stream_length, 'x' ) );
+    client_->outbound_writer().close();
+    client_->push( transmit( to_server_, true ) );
+  }
+
+  // Run until the server has read the whole stream, and return how long that took in ms
+  uint64_t run()
+  {
+    while ( not server_->inbound_reader().is_finished() ) {
+      expect( now_ < 60'000, "slow-reader transfer did not finish in a minute" );
+      ++now_;
+      client_->tick( 1, transmit( to_server_, true ) );
+      server_->tick( 1, transmit( to_client_, false ) );
+      deliver( to_server_, *server_, transmit( to_client_, false ) );
+      deliver( to_client_, *client_, transmit( to_server_, true ) );
+      Reader& reader = server_->inbound_reader();
+      reader.pop( min( read_per_ms, reader.bytes_buffered() ) );
+    }
+    return now_;
+  }
+
+  uint64_t data_segments() const { return data_segments_; }
+  uint64_t smallest_segment() const { return smallest_segment_; }
+  uint64_t window_updates() const { return window_updates_; }
+
+private:
+  using Queue = deque<pair<uint64_t, TCPMessage>>;
+
+  TCPPeer::TransmitFunction transmit( Queue& queue, bool from_client )
+  {
+    return [this, &queue, from_client]( const TCPMessage& message ) {
+      const uint64_t size = message.sender->payload.size();
+      if ( from_client and size > 0 ) {
+        ++data_segments_;
+        // a zero-window probe carries one byte; the segment carrying the last bytes may be short
+        if ( size > 1 and not message.sender->FIN ) {
+          smallest_segment_ = min( smallest_segment_, size );
+        }
+      }
+      if ( not from_client and message.sender->sequence_length() == 0 and message.receiver->window_size > 0
+           and last_window_ == 0 ) {
+        ++window_updates_;
+      }
+      if ( not from_client ) {
+        last_window_ = message.receiver->window_size;
+      }
+      queue.emplace_back( now_ + delay, round_trip( message ) );
+    };
+  }
+
+  void deliver( Queue& queue, TCPPeer& peer, const TCPPeer::TransmitFunction& reply )
+  {
+    while ( not queue.empty() and queue.front().first <= now_ ) {
+      peer.receive( move( queue.front().second ), reply );
+      queue.pop_front();
+    }
+  }
+
+  optional<TCPPeer> client_ {};
+  optional<TCPPeer> server_ {};
+  Queue to_server_ {};
+  Queue to_client_ {};
+  uint64_t now_ {};
+  uint64_t data_segments_ {};
+  uint64_t smallest_segment_ { UINT64_MAX };
+  uint64_t window_updates_ {};
+  uint16_t last_window_ { UINT16_MAX };
+};
+} // namespace
+
+int main()
+{
+  try {
+    {
+      const size_t cap = 4000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "A slow reader opens the window an MSS at a time", cap, MSS };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindow { cap } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 500 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 499 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { MSS } );
+      test.execute( SendMessage {} );
+      // room freed past the edge advertised is not offered until there is an MSS of it
+      test.execute( Pop { 300 } );
+      test.execute( ExpectWindow { MSS } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 + cap ).with_data( string( 600, 'x' ) ) );
+      test.execute( ExpectWindow { 400 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 + cap + 600 ).with_data( string( 400, 'x' ) ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 + cap + MSS } } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 699 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { MSS } );
+    }
+
+    {
+      const size_t cap = 4000;
+      const uint32_t isn = 777;
+      TCPReceiverTestHarness test { "Looking at the window does not advertise it", cap, MSS };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( Pop { 1000 } );
+      test.execute( ExpectWindow { MSS } );
+      test.execute( Pop { 500 } );
+      test.execute( ExpectWindow { 1500 } );
+      test.execute( SendMessage {} );
+      test.execute( Pop { 500 } );
+      test.execute( ExpectWindow { 1500 } );
+    }
+
+    {
+      const size_t cap = 600;
+      const uint32_t isn = 9321;
+      TCPReceiverTestHarness test { "A buffer smaller than two segments opens by half its size", cap, MSS };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 299 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 300 } );
+      test.execute( Pop { 300 } );
+      test.execute( ExpectWindow { cap } );
+    }
+
+    {
+      const size_t cap = 4000;
+      const uint32_t isn = 1;
+      TCPReceiverTestHarness test { "Without SWS avoidance, every byte read reopens the window", cap };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( Pop { 10 } );
+      test.execute( ExpectWindow { 10 } );
+    }
+
+    {
+      // A peer that advertised a zero window says when it opens, rather than wait for the sender's probe
+      TCPConfig cfg;
+      cfg.recv_capacity = cfg.max_recv_capacity = 4 * MSS; // not tuned, and so not scaled
+      cfg.nagle = false;
+      TCPPeer client { cfg };
+      TCPPeer server { cfg };
+      vector<TCPMessage> to_server;
+      vector<TCPMessage> to_client;
+      const auto to = []( vector<TCPMessage>& queue ) {
+        return [&queue]( const TCPMessage& message ) { queue.push_back( round_trip( message ) ); };
+      };
+      const auto deliver = [&]( vector<TCPMessage>& queue, TCPPeer& peer, vector<TCPMessage>& replies ) {
+        vector<TCPMessage> messages = move( queue );
+        queue.clear();
+        for ( TCPMessage& message : messages ) {
+          peer.receive( move( message ), to( replies ) );
+        }
+      };
+      client.push( to( to_server ) );
+      deliver( to_server, server, to_client );
+      deliver( to_client, client, to_server );
+      client.outbound_writer().push( string( 5 * MSS, 'x' ) );
+      client.push( to( to_server ) );
+      deliver( to_server, server, to_client );
+      expect( not to_client.empty() and to_client.back().receiver->window_size == 0,
+              "server did not close its window" );
+      // the client probes the closed window with one byte, which the server has no room to offer yet
+      deliver( to_client, client, to_server );
+      expect( to_server.size() == 1 and to_server.back().sender->payload.size() == 1,
+              "client did not probe the closed window" );
+      deliver( to_server, server, to_client );
+      expect( not to_client.empty() and to_client.back().receiver->window_size == 0,
+              "server opened its window to the probe" );
+      to_client.clear();
+
+      server.inbound_reader().pop( MSS - 1 );
+      server.tick( 1, to( to_client ) );
+      expect( to_client.empty(), "server sent a window update for less than an MSS" );
+      server.inbound_reader().pop( 1 );
+      server.tick( 1, to( to_client ) );
+      expect( to_client.size() == 1 and to_client.back().receiver->window_size == MSS
+                and to_client.back().sender->sequence_length() == 0,
+              "server did not send a bare window update when its window opened" );
+      server.tick( 1, to( to_client ) );
+      expect( to_client.size() == 1, "server repeated its window update" );
+      deliver( to_client, client, to_server );
+      // the probe's byte is still in flight, so the rest of the window is one byte short of an MSS
+      expect( to_server.size() == 1 and to_server.back().sender->payload.size() == MSS - 1,
+              "client did not send the segment the window update made room for" );
+    }
+
+    {
+      // The same slow reader, with and without SWS avoidance
+      SlowReader avoiding { true };
+      const uint64_t avoiding_ms = avoiding.run();
+      SlowReader naive { false };
+      naive.run();
+      // each time the window opens, it is by an MSS, less the byte of a probe that was sent into it while closed
+      expect( avoiding.smallest_segment() >= MSS - 1,
+              "with SWS avoidance, the client sent a segment of " + to_string( avoiding.smallest_segment() )
+                + " bytes" );
+      expect( naive.data_segments() > 4 * avoiding.data_segments(),
+              "SWS avoidance took " + to_string( avoiding.data_segments() ) + " segments, against "
+                + to_string( naive.data_segments() ) + " without" );
+      expect( avoiding.window_updates() > 0, "the server never sent a window update" );
+      // window updates keep the sender from stalling until its RTO each time the window closes
+      expect( avoiding_ms < SlowReader::stream_length / SlowReader::read_per_ms + 200,
+              "the slow-reader transfer took " + to_string( avoiding_ms ) + " ms" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
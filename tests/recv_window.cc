@@ -106,6 +106,33 @@ int main()
       test.execute( BytesPending( 0 ) );
     }
 
+    {
+      const size_t cap = 4;
+      const uint32_t isn = 5;
+      TCPReceiverTestHarness test { "window follows set_capacity, but never shrinks", cap, nullopt, 16 };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindow { 4 } );
+      test.execute( SetReceiverCapacity { 8 } );
+      test.execute( ExpectWindow { 8 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "abcdefgh" ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( ReadAll { "abcdefgh" } );
+      test.execute( ExpectWindow { 8 } );
+      test.execute( SendMessage {} );
+      // a smaller capacity keeps the window already advertised
+      test.execute( SetReceiverCapacity { 2 } );
+      test.execute( ExpectWindow { 8 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 9 ).with_data( "ijklmnop" ) );
+      test.execute( BytesPushed { 16 } );
+      test.execute( ReadAll { "ijklmnop" } );
+      test.execute( ExpectWindow { 2 } );
+      test.execute( SetReceiverCapacity { 2 } );
+      test.execute( AvailableCapacity { 2 } );
+      // and a larger one stops at the max
+      test.execute( SetReceiverCapacity { 100 } );
+      test.execute( ExpectWindow { 16 } );
+    }
+
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
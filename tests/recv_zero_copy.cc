@@ -0,0 +1,126 @@
+#include "byte_stream_test_harness.hh"
+#include "helpers.hh"
+#include "reassembler_test_harness.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// A peer fed datagrams through a pipe, read back with the same readv layout as the TUN adapter uses
+class Pipeline
+{
+public:
+  explicit Pipeline( const TCPConfig& cfg ) : peer_( cfg )
+  {
+    remote_.config_mut().source = Address { "10.0.0.1", 5000 };
+    remote_.config_mut().destination = Address { "10.0.0.2", 6000 };
+    local_.config_mut().source = remote_.config().destination;
+    local_.config_mut().destination = remote_.config().source;
+  }
+
+  // Deliver one segment to the peer; returns where its payload was read into, and whether parsing left it
+  // there as read (erasing option bytes from its front would shift the rest in place)
+  pair<const char*, bool> deliver( TCPSenderMessage msg )
+  {
+    write_end_.write( serialize( remote_.wrap_tcp_in_ip( { move( msg ), TCPReceiverMessage {} } ) ) );
+    auto buffers = local_.make_read_buffers();
+    read_end_.read( buffers );
+    const char* payload = buffers.back().data();
+    const size_t read_size = buffers.back().size();
+    auto message = local_.unwrap_read_buffers( move( buffers ) );
+    if ( not message.has_value() ) {
+      throw runtime_error( "datagram read from the pipe did not parse" );
+    }
+    const bool in_place
+      = message->sender->payload.data() == payload and message->sender->payload.size() == read_size;
+    peer_.receive( move( *message ), []( const TCPMessage& /*unused*/ ) {} );
+    return { payload, in_place };
+  }
+
+  TCPPeer& peer() { return peer_; }
+
+private:
+  TCPOverIPv4Adapter remote_ {}; // wraps the peer's segments
+  TCPOverIPv4Adapter local_ {};  // unwraps them, as TCPOverIPv4OverTunFdAdapter::read() does
+  TCPPeer peer_;
+  pair<FileDescriptor, FileDescriptor> pipe_ { make_pipe() };
+  FileDescriptor& read_end_ { pipe_.first };
+  FileDescriptor& write_end_ { pipe_.second };
+};
+
+// Send `segments` in-order segments, with timestamps if `timestamps`; count the payloads parsing moved, and
+// those the inbound stream holds a copy of
+pair<size_t, size_t> transfer( const TCPConfig& cfg, bool timestamps, size_t segments )
+{
+  Pipeline pipeline { cfg };
+  const Wrap32 isn { 1234 };
+  const auto timestamp = [&]( uint32_t t ) { return timestamps ? optional<uint32_t> { t } : nullopt; };
+  pipeline.deliver( { .seqno = isn, .SYN = true, .timestamp = timestamp( 1 ) } );
+
+  size_t moved = 0;
+  size_t copies = 0;
+  for ( size_t i = 0; i < segments; ++i ) {
+    const string data( 1000, static_cast<char>( 'a' + i % 26 ) );
+    const auto [read_into, in_place] = pipeline.deliver(
+      { .seqno = isn + 1 + i * data.size(), .payload = data, .timestamp = timestamp( 2 + i ) } );
+    Reader& reader = pipeline.peer().inbound_reader();
+    const auto view = reader.peek();
+    if ( view != data ) {
+      throw runtime_error( "in-order payload did not reach the inbound stream" );
+    }
+    moved += not in_place;
+    copies += view.data() != read_into;
+    reader.pop( view.size() );
+  }
+  return { moved, copies };
+}
+
+} // namespace
+
+// In-order payloads must reach a Chunked inbound stream in the very buffer they were read into, with or
+// without timestamps. The default configuration (Paged storage) copies every payload into pages.
+int main()
+{
+  try {
+    constexpr size_t segments = 100;
+    for ( const auto mode : { Reassembler::Mode::Intervals, Reassembler::Mode::Bitmap } ) {
+      for ( const bool timestamps : { false, true } ) {
+        TCPConfig cfg;
+        cfg.recv_storage = ByteStream::Storage::Chunked;
+        cfg.reassembly = mode;
+        const auto [moved, copies] = transfer( cfg, timestamps, segments );
+        if ( moved != 0 or copies != 0 ) {
+          throw runtime_error( to_string( moved ) + " of " + to_string( segments ) + " in-order payloads were moved"
+                               + " and " + to_string( copies ) + " copied (" + mode_name( mode )
+                               + ( timestamps ? ", with timestamps)" : ")" ) );
+        }
+      }
+    }
+
+    // The default TCPPeer is not zero-copy: parsing leaves each payload in place, but the Paged inbound
+    // stream then copies it into its own pages
+    if ( TCPConfig {}.recv_storage != ByteStream::Storage::Paged ) {
+      throw runtime_error( "the default inbound storage changed; update this test to match" );
+    }
+    for ( const bool timestamps : { false, true } ) {
+      const auto [moved, copies] = transfer( TCPConfig {}, timestamps, segments );
+      if ( moved != 0 or copies != segments ) {
+        throw runtime_error( "with the default configuration" + string( timestamps ? " and timestamps, " : ", " )
+                             + to_string( moved ) + " of " + to_string( segments ) + " in-order payloads were moved"
+                             + " and " + to_string( copies ) + " copied (expected 0 and all)" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#include "bbr.hh"
+#include "tcp_config.hh"
+#include "tcp_sender.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// A sender with an endless stream to send over a path with one bottleneck link: segments queue for
+// the link, cross it at `rate` bytes per ms, and each is acknowledged 2 * `delay` ms after it has.
+// Time advances in 1 ms ticks.
+class Path
+{
+public:
+  static constexpr double delay = 10;
+
+  explicit Path( CongestionControl::Algorithm algorithm, double rate = 1000 )
+    : sender_( ByteStream { 64000 }, Wrap32 { 0 }, 1000, { .congestion = algorithm } ), rate_( rate )
+  {
+    fill();
+    sender_.push( transmit() );
+  }
+
+  // Advance one millisecond; returns how many segments the sender sent in it
+  size_t step()
+  {
+    sent_ = 0;
+    ++now_;
+    sender_.tick( 1, transmit() );
+    while ( not acks_.empty() and acks_.front().first <= static_cast<double>( now_ ) ) {
+      sender_.receive( { acks_.front().second, UINT16_MAX } );
+      acks_.pop_front();
+    }
+    fill();
+    sender_.push( transmit() );
+    return sent_;
+  }
+
+  const TCPSender& sender() const { return sender_; }
+  const Bbr& bbr() const { return dynamic_cast<const Bbr&>( sender_.congestion_control() ); }
+  uint64_t now() const { return now_; }
+  double rate() const { return rate_; }
+  double queue_delay() const { return max( 0.0, link_free_ - static_cast<double>( now_ ) ); } // in ms
+  uint64_t bytes_delivered() const
+  {
+    return sender_.reader().bytes_popped() - sender_.sequence_numbers_in_flight();
+  }
+
+private:
+  void fill() { sender_.writer().push( string( sender_.writer().available_capacity(), 'x' ) ); }
+
+  TCPSender::TransmitFunction transmit()
+  {
+    return [this]( const TCPSenderMessage& msg ) {
+      ++sent_;
+      link_free_ = max( link_free_, static_cast<double>( now_ ) )
+                   + static_cast<double>( msg.sequence_length() ) / rate_;
+      acks_.emplace_back( link_free_ + 2 * delay, msg.seqno + msg.sequence_length() );
+    };
+  }
+
+  TCPSender sender_;
+  double rate_;
+  uint64_t now_ {};
+  double link_free_ {};
+  size_t sent_ {};
+  deque<pair<double, Wrap32>> acks_ {};
+};
+
+string state_name( Bbr::State state )
+{
+  switch ( state ) {
+    case Bbr::State::Startup:
+      return "Startup";
+    case Bbr::State::Drain:
+      return "Drain";
+    case Bbr::State::ProbeBW:
+      return "ProbeBW";
+    case Bbr::State::ProbeRTT:
+      return "ProbeRTT";
+  }
+  return "?";
+}
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // Startup finds the bandwidth, Drain empties the queue it built, then ProbeBW keeps the link
+      // busy with only a small queue, pacing segments out rather than sending them in bursts
+      Path path { CongestionControl::Algorithm::Bbr };
+      vector<Bbr::State> states { path.bbr().state() };
+      double peak_queue = 0;
+      size_t peak_burst = 0;
+      uint64_t delivered_at_2s = 0;
+      while ( path.now() < 5000 ) {
+        const size_t burst = path.step();
+        if ( path.bbr().state() != states.back() ) {
+          states.push_back( path.bbr().state() );
+        }
+        if ( path.now() == 2000 ) {
+          delivered_at_2s = path.bytes_delivered();
+        }
+        if ( path.now() > 2000 ) {
+          peak_queue = max( peak_queue, path.queue_delay() );
+          peak_burst = max( peak_burst, burst );
+        }
+      }
+
+      string sequence;
+      for ( const auto state : states ) {
+        sequence += ( sequence.empty() ? "" : " " ) + state_name( state );
+      }
+      expect( sequence == "Startup Drain ProbeBW", "BBR went through " + sequence );
+
+      const double btl_bw = static_cast<double>( path.bbr().btl_bw() );
+      expect( btl_bw >= 0.9 * path.rate() * 1000 and btl_bw <= 1.15 * path.rate() * 1000,
+              "BBR estimated the bottleneck at " + to_string( btl_bw ) + " bytes/s" );
+      const uint64_t min_rtt = path.bbr().min_rtt_us();
+      expect( min_rtt >= 2 * Path::delay * 1000 and min_rtt <= ( 2 * Path::delay + 3 ) * 1000,
+              "BBR estimated the min RTT at " + to_string( min_rtt ) + " us" );
+
+      const double throughput = static_cast<double>( path.bytes_delivered() - delivered_at_2s ) / 3000;
+      expect( throughput >= 0.9 * path.rate(),
+              "BBR delivered only " + to_string( throughput ) + " bytes/ms in ProbeBW" );
+      expect( peak_queue <= 10, "BBR built a " + to_string( peak_queue ) + " ms queue in ProbeBW" );
+      expect( peak_burst <= 3, "BBR sent " + to_string( peak_burst ) + " segments in one ms in ProbeBW" );
+    }
+
+    {
+      // without a model of the path, NewReno fills the queue up to the receiver's window
+      Path path { CongestionControl::Algorithm::NewReno };
+      double peak_queue = 0;
+      while ( path.now() < 5000 ) {
+        path.step();
+        peak_queue = max( peak_queue, path.queue_delay() );
+      }
+      expect( peak_queue >= 30, "NewReno built only a " + to_string( peak_queue ) + " ms queue" );
+    }
+
+    {
+      // Ten seconds after the min RTT was last seen, ProbeRTT holds four segments in flight for 200 ms
+      Path path { CongestionControl::Algorithm::Bbr };
+      uint64_t probe_rtt_start = 0;
+      uint64_t probe_rtt_ms = 0;
+      while ( path.now() < 12000 ) {
+        path.step();
+        if ( path.bbr().state() == Bbr::State::ProbeRTT ) {
+          probe_rtt_start = probe_rtt_start == 0 ? path.now() : probe_rtt_start;
+          ++probe_rtt_ms;
+          expect( path.sender().congestion_control().cwnd() == 4 * MSS, "BBR ProbeRTT cwnd is not 4 segments" );
+        }
+      }
+      expect( probe_rtt_start >= 10000 and probe_rtt_start <= 10100,
+              "BBR entered ProbeRTT at " + to_string( probe_rtt_start ) + " ms" );
+      expect( probe_rtt_ms >= 200 and probe_rtt_ms <= 300,
+              "BBR stayed in ProbeRTT for " + to_string( probe_rtt_ms ) + " ms" );
+      expect( path.bbr().state() == Bbr::State::ProbeBW, "BBR did not go back to ProbeBW after ProbeRTT" );
+    }
+
+    {
+      // A pacing rate that is not a whole number of segments per tick still comes out right on average
+      Path path { CongestionControl::Algorithm::Bbr, 1500 };
+      while ( path.bbr().state() != Bbr::State::ProbeBW or path.bbr().pacing_gain() != 1 ) {
+        path.step();
+      }
+      const double paced = static_cast<double>( path.bbr().pacing_rate() ) / 1000 / MSS;
+      const uint64_t start = path.now();
+      size_t segments = 0;
+      while ( path.bbr().pacing_gain() == 1 and path.now() - start < 100 ) {
+        segments += path.step();
+      }
+      const double per_ms = static_cast<double>( segments ) / static_cast<double>( path.now() - start );
+      expect( abs( per_ms - paced ) <= 0.1 * paced,
+              "BBR sent " + to_string( per_ms ) + " segments per ms when pacing at " + to_string( paced ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,368 @@
+#include "cubic.hh"
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// Feeds one controller a connection's events, keeping the sequence numbers consistent
+struct Flow
+{
+  CongestionControl& cc;
+  uint64_t now_ms = 0;
+  uint64_t ackno = 1;
+  uint64_t next_seqno = 1;
+  uint64_t srtt_ms = 0;
+
+  void send( uint64_t bytes ) { next_seqno += bytes; }
+  void ack( uint64_t bytes )
+  {
+    ackno += bytes;
+    cc.on_ack( { now_ms * 1000, ackno, next_seqno, next_seqno - ackno, bytes, nullopt, srtt_ms * 1000 } );
+  }
+  void dup_ack() { cc.on_ack( { now_ms * 1000, ackno, next_seqno, next_seqno - ackno, 0 } ); }
+  void loss() { cc.on_loss( { now_ms * 1000, ackno, next_seqno, next_seqno - ackno, 0 } ); }
+  void timeout() { cc.on_timeout( { now_ms * 1000, ackno, next_seqno, next_seqno - ackno, 0 } ); }
+
+  // Send and acknowledge one segment at a time until cwnd reaches `bytes`
+  void grow_to( uint64_t bytes )
+  {
+    while ( cc.cwnd() < bytes ) {
+      send( MSS );
+      ack( MSS );
+    }
+  }
+};
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Initial window, then slow start", cfg, CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 4 * MSS } );
+      test.execute( Push { string( 10 * MSS, 'x' ) } );
+      for ( int i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 4 * MSS } );
+
+      // one segment acknowledged: cwnd grows by one segment, so two more can go
+      test.execute( AckReceived { Wrap32 { isn + 1 + MSS } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 5 * MSS } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectNoSegment {} );
+
+      // a cumulative ACK for five segments still grows cwnd by only one (RFC 3465 with L = 1 SMSS)
+      test.execute( AckReceived { Wrap32 { isn + 1 + 6 * MSS } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 6 * MSS } );
+      for ( int i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Sender respects min(cwnd, rwnd)", cfg, CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 2500 ) );
+      test.execute( Push { string( 10 * MSS, 'x' ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 500 ) );
+      test.execute( ExpectNoSegment {} );
+
+      // the receiver opens its window: now cwnd (5 segments after this ACK) is the limit
+      test.execute( AckReceived { Wrap32 { isn + 1 + MSS } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 5 * MSS } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 500 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 5 * MSS } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 100;
+
+      TCPSenderTestHarness test {
+        "Timeout collapses cwnd to one segment", cfg, CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60000 ) );
+      test.execute( Push { string( 8 * MSS, 'x' ) } );
+      for ( int i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      }
+      test.execute( Tick { 100 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ).with_seqno( isn + 1 ) );
+      // RFC 5681 (4): ssthresh = max(FlightSize / 2, 2 * SMSS), then cwnd = 1 SMSS
+      test.execute( ExpectSsthresh { 2 * MSS } );
+      test.execute( ExpectCwnd { MSS } );
+
+      // a second timeout of the same segment leaves ssthresh alone
+      test.execute( Tick { 200 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ).with_seqno( isn + 1 ) );
+      test.execute( ExpectSsthresh { 2 * MSS } );
+      test.execute( ExpectCwnd { MSS } );
+
+      // slow start up to ssthresh, then congestion avoidance: SMSS * SMSS / cwnd per ACK
+      test.execute( AckReceived { Wrap32 { isn + 1 + MSS } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 2 * MSS } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 + 2 * MSS } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 2 * MSS + MSS / 2 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS / 2 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 + 4 * MSS } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 2 * MSS + MSS / 2 + MSS * MSS / ( 2 * MSS + MSS / 2 ) } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 400 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 100;
+
+      TCPSenderTestHarness test { "Zero-window probe timeouts are not congestion", cfg,
+                                  CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "a" ) );
+      test.execute( Tick { 100 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "a" ) );
+      test.execute( ExpectCwnd { 4 * MSS } );
+      test.execute( ExpectSsthresh { UINT64_MAX } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 100;
+
+      TCPSenderTestHarness test { "CUBIC timeout", cfg, CongestionControl::Algorithm::Cubic };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60000 ) );
+      test.execute( ExpectCwnd { 4 * MSS } );
+      test.execute( Push { string( 4 * MSS, 'x' ) } );
+      for ( int i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ) );
+      }
+      test.execute( Tick { 100 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( MSS ).with_seqno( isn + 1 ) );
+      // RFC 9438 section 4.8: ssthresh = max(FlightSize * beta_cubic, 2 * SMSS), cwnd = 1 SMSS
+      test.execute( ExpectSsthresh { 2800 } );
+      test.execute( ExpectCwnd { MSS } );
+    }
+
+    {
+      // RFC 6582: NewReno fast recovery
+      NewReno reno { MSS };
+      Flow flow { reno };
+      flow.grow_to( 10 * MSS );
+      flow.send( 10 * MSS );
+      flow.loss();
+      expect( reno.in_recovery(), "NewReno did not enter fast recovery" );
+      expect( reno.ssthresh() == 5 * MSS, "NewReno ssthresh after loss is not FlightSize / 2" );
+      expect( reno.cwnd() == 8 * MSS, "NewReno cwnd after loss is not ssthresh + 3 * SMSS" );
+
+      flow.dup_ack();
+      expect( reno.cwnd() == 9 * MSS, "NewReno did not inflate cwnd on a duplicate ACK" );
+      flow.loss();
+      expect( reno.ssthresh() == 5 * MSS and reno.cwnd() == 9 * MSS, "NewReno reduced twice in one window" );
+
+      flow.ack( 2 * MSS );
+      expect( reno.in_recovery(), "NewReno left fast recovery on a partial ACK" );
+      expect( reno.cwnd() == 8 * MSS, "NewReno did not deflate cwnd on a partial ACK" );
+
+      flow.send( 2 * MSS );
+      flow.ack( 8 * MSS );
+      expect( not reno.in_recovery(), "NewReno stayed in fast recovery after a full ACK" );
+      expect( reno.cwnd() == 3 * MSS, "NewReno cwnd after a full ACK is not min(ssthresh, FlightSize + SMSS)" );
+    }
+
+    {
+      // RFC 5681: congestion avoidance grows cwnd by about one segment per window acknowledged
+      NewReno reno { MSS };
+      Flow flow { reno };
+      flow.grow_to( 16 * MSS );
+      flow.send( 16 * MSS );
+      flow.timeout();
+      // a loss of data sent before the timeout is not a new congestion event
+      flow.loss();
+      expect( not reno.in_recovery(), "NewReno reduced again for a loss from before the timeout" );
+      flow.ack( 16 * MSS );
+      flow.grow_to( 8 * MSS );
+      expect( reno.cwnd() == reno.ssthresh(), "NewReno slow start overshot ssthresh" );
+      for ( int i = 0; i < 8; ++i ) {
+        flow.send( MSS );
+        flow.ack( MSS );
+      }
+      expect( reno.cwnd() > 8 * MSS + 9 * MSS / 10 and reno.cwnd() <= 9 * MSS,
+              "NewReno grew by " + to_string( reno.cwnd() - 8 * MSS ) + " bytes in one window" );
+    }
+
+    {
+      // RFC 9438 section 4.2: after a loss at W_max, cwnd follows W_cubic(t) = C * (t - K)^3 + W_max,
+      // levelling off as it gets back to W_max
+      Cubic cubic { MSS };
+      Flow flow { cubic };
+      flow.grow_to( 100 * MSS );
+      flow.send( 100 * MSS );
+      flow.loss();
+      expect( cubic.ssthresh() == 70 * MSS, "CUBIC ssthresh after loss is not FlightSize * beta_cubic" );
+      flow.send( 70 * MSS );
+      flow.ack( 100 * MSS );
+      expect( not cubic.in_recovery() and cubic.cwnd() == 70 * MSS, "CUBIC did not leave recovery at ssthresh" );
+
+      // one segment acknowledged every millisecond, so cwnd can keep up with W_cubic
+      flow.send( MSS );
+      flow.ack( MSS );
+      expect( abs( cubic.w_max() - 100 ) < 1e-9, "CUBIC W_max is not cwnd at the loss" );
+      expect( abs( cubic.k() - cbrt( 30 / Cubic::kC ) ) < 1e-9, "CUBIC K is not cbrt(W_max * (1 - beta) / C)" );
+
+      const double k = cubic.k();
+      const uint64_t epoch_start = flow.now_ms;
+      for ( const double t : { 1.0, k / 2, k } ) {
+        while ( flow.now_ms < epoch_start + static_cast<uint64_t>( t * 1000 ) ) {
+          ++flow.now_ms;
+          flow.send( MSS );
+          flow.ack( MSS );
+        }
+        const double w_cubic = Cubic::kC * pow( t - k, 3 ) + 100;
+        const double cwnd = static_cast<double>( cubic.cwnd() ) / MSS;
+        expect( cwnd <= w_cubic + 0.01 and cwnd >= w_cubic - 3,
+                "CUBIC cwnd at t=" + to_string( t ) + " s is " + to_string( cwnd ) + " segments, W_cubic is "
+                  + to_string( w_cubic ) );
+      }
+    }
+
+    {
+      // RFC 9438 section 4.2: the target is W_cubic(t + RTT), so with a 100 ms RTT, cwnd runs ahead of a
+      // flow's that measured none, but no further than W_cubic one RTT from now
+      Cubic with_rtt { MSS };
+      Cubic without_rtt { MSS };
+      array<Flow, 2> flows { { { with_rtt }, { without_rtt } } };
+      flows[0].srtt_ms = 100;
+      for ( Flow& flow : flows ) {
+        flow.grow_to( 100 * MSS );
+        flow.send( 100 * MSS );
+        flow.loss();
+        flow.send( 70 * MSS );
+        flow.ack( 100 * MSS );
+        flow.send( MSS );
+        flow.ack( MSS );
+      }
+
+      const double k = with_rtt.k();
+      const uint64_t epoch_start = flows[0].now_ms;
+      for ( const double t : { 1.0, k / 2, k - 0.1 } ) {
+        for ( Flow& flow : flows ) {
+          while ( flow.now_ms < epoch_start + static_cast<uint64_t>( t * 1000 ) ) {
+            ++flow.now_ms;
+            flow.send( MSS );
+            flow.ack( MSS );
+          }
+        }
+        const double w_cubic_ahead = Cubic::kC * pow( t + 0.1 - k, 3 ) + 100;
+        const double cwnd = static_cast<double>( with_rtt.cwnd() ) / MSS;
+        const double cwnd_without_rtt = static_cast<double>( without_rtt.cwnd() ) / MSS;
+        expect( cwnd <= w_cubic_ahead + 0.01 and cwnd > cwnd_without_rtt,
+                "CUBIC cwnd at t=" + to_string( t ) + " s is " + to_string( cwnd ) + " segments with a 100 ms RTT, "
+                  + to_string( cwnd_without_rtt ) + " without; W_cubic(t + RTT) is " + to_string( w_cubic_ahead ) );
+      }
+    }
+
+    {
+      // RFC 9438 section 4.3: where W_cubic is below the Reno-friendly estimate, cwnd follows the estimate,
+      // which grows by alpha_cubic = 3 * (1 - beta) / (1 + beta) segments per window acknowledged
+      Cubic cubic { MSS };
+      Flow flow { cubic };
+      flow.grow_to( 40 * MSS );
+      flow.send( 40 * MSS );
+      flow.loss();
+      flow.send( 28 * MSS );
+      flow.ack( 40 * MSS );
+      flow.send( MSS );
+      flow.ack( MSS ); // starts the epoch
+      const uint64_t before = cubic.cwnd();
+      for ( uint64_t i = 0; i < before / MSS; ++i ) {
+        flow.send( MSS );
+        flow.ack( MSS ); // no time passes, so W_cubic stays at cwnd
+      }
+      const double grown = static_cast<double>( cubic.cwnd() - before ) / MSS;
+      const double alpha = 3 * ( 1 - Cubic::kBeta ) / ( 1 + Cubic::kBeta );
+      expect( abs( grown - alpha ) < 0.05,
+              "CUBIC grew by " + to_string( grown ) + " segments in one window instead of " + to_string( alpha ) );
+    }
+
+    {
+      // RFC 9438 section 4.7: fast convergence lowers W_max when losses come before reaching it
+      Cubic cubic { MSS };
+      Flow flow { cubic };
+      flow.grow_to( 100 * MSS );
+      flow.send( 100 * MSS );
+      flow.loss();
+      flow.send( 70 * MSS );
+      flow.ack( 100 * MSS );
+      flow.send( 10 * MSS );
+      flow.ack( 10 * MSS );
+      const double cwnd = static_cast<double>( cubic.cwnd() ) / MSS;
+      expect( cwnd < cubic.w_max(), "CUBIC cwnd should still be below W_max" );
+      flow.send( 10 * MSS );
+      flow.loss();
+      expect( abs( cubic.w_max() - cwnd * ( 1 + Cubic::kBeta ) / 2 ) < 1e-9,
+              "CUBIC fast convergence did not lower W_max" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -5,7 +5,9 @@
 #include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -708,6 +710,35 @@ int main()
       test.execute( ExpectSeqno { isn + bigstring.size() + 2 } );
       test.execute( ExpectSeqnosInFlight { 0 } );
     }
+
+    {
+      // Past 2^32 sequence numbers, acks still free the stream: segments of 1 MiB keep the run short
+      constexpr uint64_t segment_size = 1 << 20;
+      constexpr uint64_t segments = ( 1ULL << 32 ) / segment_size + 3;
+      const Wrap32 isn( rd() );
+      TCPSender sender { ByteStream { segment_size }, isn, 1000, { .window_scale = 5, .mss = segment_size } };
+      sender.set_peer_window_scale( 5 );
+      vector<pair<Wrap32, uint64_t>> sent; // seqno and payload size of each segment
+      const auto transmit
+        = [&]( const TCPSenderMessage& msg ) { sent.emplace_back( msg.seqno, msg.payload.size() ); };
+      sender.push( transmit );
+      sender.receive( { .ackno = isn + 1, .window_size = UINT16_MAX } );
+      const string payload( segment_size, 'x' );
+      for ( uint64_t i = 0; i < segments; ++i ) {
+        sent.clear();
+        sender.writer().push( payload );
+        sender.push( transmit );
+        if ( sent.size() != 1 or sent.back().second != segment_size
+             or sent.back().first != isn + 1 + i * segment_size ) {
+          throw runtime_error( "sender did not send segment " + to_string( i ) + " after "
+                               + to_string( i * segment_size ) + " bytes" );
+        }
+        sender.receive( { .ackno = sent.back().first + segment_size, .window_size = UINT16_MAX } );
+        if ( sender.sequence_numbers_in_flight() != 0 or sender.writer().available_capacity() != segment_size ) {
+          throw runtime_error( "ack of segment " + to_string( i ) + " did not free the stream" );
+        }
+      }
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
@@ -0,0 +1,293 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+#include "tcp_receiver.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+struct ExpectDuplicateAcks : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  string name() const override { return "duplicate_acks"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.duplicate_acks(); }
+};
+
+struct ExpectFastRecovery : public ExpectBool<TCPSender>
+{
+  using ExpectBool::ExpectBool;
+  string name() const override { return "in_fast_recovery"; }
+  bool value( const TCPSender& sender ) const override { return sender.in_fast_recovery(); }
+};
+
+// A sender with an endless stream to send to a TCPReceiver over a lossy path: segments queue for a link
+// that carries `rate` bytes per ms, each is dropped with probability `loss`, and ACKs come back
+// 2 * `delay` ms after a segment has crossed. Time advances in 1 ms ticks. Without `duplicate_acks`,
+// only ACKs that acknowledge something new reach the sender, as if it ignored duplicate ACKs.
+class LossyPath
+{
+public:
+  static constexpr double rate = 1000;
+  static constexpr double delay = 10;
+
+  LossyPath( double loss, bool duplicate_acks )
+    : sender_( ByteStream { 64000 },
+               Wrap32 { 0 },
+               1000,
+               { .congestion = CongestionControl::Algorithm::NewReno, .adaptive_RTO = { { 200, 60000 } } } )
+    , loss_( loss )
+    , duplicate_acks_( duplicate_acks )
+  {
+    fill();
+    sender_.push( transmit() );
+  }
+
+  void step()
+  {
+    ++now_;
+    sender_.tick( 1, transmit() );
+    while ( not acks_.empty() and acks_.front().first <= static_cast<double>( now_ ) ) {
+      const TCPReceiverMessage ack = acks_.front().second;
+      acks_.pop_front();
+      if ( duplicate_acks_ or ack.ackno != last_ackno_ ) {
+        last_ackno_ = ack.ackno;
+        sender_.receive( ack );
+      }
+    }
+    receiver_.reader().pop( receiver_.reader().bytes_buffered() );
+    fill();
+    sender_.push( transmit() );
+  }
+
+  uint64_t now() const { return now_; }
+  uint64_t bytes_delivered() const { return receiver_.reader().bytes_popped(); }
+
+private:
+  void fill() { sender_.writer().push( string( sender_.writer().available_capacity(), 'x' ) ); }
+
+  TCPSender::TransmitFunction transmit()
+  {
+    return [this]( const TCPSenderMessage& msg ) {
+      link_free_
+        = max( link_free_, static_cast<double>( now_ ) ) + static_cast<double>( msg.sequence_length() ) / rate;
+      if ( bernoulli_distribution { loss_ }( rng_ ) ) {
+        return;
+      }
+      // The receiver sees the segment as it crosses; its ACK arrives a round trip later
+      receiver_.receive( msg );
+      acks_.emplace_back( link_free_ + 2 * delay, receiver_.send() );
+    };
+  }
+
+  TCPSender sender_;
+  TCPReceiver receiver_ { Reassembler { ByteStream { 64000 } } };
+  double loss_;
+  bool duplicate_acks_;
+  minstd_rand rng_ { 144 };
+  uint64_t now_ {};
+  double link_free_ {};
+  deque<pair<double, TCPReceiverMessage>> acks_ {};
+  optional<Wrap32> last_ackno_ {};
+};
+
+double throughput( double loss, bool duplicate_acks )
+{
+  LossyPath path { loss, duplicate_acks };
+  while ( path.now() < 10000 ) {
+    path.step();
+  }
+  return static_cast<double>( path.bytes_delivered() ) / static_cast<double>( path.now() );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Limited transmit, then fast retransmit and recovery",
+                                  cfg,
+                                  CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 10 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + i * MSS ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      // the first segment is lost; each duplicate ACK before the third lets one new segment out
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectDuplicateAcks { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 4 * MSS ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 5 * MSS ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCwnd { 4 * MSS } );
+      // the third resends the first segment without waiting for the timer; ssthresh is half of what was in flight
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectSsthresh { 3 * MSS } );
+      test.execute( ExpectCwnd { 6 * MSS } );
+      // each further duplicate ACK inflates the window by a segment
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectCwnd { 7 * MSS } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 6 * MSS ) );
+      test.execute( ExpectNoSegment {} );
+      // a full ACK ends recovery with the window deflated to ssthresh or less
+      test.execute( Receive { { isn + 1 + 6 * MSS, 60000 } } );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectCwnd { 2 * MSS } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 7 * MSS ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test {
+        "A partial ACK resends the next hole straight away", cfg, CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 10 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + i * MSS ) );
+      }
+      // the first two segments are lost
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 4 * MSS ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 5 * MSS ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 6 * MSS ) );
+      test.execute( ExpectNoSegment {} );
+      // the resent first segment arrives: the ACK stops at the second hole, which goes out again now
+      test.execute( Receive { { isn + 1 + MSS, 60000 } } );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + MSS ) );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + 7 * MSS ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Receive { { isn + 1 + 8 * MSS, 60000 } } );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test {
+        "No duplicate ACK from a window update", cfg, CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 4 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + i * MSS ) );
+      }
+      test.execute( Receive { { isn + 1, 50000 } } );
+      test.execute( Receive { { isn + 1, 40000 } } );
+      test.execute( Receive { { isn + 1, 30000 } } );
+      test.execute( ExpectDuplicateAcks { 0 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Receive { { isn + 1, 30000 } } );
+      test.execute( ExpectDuplicateAcks { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Duplicate ACKs for data sent before a timeout start no fast retransmit",
+                                  cfg,
+                                  CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 4 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + i * MSS ) );
+      }
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 ) );
+      test.execute( ExpectCwnd { MSS } );
+      for ( int i = 0; i < 3; ++i ) {
+        test.execute( Receive { { isn + 1, 60000 } } );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectFastRecovery { false } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Without a congestion controller, duplicate ACKs resend nothing", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 4 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + i * MSS ) );
+      }
+      for ( int i = 0; i < 3; ++i ) {
+        test.execute( Receive { { isn + 1, 60000 } } );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectDuplicateAcks { 0 } );
+    }
+
+    {
+      // With 1% of segments lost, recovering on duplicate ACKs rather than waiting out the RTO keeps the
+      // link much busier
+      const double fast = throughput( 0.01, true );
+      const double timer_only = throughput( 0.01, false );
+      cout << "1% loss: " << fast << " bytes/ms with fast recovery, " << timer_only << " bytes/ms without\n";
+      expect( fast >= 2 * timer_only,
+              "fast recovery delivered " + to_string( fast ) + " bytes/ms, against " + to_string( timer_only )
+                + " bytes/ms without" );
+      expect( throughput( 0, true ) >= 0.9 * LossyPath::rate, "NewReno did not fill a loss-free link" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
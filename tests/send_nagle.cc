@@ -0,0 +1,132 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = 10;
+
+// Connect, with a window of 1000
+void start( TCPSenderTestHarness& test, Wrap32 isn )
+{
+  test.execute( Push {} );
+  test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+  test.execute( AckReceived { isn + 1 }.with_win( 1000 ) );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.mss = MSS;
+
+      TCPSenderTestHarness test { "Nagle holds short segments while data is unacknowledged", cfg };
+      start( test, isn );
+      test.execute( SetNagle { true } );
+      // nothing is in flight, so the first byte goes at once
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( Push { "b" } );
+      test.execute( Push { "cd" } );
+      test.execute( ExpectNoSegment {} );
+      // the ACK lets what gathered go as one segment
+      test.execute( AckReceived { isn + 2 }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "bcd" ).with_seqno( isn + 2 ) );
+      test.execute( ExpectNoSegment {} );
+      // full segments are never held; the short remainder is
+      test.execute( Push { "efghijklmnop" } );
+      test.execute( ExpectMessage {}.with_data( "efghijklmn" ).with_seqno( isn + 5 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 13 } );
+      // nor is a segment that carries the FIN
+      test.execute( Close {} );
+      test.execute( ExpectMessage {}.with_data( "op" ).with_fin( true ).with_seqno( isn + 15 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.mss = MSS;
+
+      TCPSenderTestHarness test { "Nagle turned off sends each write at once", cfg };
+      start( test, isn );
+      test.execute( SetNagle { true } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { "b" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SetNagle { false } );
+      test.execute( Push { "c" } );
+      test.execute( ExpectMessage {}.with_data( "bc" ).with_seqno( isn + 2 ) );
+      test.execute( Push { "d" } );
+      test.execute( ExpectMessage {}.with_data( "d" ).with_seqno( isn + 4 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.mss = MSS;
+
+      TCPSenderTestHarness test { "A corked sender sends only full segments until uncorked", cfg };
+      start( test, isn );
+      test.execute( Cork { 200 } );
+      // held even with nothing in flight
+      test.execute( Push { "abc" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { "defghijklm" } );
+      test.execute( ExpectMessage {}.with_data( "abcdefghij" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      // uncorking sends the rest at once, though Nagle would have held it for the ACK
+      test.execute( SetNagle { true } );
+      test.execute( Uncork {} );
+      test.execute( ExpectMessage {}.with_data( "klm" ).with_seqno( isn + 11 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.mss = MSS;
+
+      TCPSenderTestHarness test { "The cork holds a short segment only until its timeout", cfg };
+      start( test, isn );
+      test.execute( Cork { 200 } );
+      test.execute( Push { "abc" } );
+      test.execute( Tick { 150 } );
+      // more data does not restart the wait
+      test.execute( Push { "de" } );
+      test.execute( Tick { 49 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abcde" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      // the next short segment waits its own timeout
+      test.execute( Push { "f" } );
+      test.execute( Tick { 199 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "f" ).with_seqno( isn + 6 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
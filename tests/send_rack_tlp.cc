@@ -0,0 +1,173 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+constexpr TCPSender::RTOBounds RTO_BOUNDS { 200, 60000 };
+
+struct ExpectFastRecovery : public ExpectBool<TCPSender>
+{
+  using ExpectBool::ExpectBool;
+  string name() const override { return "in_fast_recovery"; }
+  bool value( const TCPSender& sender ) const override { return sender.in_fast_recovery(); }
+};
+
+struct ExpectLossProbes : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  string name() const override { return "loss_probes"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.loss_probes(); }
+};
+
+// Connect with a 20 ms round trip, then send four segments at once
+void start( TCPSenderTestHarness& test, Wrap32 isn )
+{
+  test.execute( Push {} );
+  test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+  test.execute( Tick { 20 } );
+  test.execute( Receive { { isn + 1, 60000 } } );
+  test.execute( Push { string( 4 * MSS, 'x' ) } );
+  for ( uint64_t i = 0; i < 4; ++i ) {
+    test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( isn + 1 + i * MSS ) );
+  }
+  test.execute( ExpectNoSegment {} );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test { "A lost tail is probed after two round trips",
+                                  cfg,
+                                  CongestionControl::Algorithm::NewReno,
+                                  RTO_BOUNDS,
+                                  true,
+                                  true };
+      start( test, isn );
+      // the first two segments arrive; the last two are lost, so no duplicate ACKs follow
+      test.execute( Tick { 20 } );
+      test.execute( Receive { { seg( 2 ), 60000 } } );
+      test.execute( ExpectNoSegment {} );
+      // 2 * SRTT after that ACK, the last segment is resent as a probe
+      test.execute( Tick { 39 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 3 ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectLossProbes { 1 } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      // its ACK SACKs it: the segment sent before it has had a round trip to arrive, so RACK deems it lost
+      test.execute( Tick { 20 } );
+      test.execute( Receive { { seg( 2 ), 60000 } }.with_sack( seg( 3 ), seg( 4 ) ) );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 2 ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 20 } );
+      test.execute( Receive { { seg( 4 ), 60000 } } );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test { "Without RACK-TLP, a lost tail waits for the RTO",
+                                  cfg,
+                                  CongestionControl::Algorithm::NewReno,
+                                  RTO_BOUNDS,
+                                  true };
+      start( test, isn );
+      test.execute( Tick { 20 } );
+      test.execute( Receive { { seg( 2 ), 60000 } } );
+      test.execute( Tick { 199 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 2 ) ) );
+      test.execute( ExpectLossProbes { 0 } );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test { "One SACKed segment: the one before it is lost after the reordering window",
+                                  cfg,
+                                  CongestionControl::Algorithm::NewReno,
+                                  RTO_BOUNDS,
+                                  true,
+                                  true };
+      start( test, isn );
+      // a single duplicate ACK is far from the three fast retransmit needs, but the segment it SACKs went out
+      // with the first: once a quarter of the minimum RTT has passed too, the first is lost
+      test.execute( Tick { 20 } );
+      test.execute( Receive { { seg( 0 ), 60000 } }.with_sack( seg( 1 ), seg( 2 ) ) );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 4 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 0 ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectLossProbes { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test { "A probe that duplicated a delivered segment costs no window",
+                                  cfg,
+                                  CongestionControl::Algorithm::NewReno,
+                                  RTO_BOUNDS,
+                                  true,
+                                  true };
+      start( test, isn );
+      test.execute( Tick { 20 } );
+      test.execute( Receive { { seg( 2 ), 60000 } } );
+      test.execute( Tick { 40 } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 3 ) ) );
+      // the ACK of the original copies was late; the probe then draws a plain duplicate ACK
+      test.execute( Receive { { seg( 4 ), 60000 } } );
+      test.execute( Receive { { seg( 4 ), 60000 } } );
+      test.execute( ExpectCwnd { 6 * MSS } );
+      test.execute( Push { string( 10 * MSS, 'x' ) } );
+      for ( uint64_t i = 4; i < 10; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( seg( i ) ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( Receive { { seg( 10 ), 60000 } } );
+      test.execute( ExpectCwnd { 7 * MSS } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -198,6 +198,39 @@ int main()
       test.execute( ExpectSeqnosInFlight { 0 } );
       test.execute( HasError { false } );
     }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_capacity = 10;
+
+      TCPSenderTestHarness test { "Unacknowledged bytes keep their room in the stream until ACKed", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abcdefgh" } );
+      test.execute( ExpectMessage {}.with_data( "abcdefgh" ) );
+      test.execute( ExpectAvailableCapacity { 2 } );
+      test.execute( Push { "ijklm" } );
+      test.execute( ExpectMessage {}.with_data( "ij" ) );
+      test.execute( ExpectAvailableCapacity { 0 } );
+      // the first segment is resent from the stream, byte for byte
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 1 ).with_data( "abcdefgh" ) );
+      // a partial ACK frees nothing; the ACK of a whole segment frees its bytes
+      test.execute( AckReceived { Wrap32 { isn + 5 } }.with_win( 1000 ) );
+      test.execute( ExpectAvailableCapacity { 0 } );
+      test.execute( AckReceived { Wrap32 { isn + 9 } }.with_win( 1000 ) );
+      test.execute( ExpectAvailableCapacity { 8 } );
+      test.execute( Push { "klm" } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 11 ).with_data( "klm" ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( isn + 9 ).with_data( "ij" ) );
+      test.execute( AckReceived { Wrap32 { isn + 14 } }.with_win( 1000 ) );
+      test.execute( ExpectAvailableCapacity { 10 } );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return 1;
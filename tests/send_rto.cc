@@ -0,0 +1,153 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      const TCPSender::RTOBounds bounds { 10, 60000 };
+      TCPSenderTestHarness test { "RTO follows SRTT and RTTVAR", cfg, CongestionControl::Algorithm::None, bounds };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectRTO { 1000 } );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { isn + 1 } );
+      // first sample: SRTT = R, RTTVAR = R/2, RTO = SRTT + 4 * RTTVAR
+      test.execute( ExpectRTTSamples { 1 } );
+      test.execute( ExpectSRTT { 100000 } );
+      test.execute( ExpectRTO { 300 } );
+      test.execute( Push { "abcd" } );
+      test.execute( ExpectMessage {}.with_data( "abcd" ) );
+      test.execute( Tick { 60 } );
+      test.execute( AckReceived { isn + 5 } );
+      // RTTVAR = (3 * 50 + |100 - 60|) / 4 = 47.5 ms, SRTT = (7 * 100 + 60) / 8 = 95 ms
+      test.execute( ExpectSRTT { 95000 } );
+      test.execute( ExpectRTO { 285 } );
+      test.execute( Push { "efgh" } );
+      test.execute( ExpectMessage {}.with_data( "efgh" ) );
+      test.execute( Tick { 284 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "efgh" ) );
+      test.execute( ExpectRTO { 570 } );
+      // Karn's rule: no sample from a retransmitted segment, and the backed-off RTO stays
+      test.execute( Tick { 5 } );
+      test.execute( AckReceived { isn + 9 } );
+      test.execute( ExpectRTTSamples { 2 } );
+      test.execute( ExpectSRTT { 95000 } );
+      test.execute( ExpectRTO { 570 } );
+      test.execute( Push { "ijkl" } );
+      test.execute( ExpectMessage {}.with_data( "ijkl" ) );
+      test.execute( Tick { 50 } );
+      test.execute( AckReceived { isn + 13 } );
+      // RTTVAR = (3 * 47.5 + 45) / 4 = 46.875 ms, SRTT = (7 * 95 + 50) / 8 = 89.375 ms; RTO rounds up
+      test.execute( ExpectRTTSamples { 3 } );
+      test.execute( ExpectSRTT { 89375 } );
+      test.execute( ExpectRTO { 277 } );
+      test.execute( HasError { false } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      const TCPSender::RTOBounds bounds { 10, 60000 };
+      TCPSenderTestHarness test {
+        "No RTT sample from a retransmitted SYN", cfg, CongestionControl::Algorithm::None, bounds };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectRTTSamples { 0 } );
+      test.execute( ExpectRTO { 2000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      const TCPSender::RTOBounds bounds { 200, 60000 };
+      TCPSenderTestHarness test {
+        "RTO is at least the lower bound", cfg, CongestionControl::Algorithm::None, bounds };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectSRTT { 10000 } );
+      test.execute( ExpectRTO { 200 } );
+      test.execute( Push { "abcd" } );
+      test.execute( ExpectMessage {}.with_data( "abcd" ) );
+      test.execute( Tick { 199 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abcd" ) );
+      test.execute( ExpectRTO { 400 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 400;
+
+      const TCPSender::RTOBounds bounds { 10, 1000 };
+      TCPSenderTestHarness test {
+        "Backoff stops at the upper bound", cfg, CongestionControl::Algorithm::None, bounds };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 400 } );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectRTO { 800 } );
+      test.execute( Tick { 800 } );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectRTO { 1000 } );
+      test.execute( Tick { 999 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectRTO { 1000 } );
+      test.execute( ExpectConsecutiveRetransmissions { 3 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Without bounds, the RTO stays fixed but RTT is still measured", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectSRTT { 100000 } );
+      test.execute( ExpectRTO { 1000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,293 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+#include "tcp_receiver.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+struct ExpectPipe : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  string name() const override { return "pipe"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.pipe(); }
+};
+
+struct ExpectFastRecovery : public ExpectBool<TCPSender>
+{
+  using ExpectBool::ExpectBool;
+  string name() const override { return "in_fast_recovery"; }
+  bool value( const TCPSender& sender ) const override { return sender.in_fast_recovery(); }
+};
+
+// A NewReno sender with an endless stream to send to a TCPReceiver over a lossy path: segments queue for
+// a link that carries `rate` bytes per ms, and ACKs come back 2 * `delay` ms after a segment has crossed.
+// With probability `loss`, a segment starts a burst that drops it and every other one of the next six,
+// so four segments of one window are lost. Time advances in 1 ms ticks.
+class LossyPath
+{
+public:
+  static constexpr double rate = 1000;
+  static constexpr double delay = 25;
+
+  LossyPath( double loss, bool sack )
+    : sender_( ByteStream { 64000 },
+               Wrap32 { 0 },
+               1000,
+               { .congestion = CongestionControl::Algorithm::NewReno,
+                 .adaptive_RTO = { { 200, 60000 } },
+                 .sack = sack } )
+    , loss_( loss )
+  {
+    fill();
+    sender_.push( transmit() );
+  }
+
+  void step()
+  {
+    ++now_;
+    sender_.tick( 1, transmit() );
+    while ( not acks_.empty() and acks_.front().first <= static_cast<double>( now_ ) ) {
+      sender_.receive( acks_.front().second );
+      acks_.pop_front();
+    }
+    receiver_.reader().pop( receiver_.reader().bytes_buffered() );
+    fill();
+    sender_.push( transmit() );
+  }
+
+  uint64_t now() const { return now_; }
+  uint64_t bytes_delivered() const { return receiver_.reader().bytes_popped(); }
+
+private:
+  void fill() { sender_.writer().push( string( sender_.writer().available_capacity(), 'x' ) ); }
+
+  TCPSender::TransmitFunction transmit()
+  {
+    return [this]( const TCPSenderMessage& msg ) {
+      link_free_
+        = max( link_free_, static_cast<double>( now_ ) ) + static_cast<double>( msg.sequence_length() ) / rate;
+      if ( not msg.SYN and burst_ == 0 and bernoulli_distribution { loss_ }( rng_ ) ) {
+        burst_ = 7;
+      }
+      if ( burst_ > 0 and burst_-- % 2 == 1 ) {
+        return;
+      }
+      receiver_.receive( msg );
+      acks_.emplace_back( link_free_ + 2 * delay, receiver_.send() );
+    };
+  }
+
+  TCPSender sender_;
+  TCPReceiver receiver_ { Reassembler { ByteStream { 64000 } } };
+  double loss_;
+  minstd_rand rng_ { 2018 };
+  uint64_t now_ {};
+  double link_free_ {};
+  unsigned burst_ {}; // segments left in the current loss burst
+  deque<pair<double, TCPReceiverMessage>> acks_ {};
+};
+
+double throughput( double loss, bool sack )
+{
+  LossyPath path { loss, sack };
+  while ( path.now() < 20000 ) {
+    path.step();
+  }
+  return static_cast<double>( path.bytes_delivered() ) / static_cast<double>( path.now() );
+}
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test {
+        "Two holes resent in one round trip", cfg, CongestionControl::Algorithm::NewReno, nullopt, true };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_sack_permitted( true ).with_seqno( isn ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 10 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( seg( i ) ) );
+      }
+      // segments 0 and 2 are lost; the others are SACKed as they arrive, with limited transmit at first
+      test.execute( Receive { { seg( 0 ), 60000 } }.with_sack( seg( 1 ), seg( 2 ) ) );
+      test.execute( ExpectMessage {}.with_seqno( seg( 4 ) ) );
+      test.execute(
+        Receive { { seg( 0 ), 60000 } }.with_sack( seg( 3 ), seg( 4 ) ).with_sack( seg( 1 ), seg( 2 ) ) );
+      test.execute( ExpectMessage {}.with_seqno( seg( 5 ) ) );
+      test.execute( ExpectFastRecovery { false } );
+      // the third duplicate ACK resends the first hole; cwnd drops to ssthresh, and segments 0 and 2 and 5
+      // make up the pipe
+      test.execute(
+        Receive { { seg( 0 ), 60000 } }.with_sack( seg( 3 ), seg( 5 ) ).with_sack( seg( 1 ), seg( 2 ) ) );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 0 ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSsthresh { 3 * MSS } );
+      test.execute( ExpectCwnd { 3 * MSS } );
+      test.execute( ExpectPipe { 3 * MSS } );
+      // with three segments SACKed above it, segment 2 is deemed lost and resent at once, without waiting for
+      // the ACK of segment 0; that leaves room for one new segment
+      test.execute(
+        Receive { { seg( 0 ), 60000 } }.with_sack( seg( 3 ), seg( 6 ) ).with_sack( seg( 1 ), seg( 2 ) ) );
+      test.execute( ExpectMessage {}.with_seqno( seg( 2 ) ) );
+      test.execute( ExpectMessage {}.with_seqno( seg( 6 ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectPipe { 3 * MSS } );
+      // the resent segment 0 arrives: a partial ACK, after which the window stays at ssthresh
+      test.execute( Receive { { seg( 2 ), 60000 } }.with_sack( seg( 3 ), seg( 6 ) ) );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectCwnd { 3 * MSS } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 7 ) ) );
+      test.execute( ExpectNoSegment {} );
+      // then the resent segment 2: everything sent before the loss is acknowledged
+      test.execute( Receive { { seg( 6 ), 60000 } } );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectCwnd { 3 * MSS } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 8 ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test { "One ACK that SACKs three segments starts recovery",
+                                  cfg,
+                                  CongestionControl::Algorithm::NewReno,
+                                  nullopt,
+                                  true };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_sack_permitted( true ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 4 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( seg( i ) ) );
+      }
+      test.execute( Receive { { seg( 0 ), 60000 } }.with_sack( seg( 1 ), seg( 4 ) ) );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 0 ) ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test {
+        "A timeout starts loss recovery over", cfg, CongestionControl::Algorithm::NewReno, nullopt, true };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_sack_permitted( true ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 4 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( seg( i ) ) );
+      }
+      // segment 0 is lost, and resent in recovery; that copy is in the pipe in its place
+      test.execute( Receive { { seg( 0 ), 60000 } }.with_sack( seg( 1 ), seg( 4 ) ) );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 0 ) ) );
+      test.execute( ExpectPipe { MSS } );
+      // the resent copy is lost as well. After the timeout, segment 0 is no longer deemed lost or resent in
+      // recovery: only its new copy is in the pipe
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 0 ) ) );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectPipe { MSS } );
+      // the same SACK blocks, again: losses are marked from them afresh, without a new recovery
+      test.execute( Receive { { seg( 0 ), 60000 } }.with_sack( seg( 1 ), seg( 4 ) ) );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectPipe { 0 } );
+      // once everything sent before the timeout is acknowledged, a new loss starts a new recovery, which
+      // resends its hole once
+      test.execute( Receive { { seg( 4 ), 60000 } } );
+      test.execute( Push { string( 4 * MSS, 'y' ) } );
+      for ( uint64_t i = 4; i < 6; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( seg( i ) ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( Receive { { seg( 4 ), 60000 } }.with_sack( seg( 5 ), seg( 6 ) ) );
+      test.execute( ExpectMessage {}.with_seqno( seg( 6 ) ) );
+      test.execute( Receive { { seg( 4 ), 60000 } }.with_sack( seg( 5 ), seg( 7 ) ) );
+      test.execute( ExpectMessage {}.with_seqno( seg( 7 ) ) );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( Receive { { seg( 4 ), 60000 } }.with_sack( seg( 5 ), seg( 8 ) ) );
+      test.execute( ExpectFastRecovery { true } );
+      test.execute( ExpectMessage {}.with_seqno( seg( 4 ) ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectPipe { MSS } );
+      test.execute( Receive { { seg( 8 ), 60000 } } );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      const auto seg = [&]( uint64_t i ) { return isn + 1 + i * MSS; };
+
+      TCPSenderTestHarness test {
+        "SACK blocks are ignored unless the SYN offered SACK", cfg, CongestionControl::Algorithm::NewReno };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_sack_permitted( false ) );
+      test.execute( Receive { { isn + 1, 60000 } } );
+      test.execute( Push { string( 4 * MSS, 'x' ) } );
+      for ( uint64_t i = 0; i < 4; ++i ) {
+        test.execute( ExpectMessage {}.with_payload_size( MSS ).with_seqno( seg( i ) ) );
+      }
+      test.execute( Receive { { seg( 0 ), 60000 } }.with_sack( seg( 1 ), seg( 4 ) ) );
+      test.execute( ExpectFastRecovery { false } );
+      test.execute( ExpectPipe { 4 * MSS } );
+    }
+
+    {
+      // With several losses in a window, SACK recovery resends all the holes in one round trip where
+      // NewReno resends one per round trip, and often falls back on a timeout
+      const double sack = throughput( 0.005, true );
+      const double no_sack = throughput( 0.005, false );
+      cout << "loss bursts: " << sack << " bytes/ms with SACK, " << no_sack << " bytes/ms without\n";
+      expect( sack >= 2 * no_sack,
+              "SACK delivered " + to_string( sack ) + " bytes/ms, against " + to_string( no_sack )
+                + " bytes/ms without" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+#include "helpers.hh"
+#include "random.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_receiver.hh"
+#include "tcp_segment.hh"
+#include "tcp_sender.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// Serialize a message into a TCP segment on the wire, and parse it back
+TCPMessage round_trip( const TCPMessage& message )
+{
+  TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+  segment.compute_checksum( 0 );
+  TCPSegment parsed;
+  if ( not parse( parsed, vector<string> { concat( serialize( segment ) ) }, 0 ) ) {
+    throw runtime_error( "segment did not parse: " + segment.to_string() );
+  }
+  return move( parsed.message );
+}
+
+// Collects what a TCPSender transmits
+struct Sent
+{
+  vector<TCPSenderMessage> messages {};
+  TCPSender::TransmitFunction transmit()
+  {
+    return [this]( const TCPSenderMessage& msg ) { messages.push_back( msg ); };
+  }
+};
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      // The timestamps option survives the trip through the TCP header, beside the SYN's other options and
+      // as many SACK blocks as fit
+      const Wrap32 isn( rd() );
+      TCPMessage message;
+      message.sender = TCPSenderMessage { .seqno = isn,
+                                          .SYN = true,
+                                          .SACK_permitted = true,
+                                          .window_scale = 7,
+                                          .MSS = 1460,
+                                          .timestamp = 0xfedcba98 };
+      TCPReceiverMessage ack { .ackno = isn + 1, .window_size = 1000, .timestamp_echo = 12345 };
+      for ( uint32_t i = 0; i < TCPReceiverMessage::MAX_SACK_BLOCKS; ++i ) {
+        ack.sack.push_back( { isn + 20 + 10 * i, isn + 25 + 10 * i } );
+      }
+      message.receiver = TCPReceiverMessage { ack };
+      TCPMessage parsed = round_trip( message );
+      expect( parsed.sender->timestamp == 0xfedcba98 and parsed.receiver->timestamp_echo == 12345,
+              "SYN with timestamps came back as TSval " + to_string( parsed.sender->timestamp.value_or( 0 ) )
+                + ", TSecr " + to_string( parsed.receiver->timestamp_echo.value_or( 0 ) ) );
+      expect( parsed.sender->MSS == 1460 and parsed.sender->window_scale == 7 and parsed.sender->SACK_permitted,
+              "SYN with timestamps lost its other options" );
+      expect( parsed.receiver->sack.size() == 1,
+              "SYN with timestamps came back with " + to_string( parsed.receiver->sack.size() ) + " SACK blocks" );
+
+      // after the SYN, three SACK blocks fit beside the timestamps
+      message.sender = TCPSenderMessage { .seqno = isn + 1, .payload = "hello", .timestamp = 7 };
+      parsed = round_trip( message );
+      expect( parsed.sender->timestamp == 7 and parsed.sender->payload == "hello"
+                and parsed.receiver->sack.size() == 3,
+              "segment with timestamps came back with " + to_string( parsed.receiver->sack.size() )
+                + " SACK blocks" );
+
+      // without the ACK flag, the echo means nothing
+      message.receiver = TCPReceiverMessage { .window_size = 1000, .timestamp_echo = 99 };
+      parsed = round_trip( message );
+      expect( not parsed.receiver->timestamp_echo.has_value(), "segment without an ACK came back with a TSecr" );
+    }
+
+    {
+      // With timestamps, the ACK of a resent segment still gives an RTT sample: the echo says which copy
+      // arrived. Without them, Karn's rule leaves it out.
+      for ( const bool timestamps : { true, false } ) {
+        const Wrap32 isn( rd() );
+        TCPSender sender { ByteStream { 64000 },
+                           isn,
+                           1000,
+                           { .congestion = CongestionControl::Algorithm::NewReno,
+                             .adaptive_RTO = TCPSender::RTOBounds { 200, 60000 },
+                             .timestamps = timestamps } };
+        Sent sent;
+        sender.push( sent.transmit() );
+        expect( sent.messages.size() == 1 and sent.messages.back().SYN, "sender did not send its SYN" );
+        expect( sent.messages.back().timestamp.has_value() == timestamps, "SYN's timestamp option is wrong" );
+
+        const auto echo = [&]( const TCPSenderMessage& msg ) {
+          return timestamps ? msg.timestamp : optional<uint32_t> {};
+        };
+        sender.tick( 100, sent.transmit() );
+        sender.receive(
+          { .ackno = isn + 1, .window_size = 60000, .timestamp_echo = echo( sent.messages.back() ) } );
+        expect( sender.rtt_estimate().samples == 1 and sender.rtt_estimate().srtt_us == 100000,
+                "the SYN's round trip measured " + to_string( sender.rtt_estimate().srtt_us ) + " us" );
+
+        sender.writer().push( "hello" );
+        sender.push( sent.transmit() );
+        const uint64_t rto = sender.rtt_estimate().rto_ms;
+        sender.tick( rto, sent.transmit() );
+        expect( sent.messages.size() == 3 and sent.messages.back().payload == "hello",
+                "sender did not resend its data" );
+        if ( timestamps ) {
+          expect( sent.messages.back().timestamp == 100 + rto and sent.messages[1].timestamp == 100,
+                  "the resent copy was not stamped anew" );
+        }
+
+        sender.tick( 30, sent.transmit() );
+        sender.receive(
+          { .ackno = isn + 6, .window_size = 60000, .timestamp_echo = echo( sent.messages.back() ) } );
+        const TCPSender::RTTEstimate estimate = sender.rtt_estimate();
+        if ( timestamps ) {
+          expect( estimate.samples == 2 and estimate.srtt_us == ( 7 * 100000 + 30000 ) / 8,
+                  "the resent copy's round trip gave " + to_string( estimate.samples ) + " samples, SRTT "
+                    + to_string( estimate.srtt_us ) + " us" );
+        } else {
+          expect( estimate.samples == 1, "Karn's rule let the ACK of a resent segment through" );
+        }
+      }
+    }
+
+    {
+      // A sender whose peer's SYN carried no timestamp stops sending them
+      TCPSender sender { ByteStream { 64000 },
+                         Wrap32 { 0 },
+                         1000,
+                         { .congestion = CongestionControl::Algorithm::NewReno, .timestamps = true } };
+      sender.set_peer_timestamps( false );
+      Sent sent;
+      sender.push( sent.transmit() );
+      expect( not sent.messages.back().timestamp.has_value(), "SYN carried a timestamp the peer did not offer" );
+      expect( not sender.make_empty_message().timestamp.has_value(), "ACK carried a timestamp" );
+    }
+
+    {
+      // The receiver echoes the timestamp of the segments that move its ackno, and drops a segment with an
+      // older timestamp than that (PAWS) even though it is in the window
+      const Wrap32 isn( rd() );
+      TCPReceiver receiver { Reassembler { ByteStream { 4000 } }, false, true };
+      receiver.receive( { .seqno = isn, .SYN = true, .timestamp = 1000 } );
+      expect( receiver.send().timestamp_echo == 1000, "receiver did not echo the SYN's timestamp" );
+
+      receiver.receive( { .seqno = isn + 1, .payload = "ab", .timestamp = 1005 } );
+      expect( receiver.send().timestamp_echo == 1005, "receiver did not echo the in-order segment's timestamp" );
+
+      // a segment ahead of a gap does not set the echo
+      receiver.receive( { .seqno = isn + 5, .payload = "ef", .timestamp = 1010 } );
+      expect( receiver.send().timestamp_echo == 1005, "receiver echoed the timestamp of a segment past a gap" );
+
+      // an old duplicate fills the gap, but PAWS drops it
+      receiver.receive( { .seqno = isn + 3, .payload = "XX", .timestamp = 900 } );
+      expect( receiver.send().ackno == isn + 3, "receiver took a segment with an old timestamp" );
+
+      // so does a segment with no timestamp at all
+      receiver.receive( { .seqno = isn + 3, .payload = "XX" } );
+      expect( receiver.send().ackno == isn + 3, "receiver took a segment without a timestamp" );
+
+      receiver.receive( { .seqno = isn + 3, .payload = "cd", .timestamp = 1011 } );
+      expect( receiver.send().ackno == isn + 7 and receiver.send().timestamp_echo == 1011,
+              "receiver did not take the gap's data" );
+      string data;
+      read( receiver.reader(), 6, data );
+      expect( data == "abcdef", "receiver holds \"" + data + "\"" );
+
+      // timestamps wrap around 2^32 like sequence numbers
+      receiver.receive( { .seqno = isn + 7, .payload = "g", .timestamp = 1011 + ( 1U << 31 ) - 1 } );
+      receiver.receive( { .seqno = isn + 8, .payload = "h", .timestamp = 5 } );
+      expect( receiver.send().ackno == isn + 9 and receiver.send().timestamp_echo == 5,
+              "receiver did not take a timestamp that wrapped around" );
+
+      // without timestamps, nothing is echoed or dropped
+      TCPReceiver plain { Reassembler { ByteStream { 4000 } }, false, false };
+      plain.receive( { .seqno = isn, .SYN = true, .timestamp = 1000 } );
+      plain.receive( { .seqno = isn + 1, .payload = "ab", .timestamp = 5 } );
+      expect( not plain.send().timestamp_echo.has_value() and plain.send().ackno == isn + 3,
+              "receiver without timestamps used them" );
+    }
+
+    {
+      // Two peers agree on timestamps in the handshake, and stamp and echo every segment after it
+      TCPConfig cfg;
+      TCPPeer client { cfg };
+      TCPPeer server { cfg };
+      vector<TCPMessage> to_server;
+      vector<TCPMessage> to_client;
+      const auto into = [&]( vector<TCPMessage>& queue ) {
+        return [&]( const TCPMessage& message ) { queue.push_back( round_trip( message ) ); };
+      };
+      client.push( into( to_server ) );
+      client.tick( 3, into( to_server ) );
+      server.tick( 50, into( to_client ) );
+      for ( auto& message : to_server ) {
+        server.receive( move( message ), into( to_client ) );
+      }
+      expect( not to_client.empty() and to_client.front().sender->SYN, "server sent no SYN" );
+      expect( to_client.front().sender->timestamp == 50 and to_client.front().receiver->timestamp_echo == 0,
+              "server's SYN came back as " + TCPSegment { .message = move( to_client.front() ) }.to_string() );
+
+      to_server.clear();
+      client.outbound_writer().push( "hi" );
+      for ( auto& message : to_client ) {
+        client.receive( move( message ), into( to_server ) );
+      }
+      expect( not to_server.empty() and to_server.back().sender->payload == "hi", "client sent no data" );
+      expect( to_server.back().sender->timestamp == 3 and to_server.back().receiver->timestamp_echo == 50,
+              "client's data came back as " + TCPSegment { .message = move( to_server.back() ) }.to_string() );
+
+      // a peer that does not offer them gets none
+      TCPPeer offering { cfg };
+      cfg.timestamps = false;
+      TCPPeer plain { cfg };
+      to_server.clear();
+      to_client.clear();
+      offering.push( into( to_server ) );
+      for ( auto& message : to_server ) {
+        plain.receive( move( message ), into( to_client ) );
+      }
+      to_server.clear();
+      for ( auto& message : to_client ) {
+        expect( not message.sender->timestamp.has_value(), "peer without timestamps sent one" );
+        offering.receive( move( message ), into( to_server ) );
+      }
+      expect( not to_server.empty() and not to_server.back().sender->timestamp.has_value(),
+              "peer sent a timestamp after a SYN without one" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
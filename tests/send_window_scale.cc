@@ -0,0 +1,200 @@
+#include "helpers.hh"
+#include "random.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr uint64_t WINDOW = 16 * 1024 * 1024;
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// Serialize a message into a TCP segment on the wire, and parse it back
+TCPMessage round_trip( const TCPMessage& message )
+{
+  TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+  segment.compute_checksum( 0 );
+  TCPSegment parsed;
+  if ( not parse( parsed, vector<string> { concat( serialize( segment ) ) }, 0 ) ) {
+    throw runtime_error( "segment did not parse: " + segment.to_string() );
+  }
+  return move( parsed.message );
+}
+
+// One connection between two TCPPeers over a path with a bottleneck of `rate` bytes per ms from the client
+// to the server, and `delay` ms of propagation delay each way. Each segment goes through the TCP header
+// on its way. The server's application reads everything as soon as it arrives. Time advances in 1 ms ticks.
+class Connection
+{
+public:
+  static constexpr double rate = 20000;
+  static constexpr double delay = 5;
+
+  explicit Connection( bool window_scaling )
+  {
+    TCPConfig cfg;
+    cfg.recv_capacity = cfg.send_capacity = WINDOW;
+    cfg.window_scaling = window_scaling;
+    cfg.rt_timeout = 100;
+    client_.emplace( cfg );
+    server_.emplace( cfg );
+    client_->push( transmit( to_server_, true ) );
+  }
+
+  void step()
+  {
+    ++now_;
+    client_->tick( 1, transmit( to_server_, true ) );
+    server_->tick( 1, transmit( to_client_, false ) );
+    deliver( to_server_, *server_, transmit( to_client_, false ) );
+    deliver( to_client_, *client_, transmit( to_server_, true ) );
+    server_->inbound_reader().pop( server_->inbound_reader().bytes_buffered() );
+    Writer& writer = client_->outbound_writer();
+    writer.push( string( writer.available_capacity(), 'x' ) );
+    client_->push( transmit( to_server_, true ) );
+    peak_in_flight_ = max( peak_in_flight_, client_->sender().sequence_numbers_in_flight() );
+  }
+
+  uint64_t now() const { return now_; }
+  uint64_t bytes_delivered() const { return server_->receiver().reader().bytes_popped(); }
+  uint64_t peak_in_flight() const { return peak_in_flight_; }
+
+private:
+  using Queue = deque<pair<double, TCPMessage>>;
+
+  TCPPeer::TransmitFunction transmit( Queue& queue, bool bottleneck )
+  {
+    return [this, &queue, bottleneck]( const TCPMessage& message ) {
+      double sent = static_cast<double>( now_ );
+      if ( bottleneck ) {
+        link_free_ = max( link_free_, sent ) + static_cast<double>( message.sender->sequence_length() ) / rate;
+        sent = link_free_;
+      }
+      queue.emplace_back( sent + delay, round_trip( message ) );
+    };
+  }
+
+  void deliver( Queue& queue, TCPPeer& peer, const TCPPeer::TransmitFunction& reply )
+  {
+    while ( not queue.empty() and queue.front().first <= static_cast<double>( now_ ) ) {
+      peer.receive( move( queue.front().second ), reply );
+      queue.pop_front();
+    }
+  }
+
+  optional<TCPPeer> client_ {};
+  optional<TCPPeer> server_ {};
+  Queue to_server_ {};
+  Queue to_client_ {};
+  uint64_t now_ {};
+  double link_free_ {};
+  uint64_t peak_in_flight_ {};
+};
+} // namespace
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      // The window scale option survives the trip through the TCP header, alongside SACK-permitted
+      const Wrap32 isn( rd() );
+      TCPMessage message;
+      message.sender = TCPSenderMessage { .seqno = isn, .SYN = true, .SACK_permitted = true, .window_scale = 9 };
+      TCPReceiverMessage ack { .ackno = isn + 1, .window_size = 32768 };
+      for ( uint32_t i = 0; i < TCPReceiverMessage::MAX_SACK_BLOCKS; ++i ) {
+        ack.sack.push_back( { isn + 20 + 10 * i, isn + 25 + 10 * i } );
+      }
+      message.receiver = TCPReceiverMessage { ack };
+      const TCPMessage parsed = round_trip( message );
+      expect( parsed.sender->SYN and parsed.sender->window_scale == 9 and parsed.sender->SACK_permitted,
+              "SYN with window scale came back without it" );
+      expect( parsed.receiver->window_size == 32768,
+              "window came back as " + to_string( parsed.receiver->window_size ) );
+      // the SYN's options leave room for three SACK blocks of the four
+      expect( parsed.receiver->sack.size() == 3,
+              "SYN came back with " + to_string( parsed.receiver->sack.size() ) + " SACK blocks" );
+    }
+
+    {
+      // A receiver with a 16 MB capacity scales its window by 2^9, but only if the peer's SYN offered scaling
+      const Wrap32 isn( rd() );
+      TCPReceiver scaling { Reassembler { ByteStream { WINDOW } }, true };
+      expect( scaling.window_scale() == 9, "receiver with a 16 MB window does not offer a shift of 9" );
+      scaling.receive( { .seqno = isn, .SYN = true, .window_scale = 0 } );
+      expect( scaling.send().window_size == WINDOW >> 9,
+              "scaling receiver advertised " + to_string( scaling.send().window_size ) );
+
+      TCPReceiver unscaled { Reassembler { ByteStream { WINDOW } }, true };
+      unscaled.receive( { .seqno = isn, .SYN = true } );
+      expect( unscaled.send().window_size == UINT16_MAX,
+              "receiver whose peer did not offer scaling advertised " + to_string( unscaled.send().window_size ) );
+
+      const TCPReceiver plain { Reassembler { ByteStream { WINDOW } } };
+      expect( not plain.window_scale().has_value(), "receiver without window scaling offers it" );
+    }
+
+    {
+      // A receiver that may grow to 16 MB offers the shift for 16 MB from the start, but does not apply it to
+      // the window on its SYN-ACK
+      const Wrap32 isn( rd() );
+      TCPReceiver growing { Reassembler { ByteStream { 60000 } }, true, false, nullopt, WINDOW };
+      expect( growing.window_scale() == 9, "receiver that may grow to 16 MB does not offer a shift of 9" );
+      growing.receive( { .seqno = isn, .SYN = true, .window_scale = 0 } );
+      expect( growing.send( true ).window_size == 60000,
+              "window on the SYN-ACK was " + to_string( growing.send( true ).window_size ) );
+      expect( growing.send().window_size == 60000 >> 9,
+              "window after the SYN-ACK was " + to_string( growing.send().window_size ) );
+      growing.set_capacity( WINDOW );
+      expect( growing.send().window_size == WINDOW >> 9,
+              "grown receiver advertised " + to_string( growing.send().window_size ) );
+    }
+
+    {
+      // Over a 10 ms path with a 160 Mbit/s bottleneck, a 16 MB window keeps the bottleneck busy, where a
+      // 64 KB window carries 64 KB per round trip
+      Connection scaled { true };
+      while ( scaled.now() < 300 ) {
+        scaled.step();
+      }
+      Connection unscaled { false };
+      while ( unscaled.now() < 300 ) {
+        unscaled.step();
+      }
+
+      const double with = static_cast<double>( scaled.bytes_delivered() ) / 300;
+      const double without = static_cast<double>( unscaled.bytes_delivered() ) / 300;
+      cout << "16 MB window: " << with << " bytes/ms with window scaling, " << without << " bytes/ms without\n";
+      expect( scaled.peak_in_flight() > 2 * UINT16_MAX,
+              "only " + to_string( scaled.peak_in_flight() ) + " bytes in flight with window scaling" );
+      expect( unscaled.peak_in_flight() <= UINT16_MAX,
+              to_string( unscaled.peak_in_flight() ) + " bytes in flight without window scaling" );
+      expect( with >= 0.5 * Connection::rate, "window scaling delivered only " + to_string( with ) + " bytes/ms" );
+      expect( with >= 2 * without,
+              "window scaling delivered " + to_string( with ) + " bytes/ms, against " + to_string( without ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+#include "byte_stream.hh"
+#include "tcp_config.hh"
+#include "tcp_sender.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr uint64_t MSS = TCPConfig::MAX_PAYLOAD_SIZE;
+constexpr uint64_t SEGMENTS_PER_SIZE = 200'000;
+
+struct Result
+{
+  double push_ns_per_segment; // push() of the whole flight, per segment it sent
+  double ack_ns;              // receive() of an ACK that frees one segment, and the in-flight count after it
+  double recovery_ns;         // receive() and push() of an ACK in SACK recovery that SACKs one more segment
+};
+
+// Grow the congestion window in slow start until `outstanding` full segments are in flight, then lose the
+// first of them: each ACK after that SACKs one more, as a receiver's first SACK block grows. Returns the
+// time per ACK, with push() sending what recovery allows after each.
+double recovery_ns_per_ack( uint64_t outstanding )
+{
+  const Wrap32 isn { 0 };
+  TCPSender sender { ByteStream { 3 * outstanding * MSS },
+                     isn,
+                     1000,
+                     { .congestion = CongestionControl::Algorithm::NewReno,
+                       .sack = true,
+                       .window_scale = 14,
+                       .rack_tlp = true } };
+  sender.set_peer_window_scale( 14 );
+  uint64_t lost = 0;
+  uint64_t resent = 0;
+  const auto transmit = [&]( const TCPSenderMessage& msg ) { resent += msg.seqno == isn + lost; };
+  sender.push( transmit );
+  sender.receive( { .ackno = isn + 1, .window_size = UINT16_MAX } );
+  sender.writer().push( string( 3 * outstanding * MSS, 'x' ) );
+  sender.push( transmit );
+
+  uint64_t ackno = 1;
+  while ( sender.sequence_numbers_in_flight() < outstanding * MSS ) {
+    ackno += MSS;
+    sender.receive( { .ackno = isn + ackno, .window_size = UINT16_MAX } );
+    sender.push( transmit );
+  }
+
+  lost = ackno;
+  resent = 0;
+  const uint64_t flight = sender.sequence_numbers_in_flight() / MSS;
+  const auto start = steady_clock::now();
+  for ( uint64_t i = 1; i < flight; ++i ) {
+    sender.receive( { .ackno = isn + ackno,
+                      .window_size = UINT16_MAX,
+                      .sack = { { isn + ackno + MSS, isn + ackno + ( i + 1 ) * MSS } } } );
+    sender.push( transmit );
+  }
+  const auto end = steady_clock::now();
+  if ( not sender.in_fast_recovery() or resent != 1 ) {
+    throw runtime_error( "the lost segment was resent " + to_string( resent ) + " times in recovery" );
+  }
+  return static_cast<double>( duration_cast<nanoseconds>( end - start ).count() )
+         / static_cast<double>( flight - 1 );
+}
+
+// Put `outstanding` full segments in flight at once, then ACK them one at a time. The peer's window is
+// scaled so that all of them fit.
+Result run_once( uint64_t outstanding )
+{
+  const Wrap32 isn { 0 };
+  TCPSender sender { ByteStream { outstanding * MSS }, isn, 1000, { .window_scale = 14 } };
+  sender.set_peer_window_scale( 14 );
+  uint64_t sent = 0;
+  const auto transmit = [&]( const TCPSenderMessage& ) { ++sent; };
+  sender.push( transmit );
+  sender.receive( { .ackno = isn + 1, .window_size = UINT16_MAX } );
+
+  sender.writer().push( string( outstanding * MSS, 'x' ) );
+  const auto push_start = steady_clock::now();
+  sender.push( transmit );
+  const auto push_end = steady_clock::now();
+  if ( sent != outstanding + 1 or sender.sequence_numbers_in_flight() != outstanding * MSS ) {
+    throw runtime_error( "sender put " + to_string( sender.sequence_numbers_in_flight() ) + " bytes in flight in "
+                         + to_string( sent - 1 ) + " segments, not " + to_string( outstanding ) + " full ones" );
+  }
+
+  uint64_t in_flight = 0;
+  const auto ack_start = steady_clock::now();
+  for ( uint64_t i = 1; i <= outstanding; ++i ) {
+    sender.receive( { .ackno = isn + 1 + i * MSS, .window_size = UINT16_MAX } );
+    in_flight += sender.sequence_numbers_in_flight();
+  }
+  const auto ack_end = steady_clock::now();
+  if ( in_flight != ( outstanding - 1 ) * outstanding / 2 * MSS ) {
+    throw runtime_error( "ACKs left the wrong number of bytes in flight" );
+  }
+
+  const auto ns = []( auto d ) { return static_cast<double>( duration_cast<nanoseconds>( d ).count() ); };
+  return { ns( push_end - push_start ) / static_cast<double>( outstanding ),
+           ns( ack_end - ack_start ) / static_cast<double>( outstanding ),
+           recovery_ns_per_ack( outstanding ) };
+}
+
+// The same number of segments at each size, keeping the fastest round of each to leave out noise
+Result run( uint64_t outstanding )
+{
+  Result best { 1e18, 1e18, 1e18 };
+  for ( uint64_t round = 0; round < SEGMENTS_PER_SIZE / outstanding; ++round ) {
+    const Result r = run_once( outstanding );
+    best.push_ns_per_segment = min( best.push_ns_per_segment, r.push_ns_per_segment );
+    best.ack_ns = min( best.ack_ns, r.ack_ns );
+    best.recovery_ns = min( best.recovery_ns, r.recovery_ns );
+  }
+  return best;
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  // one JSON object per line on stdout; a table on the terminal
+  debug_output << "        outstanding   push ns/segment   ns/ACK   ns/ACK in recovery\n";
+  vector<Result> results;
+  for ( const uint64_t outstanding : { 1000, 10000 } ) {
+    const Result r = run( outstanding );
+    results.push_back( r );
+
+    cout << R"({"outstanding":)" << outstanding << R"(,"push_ns_per_segment":)" << fixed << setprecision( 1 )
+         << r.push_ns_per_segment << R"(,"ack_ns":)" << r.ack_ns << R"(,"recovery_ns":)" << r.recovery_ns
+         << "}\n";
+
+    debug_output << "        " << setw( 11 ) << outstanding << fixed << setprecision( 1 ) << setw( 18 )
+                 << r.push_ns_per_segment << setw( 9 ) << r.ack_ns << setw( 21 ) << r.recovery_ns << "\n";
+  }
+
+  // each ACK touches only the segments it frees, so its cost does not grow with the flight; nor, in SACK
+  // recovery, with the segments SACKed already
+  const Result& small = results.at( 0 );
+  const Result& large = results.at( 1 );
+  if ( large.recovery_ns > 3 * small.recovery_ns ) {
+    throw runtime_error( "with ten times the segments outstanding, an ACK in SACK recovery took "
+                         + to_string( large.recovery_ns ) + " ns against " + to_string( small.recovery_ns )
+                         + " ns" );
+  }
+  if ( large.ack_ns > 3 * small.ack_ns or large.push_ns_per_segment > 3 * small.push_ns_per_segment ) {
+    throw runtime_error( "with ten times the segments outstanding, an ACK took " + to_string( large.ack_ns )
+                         + " ns against " + to_string( small.ack_ns ) + " ns, and push() "
+                         + to_string( large.push_ns_per_segment ) + " ns per segment against "
+                         + to_string( small.push_ns_per_segment ) + " ns" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -52,10 +52,32 @@ struct SenderTestStep : public TestStep<SenderAndOutput>
 class TCPSenderTestHarness : public TestHarness<SenderAndOutput>
 {
 public:
-  TCPSenderTestHarness( std::string name, TCPConfig config )
+  // Without a congestion controller, only the receiver's window limits the sender; without RTO bounds,
+  // the RTO stays at config.rt_timeout (apart from backoff); without `sack`, SACK blocks are ignored;
+  // `rack_tlp` turns on RACK loss detection and tail loss probes
+  TCPSenderTestHarness( std::string name,
+                        TCPConfig config,
+                        CongestionControl::Algorithm congestion = CongestionControl::Algorithm::None,
+                        std::optional<TCPSender::RTOBounds> adaptive_RTO = std::nullopt,
+                        bool sack = false,
+                        bool rack_tlp = false )
     : TestHarness( move( name ),
-                   "initial_RTO_ms=" + to_string( config.rt_timeout ) + " and ISN=" + to_string( config.isn ),
-                   { TCPSender { ByteStream { config.send_capacity }, config.isn, config.rt_timeout } } )
+                   "initial_RTO_ms=" + to_string( config.rt_timeout ) + " and ISN=" + to_string( config.isn )
+                     + ( congestion == CongestionControl::Algorithm::None
+                           ? ""
+                           : " and congestion=" + std::string( CongestionControl::name( congestion ) ) )
+                     + ( adaptive_RTO.has_value() ? " and adaptive RTO in [" + to_string( adaptive_RTO->min_ms )
+                                                      + ", " + to_string( adaptive_RTO->max_ms ) + "] ms"
+                                                  : "" )
+                     + ( sack ? " and SACK" : "" ) + ( rack_tlp ? " and RACK-TLP" : "" ),
+                   { TCPSender { ByteStream { config.send_capacity },
+                                 config.isn,
+                                 config.rt_timeout,
+                                 { .congestion = congestion,
+                                   .adaptive_RTO = adaptive_RTO,
+                                   .sack = sack,
+                                   .mss = config.mss,
+                                   .rack_tlp = rack_tlp } } } )
   {}
 
   template<std::derived_from<TestStep<TCPSender>> T>
@@ -97,6 +119,13 @@ struct ExpectSeqnosInFlight : public ExpectNumber<TCPSender, uint64_t>
   uint64_t value( const TCPSender& sender ) const override { return sender.sequence_numbers_in_flight(); }
 };
 
+struct ExpectAvailableCapacity : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "writer().available_capacity()"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.writer().available_capacity(); }
+};
+
 struct ExpectConsecutiveRetransmissions : public ExpectNumber<TCPSender, uint64_t>
 {
   using ExpectNumber::ExpectNumber;
@@ -104,6 +133,41 @@ struct ExpectConsecutiveRetransmissions : public ExpectNumber<TCPSender, uint64_
   uint64_t value( const TCPSender& sender ) const override { return sender.consecutive_retransmissions(); }
 };
 
+struct ExpectCwnd : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "congestion_control().cwnd"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.congestion_control().cwnd(); }
+};
+
+struct ExpectSsthresh : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "congestion_control().ssthresh"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.congestion_control().ssthresh(); }
+};
+
+struct ExpectRTO : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "rtt_estimate().rto_ms"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.rtt_estimate().rto_ms; }
+};
+
+struct ExpectSRTT : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "rtt_estimate().srtt_us"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.rtt_estimate().srtt_us; }
+};
+
+struct ExpectRTTSamples : public ExpectNumber<TCPSender, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "rtt_estimate().samples"; }
+  uint64_t value( const TCPSender& sender ) const override { return sender.rtt_estimate().samples; }
+};
+
 struct ExpectNoSegment : public Expectation<SenderAndOutput>
 {
   std::string description() const override { return "nothing to send"; }
@@ -122,6 +186,29 @@ struct SetError : public Action<TCPSender>
   void execute( TCPSender& sender ) const override { sender.writer().set_error(); }
 };
 
+struct SetNagle : public Action<TCPSender>
+{
+  bool enabled_;
+  explicit SetNagle( bool enabled ) : enabled_( enabled ) {}
+  std::string description() const override { return enabled_ ? "turn Nagle on" : "turn Nagle off"; }
+  void execute( TCPSender& sender ) const override { sender.set_nagle( enabled_ ); }
+};
+
+struct Cork : public Action<TCPSender>
+{
+  uint64_t timeout_ms_;
+  explicit Cork( uint64_t timeout_ms ) : timeout_ms_( timeout_ms ) {}
+  std::string description() const override { return "cork for at most " + std::to_string( timeout_ms_ ) + " ms"; }
+  void execute( TCPSender& sender ) const override { sender.cork( timeout_ms_ ); }
+};
+
+struct Uncork : public Action<SenderAndOutput>
+{
+  std::string description() const override { return "uncork"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.uncork( ss.make_transmit() ); }
+  constexpr std::string obj() const override { return "TCPSender"; }
+};
+
 struct HasError : public ExpectBool<TCPSender>
 {
   using ExpectBool::ExpectBool;
@@ -222,7 +309,11 @@ struct Receive : public Action<SenderAndOutput>
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size;
+    for ( const auto& block : msg_.sack ) {
+      desc << ", sack=[" << block.left << ", " << block.right << ")";
+    }
+    desc << ")";
     if ( push_ ) {
       desc << ", then push";
     }
@@ -235,6 +326,12 @@ struct Receive : public Action<SenderAndOutput>
     return *this;
   }
 
+  Receive& with_sack( Wrap32 left, Wrap32 right )
+  {
+    msg_.sack.push_back( { left, right } );
+    return *this;
+  }
+
   void execute( SenderAndOutput& ss ) const override
   {
     ss.sender.receive( msg_ );
@@ -283,8 +380,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<bool> sack_permitted {};
 
-  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size ); }
+  bool empty() const { return not( syn or fin or rst or seqno or data or payload_size or sack_permitted ); }
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -310,6 +408,12 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     return *this;
   }
 
+  ExpectMessage& with_sack_permitted( bool sack_permitted_ )
+  {
+    sack_permitted = sack_permitted_;
+    return *this;
+  }
+
   ExpectMessage& with_seqno( Wrap32 seqno_ )
   {
     seqno = seqno_;
@@ -361,6 +465,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( rst.has_value() ) {
       o << ( rst.value() ? " +RST" : " -RST" );
     }
+    if ( sack_permitted.has_value() ) {
+      o << ( sack_permitted.value() ? " +SACK_PERMITTED" : " -SACK_PERMITTED" );
+    }
     return o.str();
   }
 
@@ -391,6 +498,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( rst.has_value() and seg.RST != rst.value() ) {
       throw MessageExpectationViolation( seg, "RST flag", rst.value(), seg.RST );
     }
+    if ( sack_permitted.has_value() and seg.SACK_permitted != sack_permitted.value() ) {
+      throw MessageExpectationViolation( seg, "SACK-permitted option", sack_permitted.value(), seg.SACK_permitted );
+    }
     if ( seqno.has_value() and seg.seqno != seqno.value() ) {
       throw MessageExpectationViolation( seg, "sequence number", seqno.value(), seg.seqno );
     }
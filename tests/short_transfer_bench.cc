@@ -0,0 +1,153 @@
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr uint64_t RESPONSE_LENGTH = 16000;
+constexpr uint64_t TRANSFERS = 2000;
+constexpr uint64_t ONE_WAY_DELAY_MS = 10;
+constexpr double LOSS = 0.02;
+
+// One response of RESPONSE_LENGTH bytes from a server to a client over a path with ONE_WAY_DELAY_MS of
+// delay each way, where each data segment after the handshake is lost with probability LOSS. Returns the
+// time from the client's SYN to the last byte of the response, in ms. Time advances in 1 ms ticks.
+uint64_t completion_ms( bool rack_tlp, minstd_rand& rng )
+{
+  TCPConfig cfg;
+  cfg.rack_tlp = rack_tlp;
+  TCPPeer client { cfg };
+  TCPPeer server { cfg };
+  server.outbound_writer().push( string( RESPONSE_LENGTH, 'x' ) );
+  server.outbound_writer().close();
+
+  using Queue = deque<pair<uint64_t, TCPMessage>>;
+  Queue to_server;
+  Queue to_client;
+  uint64_t now = 0;
+  const auto transmit = [&]( Queue& queue ) {
+    return [&]( const TCPMessage& message ) {
+      if ( not message.sender->SYN and not message.sender->payload.empty()
+           and bernoulli_distribution { LOSS }( rng ) ) {
+        return;
+      }
+      TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+      segment.compute_checksum( 0 );
+      TCPSegment parsed;
+      if ( not parse( parsed, vector<string> { concat( serialize( segment ) ) }, 0 ) ) {
+        throw runtime_error( "segment did not parse" );
+      }
+      queue.emplace_back( now + ONE_WAY_DELAY_MS, move( parsed.message ) );
+    };
+  };
+  const auto deliver = [&]( Queue& queue, TCPPeer& peer, Queue& replies ) {
+    while ( not queue.empty() and queue.front().first <= now ) {
+      peer.receive( move( queue.front().second ), transmit( replies ) );
+      queue.pop_front();
+    }
+  };
+
+  client.push( transmit( to_server ) );
+  while ( client.receiver().reader().bytes_popped() < RESPONSE_LENGTH ) {
+    if ( now > 60'000 ) {
+      throw runtime_error( "transfer did not finish in a minute" );
+    }
+    ++now;
+    client.tick( 1, transmit( to_server ) );
+    server.tick( 1, transmit( to_client ) );
+    deliver( to_server, server, to_client );
+    deliver( to_client, client, to_server );
+    client.inbound_reader().pop( client.inbound_reader().bytes_buffered() );
+  }
+  return now;
+}
+
+struct Result
+{
+  double mean;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t max;
+};
+
+Result run( bool rack_tlp )
+{
+  vector<uint64_t> times;
+  for ( uint64_t i = 0; i < TRANSFERS; ++i ) {
+    minstd_rand rng { 8985 + i }; // the same losses, up to where the two senders part ways
+    times.push_back( completion_ms( rack_tlp, rng ) );
+  }
+  sort( times.begin(), times.end() );
+  const auto percentile = [&]( uint64_t p ) { return times.at( times.size() * p / 100 ); };
+  return { static_cast<double>( accumulate( times.begin(), times.end(), uint64_t {} ) )
+             / static_cast<double>( times.size() ),
+           percentile( 50 ),
+           percentile( 90 ),
+           percentile( 99 ),
+           times.back() };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  // one JSON object per line on stdout; a table on the terminal
+  debug_output << "        " << TRANSFERS << " transfers of " << RESPONSE_LENGTH << " bytes, "
+               << 2 * ONE_WAY_DELAY_MS << " ms RTT, " << LOSS * 100 << "% loss\n";
+  debug_output << "        RACK-TLP   mean ms   p50 ms   p90 ms   p99 ms   max ms\n";
+  vector<Result> results;
+  for ( const bool rack_tlp : { false, true } ) {
+    const Result r = run( rack_tlp );
+    results.push_back( r );
+
+    cout << R"({"rack_tlp":)" << ( rack_tlp ? "true" : "false" ) << R"(,"mean_ms":)" << fixed << setprecision( 1 )
+         << r.mean << R"(,"p50_ms":)" << r.p50 << R"(,"p90_ms":)" << r.p90 << R"(,"p99_ms":)" << r.p99
+         << R"(,"max_ms":)" << r.max << "}\n";
+
+    debug_output << "        " << setw( 8 ) << ( rack_tlp ? "on" : "off" ) << fixed << setprecision( 1 )
+                 << setw( 10 ) << r.mean << setw( 9 ) << r.p50 << setw( 9 ) << r.p90 << setw( 9 ) << r.p99
+                 << setw( 9 ) << r.max << "\n";
+  }
+
+  // lost tails are found in a few round trips rather than an RTO, which shows in the tail of the distribution
+  const Result& without = results.at( 0 );
+  const Result& with = results.at( 1 );
+  if ( with.p99 >= without.p99 or with.mean >= without.mean ) {
+    throw runtime_error( "RACK-TLP took " + to_string( with.p99 ) + " ms at the 99th percentile (mean "
+                         + to_string( with.mean ) + " ms), against " + to_string( without.p99 ) + " ms (mean "
+                         + to_string( without.mean ) + " ms) without" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
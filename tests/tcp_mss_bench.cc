@@ -0,0 +1,152 @@
+#include "helpers.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr uint64_t IP_HEADER_LENGTH = 20;
+
+struct Result
+{
+  uint64_t mss;              // the MSS the client's sender settled on
+  uint64_t segments;         // data segments the client sent
+  double packets_per_second; // segments through both TCP stacks, per second of wall time
+  double goodput_gbit;       // payload through both TCP stacks, per second of wall time
+  double wire_efficiency;    // payload as a share of the bytes on the wire, with IPv4 headers
+};
+
+// Transfer `stream_len` bytes from a client with `client_mss` to a server with `server_mss`. Each
+// segment is serialized to the wire and parsed back; the path has no delay and no loss.
+Result run( uint64_t stream_len, uint64_t client_mss, uint64_t server_mss )
+{
+  TCPConfig cfg;
+  cfg.recv_capacity = cfg.send_capacity = 4 << 20;
+  cfg.delayed_ack_ms = 0; // no clock runs here to send a delayed ACK
+  cfg.mss = client_mss;
+  TCPPeer client { cfg };
+  cfg.mss = server_mss;
+  TCPPeer server { cfg };
+
+  deque<vector<string>> to_server;
+  deque<vector<string>> to_client;
+  uint64_t segments = 0;
+  uint64_t payload_bytes = 0;
+  uint64_t wire_bytes = 0;
+  const auto transmit = [&]( deque<vector<string>>& queue ) {
+    return [&]( const TCPMessage& message ) {
+      TCPSegment segment { .message = { message.sender.borrow(), message.receiver.borrow() } };
+      segment.compute_checksum( 0 );
+      queue.push_back( { concat( serialize( segment ) ) } );
+      if ( &queue == &to_server and not message.sender->payload.empty() ) {
+        ++segments;
+        payload_bytes += message.sender->payload.size();
+        wire_bytes += IP_HEADER_LENGTH + queue.back().front().size();
+      }
+    };
+  };
+  const auto deliver = [&]( deque<vector<string>>& queue, TCPPeer& peer, deque<vector<string>>& replies ) {
+    while ( not queue.empty() ) {
+      TCPSegment segment;
+      if ( not parse( segment, move( queue.front() ), 0 ) ) {
+        throw runtime_error( "segment did not parse" );
+      }
+      queue.pop_front();
+      peer.receive( move( segment.message ), transmit( replies ) );
+    }
+  };
+
+  const string chunk( 1 << 16, 'x' );
+  uint64_t written = 0;
+  const auto start = steady_clock::now();
+  client.push( transmit( to_server ) );
+  while ( server.receiver().reader().bytes_popped() < stream_len ) {
+    Writer& writer = client.outbound_writer();
+    while ( written < stream_len and writer.available_capacity() > 0 ) {
+      const uint64_t len = min( { stream_len - written, writer.available_capacity(), chunk.size() } );
+      writer.push( chunk.substr( 0, len ) );
+      written += len;
+    }
+    client.push( transmit( to_server ) );
+    deliver( to_server, server, to_client );
+    deliver( to_client, client, to_server );
+    server.inbound_reader().pop( server.inbound_reader().bytes_buffered() );
+  }
+  const double seconds = duration_cast<duration<double>>( steady_clock::now() - start ).count();
+
+  return { client.sender().mss(),
+           segments,
+           static_cast<double>( segments ) / seconds,
+           static_cast<double>( payload_bytes ) * 8 / seconds / 1e9,
+           static_cast<double>( payload_bytes ) / static_cast<double>( wire_bytes ) };
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  constexpr uint64_t stream_len = 1 << 25;
+
+  // one JSON object per line on stdout; a table on the terminal
+  debug_output << "        client MSS  server MSS  MSS used   segments    packets/s   Gbit/s  wire efficiency\n";
+  double last_goodput = 0;
+  for ( const auto& [client_mss, server_mss] : vector<pair<uint64_t, uint64_t>> {
+          { 1000, 1000 }, { 1460, 1460 }, { 8960, 8960 }, { 8960, 1460 } } ) {
+    const Result r = run( stream_len, client_mss, server_mss );
+
+    cout << R"({"client_mss":)" << client_mss << R"(,"server_mss":)" << server_mss << R"(,"mss":)" << r.mss
+         << R"(,"segments":)" << r.segments << R"(,"packets_per_s":)" << fixed << setprecision( 0 )
+         << r.packets_per_second << R"(,"gbit_per_s":)" << setprecision( 3 ) << r.goodput_gbit
+         << R"(,"wire_efficiency":)" << setprecision( 4 ) << r.wire_efficiency << "}\n";
+
+    debug_output << "        " << setw( 10 ) << client_mss << setw( 12 ) << server_mss << setw( 10 ) << r.mss
+                 << setw( 11 ) << r.segments << fixed << setprecision( 0 ) << setw( 13 ) << r.packets_per_second
+                 << setprecision( 2 ) << setw( 9 ) << r.goodput_gbit << setprecision( 4 ) << setw( 17 )
+                 << r.wire_efficiency << "\n";
+
+    // the smaller of the two MSSs, and full-sized segments
+    if ( r.mss != min( client_mss, server_mss ) ) {
+      throw runtime_error( "sender used an MSS of " + to_string( r.mss ) + " between " + to_string( client_mss )
+                           + " and " + to_string( server_mss ) );
+    }
+    if ( r.segments > 2 * ( stream_len / r.mss ) ) {
+      throw runtime_error( to_string( r.segments ) + " segments at an MSS of " + to_string( r.mss ) );
+    }
+    if ( client_mss == server_mss ) {
+      if ( r.goodput_gbit < last_goodput * 0.9 ) {
+        throw runtime_error( "goodput fell to " + to_string( r.goodput_gbit ) + " Gbit/s at an MSS of "
+                             + to_string( r.mss ) );
+      }
+      last_goodput = r.goodput_gbit;
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
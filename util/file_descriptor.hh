@@ -3,6 +3,7 @@
 #include "ref.hh"
 #include <cstddef>
 #include <memory>
+#include <span>
 #include <vector>
 
 // A reference-counted handle to a file descriptor
@@ -64,11 +65,13 @@ public:
   // Read into `buffer`
   void read( std::string& buffer );
   void read( std::vector<std::string>& buffers );
+  // Read directly into caller-owned memory (a single readv), returns number of bytes read
+  size_t read( const std::vector<std::span<char>>& buffers );
 
   // Attempt to write a buffer
   // returns number of bytes written
   size_t write( std::string_view buffer );
-  size_t write( const std::vector<std::string_view>& buffers );
+  size_t write( std::span<const std::string_view> buffers );
   size_t write( const std::vector<Ref<std::string>>& buffers );
 
   // Close the underlying file descriptor
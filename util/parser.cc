@@ -74,10 +74,9 @@ void Parser::BufferList::dump_all( vector<Ref<std::string>>& out )
     return;
   }
   if ( skip_ ) {
-    out.emplace_back( buffer_.front()->substr( skip_ ) );
-  } else {
-    out.push_back( move( buffer_.front() ) );
+    buffer_.front().get_mut().erase( 0, skip_ ); // in place: shifts the bytes, but no new allocation
   }
+  out.push_back( move( buffer_.front() ) );
   buffer_.pop_front();
   for ( auto&& x : buffer_ ) {
     out.emplace_back( move( x ) );
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "address.hh"
+#include "byte_stream.hh"
+#include "congestion_control.hh"
+#include "reassembler.hh"
 #include "wrapping_integers.hh"
 
 #include <cstddef>
@@ -11,13 +14,37 @@ class TCPConfig
 {
 public:
   static constexpr size_t DEFAULT_CAPACITY = 64000; //!< Default capacity
-  static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
+  static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Default MSS: conservative max payload size for the Internet
+  static constexpr size_t DEFAULT_PEER_MSS = 536;   //!< MSS of a peer whose SYN has no MSS option (RFC 9293)
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr size_t MAX_TUNED_CAPACITY = 4 << 20; //!< Default most the receive capacity is tuned up to
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
+  bool adaptive_rto = true;                //!< Adapt the retransmission timeout to the measured RTT (RFC 6298)
+  uint64_t min_rto_ms = 200;               //!< Lower bound on the adaptive retransmission timeout
+  uint64_t max_rto_ms = 60000;             //!< Upper bound on the adaptive retransmission timeout, with backoff
   size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
-  size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
+  //! Most the receive capacity is tuned up to, as the reader keeps up
+  size_t max_recv_capacity = MAX_TUNED_CAPACITY;
+  //! Sender capacity, in bytes. Unacknowledged bytes count against it, so it bounds the bytes in flight; by
+  //! default it matches the largest window a tuned peer advertises. Paged storage takes memory only as used.
+  size_t send_capacity = MAX_TUNED_CAPACITY;
+  //! Zero-copy receive needs recv_storage = Chunked: in-order payloads are then kept as read from the network.
+  //! The default, Paged, copies each payload once into pooled pages, and holds memory only for the bytes buffered
+  ByteStream::Storage recv_storage = ByteStream::Storage::Paged; //!< Storage of the inbound stream
+  ByteStream::Storage send_storage = ByteStream::Storage::Paged; //!< Storage of the outbound stream
+  Reassembler::Mode reassembly = Reassembler::Mode::Bitmap;      //!< How out-of-order bytes are held
+  CongestionControl::Algorithm congestion = CongestionControl::Algorithm::NewReno; //!< Congestion control
+  bool sack = true;                        //!< Offer selective acknowledgments on SYN (RFC 2018)
+  bool window_scaling = true;              //!< Offer window scaling on SYN, for windows over 64 KB (RFC 7323)
+  size_t mss = MAX_PAYLOAD_SIZE;           //!< Largest payload sent or received in a segment, offered on SYN
+  bool timestamps = true;                  //!< Offer timestamps on SYN, for RTT samples and PAWS (RFC 7323)
+  bool rack_tlp = true;                    //!< Time-based loss detection and tail loss probes (RFC 8985)
+  bool nagle = true;                       //!< Hold short segments while data is unacknowledged (RFC 896)
+  bool sws_avoidance = true;               //!< Open the receive window only by an MSS or half the buffer at once
+  uint64_t delayed_ack_ms = 40;            //!< Longest an ACK of in-order data is delayed (RFC 1122), or 0
+  uint64_t cork_timeout_ms = 200;          //!< Longest a corked connection holds a segment short of the MSS
   Wrap32 isn { 137 };                      //!< Default initial sequence number
 };
 
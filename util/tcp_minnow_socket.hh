@@ -56,6 +56,12 @@ public:
   // Return peer address from underlying datagram adapter
   const Address& peer_address() const { return _datagram_adapter.config().destination; }
 
+  //! Like TCP_NODELAY: send short segments at once instead of holding them for Nagle's algorithm
+  void set_nodelay( bool nodelay ) { _nodelay = nodelay; }
+
+  //! Like TCP_CORK: send only full-sized segments until uncorked, or until the config's cork timeout
+  void set_cork( bool corked ) { _corked = corked; }
+
 protected:
   //! Adapter to underlying datagram socket (e.g., UDP or IP)
   AdaptT _datagram_adapter;
@@ -87,6 +93,15 @@ private:
 
   std::atomic_bool _abort { false }; //!< Flag used by the owner to force the TCPPeer thread to shut down
 
+  bool _nagle { false }; //!< Does the config ask for Nagle's algorithm?
+
+  std::atomic_bool _nodelay { false }; //!< Has the owner turned Nagle's algorithm off?
+
+  std::atomic_bool _corked { false }; //!< Has the owner corked the connection?
+
+  //! Bring the TCPPeer in line with the options the owner set (TCPPeer thread only)
+  void _apply_options();
+
   bool _inbound_shutdown { false }; //!< Has TCPMinnowSocket shut down the incoming data to the owner?
 
   bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
@@ -11,21 +11,23 @@
 #include <utility>
 
 static constexpr size_t TCP_TICK_MS = 10;
+static constexpr size_t TCP_PACING_TICK_MS = 1; //!< Tick as often as the clock allows while pacing segments out
 
-inline uint64_t timestamp_ms()
+inline uint64_t timestamp_us()
 {
   static_assert( std::is_same_v<std::chrono::steady_clock::duration, std::chrono::nanoseconds> );
 
-  return std::chrono::steady_clock::now().time_since_epoch().count() / 1000000;
+  return std::chrono::steady_clock::now().time_since_epoch().count() / 1000;
 }
 
 //! \param[in] condition is a function returning true if loop should continue
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition )
 {
-  auto base_time = timestamp_ms();
+  auto base_time = timestamp_us();
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    const bool pacing = _tcp.has_value() and _tcp.value().pacing();
+    auto ret = _eventloop.wait_next_event( pacing ? TCP_PACING_TICK_MS : TCP_TICK_MS );
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
@@ -35,9 +37,11 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
     }
 
     if ( _tcp.value().active() ) {
-      const auto next_time = timestamp_ms();
-      _tcp.value().tick( next_time - base_time, [&]( auto x ) { _datagram_adapter.write( x ); } );
-      _datagram_adapter.tick( next_time - base_time );
+      _apply_options();
+      // the TCP clock runs in microseconds, for RTT samples finer than a tick; the adapter's in milliseconds
+      const auto next_time = timestamp_us();
+      _tcp.value().tick_us( next_time - base_time, [&]( auto x ) { _datagram_adapter.write( x ); } );
+      _datagram_adapter.tick( next_time / 1000 - base_time / 1000 );
       base_time = next_time;
     }
   }
@@ -56,10 +60,22 @@ TCPMinnowSocket<AdaptT>::TCPMinnowSocket( std::pair<FileDescriptor, FileDescript
   set_blocking( false );
 }
 
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_apply_options()
+{
+  _tcp->set_nagle( _nagle and not _nodelay );
+  if ( _corked and not _tcp->sender().corked() ) {
+    _tcp->cork();
+  } else if ( not _corked and _tcp->sender().corked() ) {
+    _tcp->uncork( [&]( auto x ) { _datagram_adapter.write( x ); } );
+  }
+}
+
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
+  _nagle = config.nagle;
 
   // Set up the event loop
 
@@ -100,10 +116,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _thread_data,
     Direction::In,
     [&] {
-      std::string data;
-      data.resize( _tcp->outbound_writer().available_capacity() );
-      _thread_data.read( data );
-      _tcp->outbound_writer().push( move( data ) );
+      _tcp->outbound_writer().read_from( _thread_data );
 
       if ( _thread_data.eof() ) {
         _tcp->outbound_writer().close();
@@ -116,6 +129,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
                   << " still in flight).\n";
       }
 
+      _apply_options();
       _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
     },
     [&] {
@@ -138,14 +152,11 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     Direction::Out,
     [&] {
       Reader& inbound = _tcp->inbound_reader();
-      // Write from the inbound_stream into
-      // the pipe, handling the possibility of a partial
-      // write (i.e., only pop what was actually written).
-      if ( inbound.bytes_buffered() ) {
-        const std::string_view buffer = inbound.peek();
-        const auto bytes_written = _thread_data.write( buffer );
-        inbound.pop( bytes_written );
-      }
+      // Write everything buffered in the inbound_stream into
+      // the pipe with one writev, handling the possibility of a
+      // partial write (only what was actually written is popped).
+      inbound.write_to( _thread_data );
+      _tcp->update_window( [&]( auto x ) { _datagram_adapter.write( x ); } );
 
       if ( inbound.is_finished() or inbound.has_error() ) {
         _thread_data.shutdown( SHUT_WR );
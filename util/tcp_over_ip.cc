@@ -41,6 +41,10 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
   }
 
   // is the payload a valid TCP segment?
+  uint64_t tcp_length = 0;
+  for ( const auto& buffer : ip_dgram.payload ) {
+    tcp_length += buffer->size();
+  }
   TCPSegment tcp_seg;
   if ( not parse( tcp_seg, move( ip_dgram.payload ), ip_dgram.header.pseudo_checksum() ) ) {
     return {};
@@ -68,14 +72,33 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( InternetDatagram ip_d
     return {};
   }
 
+  // the next read expects a TCP header as long as this one
+  tcp_header_length_ = tcp_length - tcp_seg.message.sender->payload.size();
+
   return move( tcp_seg.message );
 }
 
+vector<string> TCPOverIPv4Adapter::make_read_buffers() const
+{
+  vector<string> buffers( 3 );
+  buffers[0].resize( IPv4Header::LENGTH );
+  buffers[1].resize( tcp_header_length_ );
+  return buffers;
+}
+
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_read_buffers( vector<string> buffers )
+{
+  InternetDatagram ip_dgram;
+  if ( parse( ip_dgram, move( buffers ) ) ) {
+    return unwrap_tcp_in_ip( move( ip_dgram ) );
+  }
+  return {};
+}
+
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
 {
-  const size_t payload_size = msg.sender->payload.size();
   TCPSegment seg { .message = { msg.sender.borrow(), msg.receiver.borrow() } };
   // set the port numbers in the TCP segment
   seg.udinfo.src_port = config().source.port();
@@ -85,7 +108,8 @@ InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
   InternetDatagram ip_dgram;
   ip_dgram.header.src = config().source.ipv4_numeric();
   ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + payload_size;
+  // the TCP header's length depends on the options the message carries
+  ip_dgram.header.len = ip_dgram.header.hlen * 4 + seg.header_length() + msg.sender->payload.size();
 
   // set payload, calculating TCP checksum using information from IP header
   seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
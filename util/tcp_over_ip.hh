@@ -5,6 +5,8 @@
 #include "tcp_segment.hh"
 
 #include <optional>
+#include <string>
+#include <vector>
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase
@@ -12,5 +14,18 @@ class TCPOverIPv4Adapter : public FdAdapterBase
 public:
   std::optional<TCPMessage> unwrap_tcp_in_ip( InternetDatagram ip_dgram );
 
+  //! Buffers for reading one datagram with a single readv: the IPv4 header, the TCP header, then the
+  //! rest. The TCP header's buffer is as long as that of the last segment unwrapped, options included,
+  //! so while the peer's options stay the same (as timestamps do), the payload lands in a
+  //! string of its own. That string is moved (never copied) through parsing, the TCPReceiver and the
+  //! Reassembler, into a Chunked ByteStream.
+  std::vector<std::string> make_read_buffers() const;
+
+  //! Parse a datagram read into make_read_buffers(), then unwrap_tcp_in_ip()
+  std::optional<TCPMessage> unwrap_read_buffers( std::vector<std::string> buffers );
+
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+private:
+  uint64_t tcp_header_length_ { TCPSegment::HEADER_LENGTH }; //!< of the last segment unwrapped
 };
@@ -7,6 +7,7 @@
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
 #include <functional>
 #include <optional>
 
@@ -18,7 +19,9 @@ class TCPPeer
   }
 
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  static constexpr uint64_t QUICK_ACKS = 16; // data segments ACKed at once before ACKs are delayed
+
+  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) { sender_.set_nagle( cfg_.nagle ); }
 
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
@@ -28,12 +31,31 @@ public:
 
   /* Passthrough methods */
   void push( const TransmitFunction& transmit ) { sender_.push( make_send( transmit ) ); }
-  void tick( uint64_t t, const TransmitFunction& transmit )
+  void tick( uint64_t t, const TransmitFunction& transmit ) { tick_us( t * 1000, transmit ); }
+  void tick_us( uint64_t t, const TransmitFunction& transmit )
   {
-    cumulative_time_ += t;
-    sender_.tick( t, make_send( transmit ) );
+    cumulative_time_us_ += t;
+    sender_.tick_us( t, make_send( transmit ) );
+    if ( ack_deadline_us_.has_value() and cumulative_time_us_ >= *ack_deadline_us_ and active() ) {
+      send( sender_.make_empty_message(), transmit );
+    }
+    tune_receive_buffer();
+    update_window( transmit );
   }
-  bool has_ackno() const { return receiver_.send().ackno.has_value(); }
+  void set_nagle( bool enabled ) { sender_.set_nagle( enabled ); }
+  void cork() { sender_.cork( cfg_.cork_timeout_ms ); }
+  void uncork( const TransmitFunction& transmit ) { sender_.uncork( make_send( transmit ) ); }
+  bool has_ackno() const { return receiver_.message().ackno.has_value(); }
+
+  /* Once the reader has made room: if the last window sent was zero and can now open, send it in a bare ACK,
+     since a peer that was told to stop only probes at its RTO. */
+  void update_window( const TransmitFunction& transmit )
+  {
+    if ( window_closed_ and active() and receiver_.message().window_size > 0 ) {
+      send( sender_.make_empty_message(), transmit );
+    }
+  }
+  bool pacing() const { return sender_.pacing_deferred(); }
 
   /* Is the peer still active? */
   bool active() const
@@ -42,7 +64,8 @@ public:
     const bool sender_active = sender_.sequence_numbers_in_flight() or not sender_.reader().is_finished();
     const bool receiver_active = not receiver_.writer().is_closed();
     const bool lingering
-      = linger_after_streams_finish_ and ( cumulative_time_ < time_of_last_receipt_ + 10UL * cfg_.rt_timeout );
+      = linger_after_streams_finish_
+        and ( cumulative_time_us_ < time_of_last_receipt_us_ + 10000UL * cfg_.rt_timeout );
 
     return ( not any_errors ) and ( sender_active or receiver_active or lingering );
   }
@@ -54,30 +77,63 @@ public:
     }
 
     // Record time in case this peer has to linger after streams finish.
-    time_of_last_receipt_ = cumulative_time_;
-
-    // If SenderMessage occupies a sequence number, make sure to reply.
-    need_send_ |= ( msg.sender->sequence_length() > 0 );
+    time_of_last_receipt_us_ = cumulative_time_us_;
 
     // If SenderMessage is a "keep-alive" (with intentionally invalid seqno), make sure to reply.
     // (N.B. orthodox TCP rules require a reply on any unacceptable segment.)
-    const auto our_ackno = receiver_.send().ackno;
+    const auto our_ackno = receiver_.message().ackno;
     need_send_ |= ( our_ackno.has_value() and msg.sender->seqno + 1 == our_ackno.value() );
 
     // Give incoming TCPSenderMessage to receiver.
-    receiver_.receive( std::move( msg.sender ) );
+    const bool with_data = msg.sender->sequence_length() > 0;
+    const bool syn = msg.sender->SYN;
+    const bool fin = msg.sender->FIN;
+    const uint64_t payload_size = msg.sender->payload.size();
+    const uint64_t pushed_before = receiver_.writer().bytes_pushed();
+    const uint8_t window_scale = msg.sender->window_scale.value_or( 0 );
+    const bool window_scaling = msg.sender->window_scale.has_value();
+    const size_t peer_mss = msg.sender->MSS.value_or( TCPConfig::DEFAULT_PEER_MSS );
+    const bool timestamps = msg.sender->timestamp.has_value();
+    receiver_.receive( msg.sender.release() ); // moves the payload out, unless the message was borrowed
+
+    // If SenderMessage occupies a sequence number, make sure to reply: at once, unless it is in-order data
+    // with no gap behind it, whose ACK can wait for a second full-sized segment or the delayed-ACK timer.
+    // The first few segments are each ACKed, as in Linux's quick-ACK mode, so as not to halve the growth
+    // of the peer's congestion window in slow start.
+    if ( with_data ) {
+      const bool in_order = not syn and not fin and payload_size > 0
+                            and receiver_.writer().bytes_pushed() == pushed_before + payload_size
+                            and receiver_.reassembler().count_bytes_pending() == 0;
+      const bool quick_ack = in_order and quick_acks_left_ > 0;
+      quick_acks_left_ -= quick_ack;
+      delayed_bytes_ += payload_size;
+      largest_payload_ = std::max( largest_payload_, payload_size );
+      if ( not in_order or quick_ack or cfg_.delayed_ack_ms == 0 or delayed_bytes_ >= 2 * largest_payload_ ) {
+        need_send_ = true;
+      } else if ( not ack_deadline_us_.has_value() ) {
+        ack_deadline_us_ = cumulative_time_us_ + cfg_.delayed_ack_ms * 1000;
+      }
+    }
 
-    // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( msg.receiver );
+    // Give incoming TCPReceiverMessage to sender, with segments sized for the peer from its SYN on, and
+    // timestamped if its SYN was. The window on a SYN is never scaled, but those after it are.
+    if ( syn ) {
+      sender_.set_peer_mss( peer_mss );
+      sender_.set_peer_timestamps( timestamps );
+    }
+    sender_.receive( msg.receiver, with_data );
+    if ( syn and window_scaling ) {
+      sender_.set_peer_window_scale( window_scale );
+    }
 
-    // Send reply if needed.
+    // Send reply if needed. Data sent now carries the ACK.
     push( transmit );
     if ( need_send_ ) {
       send( sender_.make_empty_message(), transmit );
     }
 
     // Did the inbound stream finish before the outbound stream? If so, no need to linger after streams finish.
-    if ( receiver_.writer().is_closed() and not std::as_const( sender_ ).reader().is_finished() ) {
+    if ( receiver_.writer().is_closed() and not( sender_.writer().is_closed() and sender_.bytes_unsent() == 0 ) ) {
       linger_after_streams_finish_ = false;
     }
   }
@@ -88,18 +144,81 @@ public:
 
 private:
   TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
-  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
+  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity, cfg_.recv_storage }, cfg_.reassembly },
+                          cfg_.window_scaling,
+                          cfg_.timestamps,
+                          cfg_.sws_avoidance ? std::optional<uint64_t> { cfg_.mss } : std::nullopt,
+                          max_recv_capacity() };
+  TCPSender sender_ { ByteStream { cfg_.send_capacity, cfg_.send_storage },
+                      cfg_.isn,
+                      cfg_.rt_timeout,
+                      { .congestion = cfg_.congestion,
+                        .adaptive_RTO
+                        = cfg_.adaptive_rto
+                            ? std::optional<TCPSender::RTOBounds> { { cfg_.min_rto_ms, cfg_.max_rto_ms } }
+                            : std::nullopt,
+                        .sack = cfg_.sack,
+                        .window_scale = receiver_.window_scale(),
+                        .mss = cfg_.mss,
+                        .timestamps = cfg_.timestamps,
+                        .rack_tlp = cfg_.rack_tlp } };
 
   bool need_send_ {};
+  bool window_closed_ {};                      // the last message sent advertised a zero window
+  uint64_t quick_acks_left_ { QUICK_ACKS };    // segments still to ACK at once, at the start of the connection
+  uint64_t delayed_bytes_ {};                  // in-order bytes received since the last message sent
+  uint64_t largest_payload_ {};                // the peer's full-sized segment, as far as we have seen
+  std::optional<uint64_t> ack_deadline_us_ {}; // when a delayed ACK must go, if one is waiting
+
+  uint64_t tuned_at_us_ {};     // when tune_receive_buffer() last took a measurement
+  uint64_t popped_at_tuning_ {}; // bytes the reader had popped then
+
+  // Mirrored and Spsc storage cannot grow past the capacity it was made with, and so is never tuned
+  uint64_t max_recv_capacity() const
+  {
+    const ByteStream::Storage storage = cfg_.recv_storage;
+    return storage == ByteStream::Storage::Mirrored or storage == ByteStream::Storage::Spsc
+             ? cfg_.recv_capacity
+             : cfg_.max_recv_capacity;
+  }
+
+  // Receive buffer auto-tuning, after Linux's dynamic right-sizing: once a round trip, see how much the
+  // reader drained. A reader that drained more than half the buffer may have been held back by the window,
+  // so the buffer grows to twice that, up to max_recv_capacity. After an RTO without receiving anything,
+  // it goes back to recv_capacity, which the window follows as the reader drains what was advertised.
+  void tune_receive_buffer()
+  {
+    const TCPSender::RTTEstimate rtt = sender_.rtt_estimate();
+    if ( max_recv_capacity() <= cfg_.recv_capacity or rtt.samples == 0
+         or cumulative_time_us_ < tuned_at_us_ + rtt.srtt_us ) {
+      return;
+    }
+    const uint64_t popped = receiver_.reader().bytes_popped();
+    const uint64_t drained = popped - popped_at_tuning_;
+    tuned_at_us_ = cumulative_time_us_;
+    popped_at_tuning_ = popped;
+
+    if ( 2 * drained > receiver_.capacity() and receiver_.capacity() < max_recv_capacity() ) {
+      receiver_.set_capacity( 2 * drained );
+    } else if ( drained == 0 and receiver_.capacity() > cfg_.recv_capacity
+                and cumulative_time_us_ >= time_of_last_receipt_us_ + rtt.rto_ms * 1000 ) {
+      receiver_.set_capacity( cfg_.recv_capacity );
+    } else if ( receiver_.writer().capacity() > receiver_.capacity() ) {
+      receiver_.set_capacity( receiver_.capacity() ); // give up room held for a window now drained
+    }
+  }
 
   void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
   {
-    transmit( { borrow( sender_message ), receiver_.send() } );
+    TCPReceiverMessage receiver_message = receiver_.send( sender_message.SYN );
+    window_closed_ = receiver_message.ackno.has_value() and receiver_message.window_size == 0;
+    transmit( { borrow( sender_message ), std::move( receiver_message ) } );
     need_send_ = false;
+    delayed_bytes_ = 0;
+    ack_deadline_us_.reset();
   }
 
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
-  uint64_t cumulative_time_ {};
-  uint64_t time_of_last_receipt_ {};
+  uint64_t cumulative_time_us_ {};
+  uint64_t time_of_last_receipt_us_ {};
 };
@@ -2,26 +2,47 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstddef>
 #include <optional>
+#include <vector>
 
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
  *
- * It contains three fields:
+ * It contains five fields:
  *
  * 1) The acknowledgment number (ackno): the *next* sequence number needed by the TCP Receiver.
  *    This is an optional field that is empty if the TCPReceiver hasn't yet received the Initial Sequence Number.
  *
  * 2) The window size. This is the number of sequence numbers that the TCP receiver is interested
  *    to receive, starting from the ackno if present. The maximum value is 65,535 (UINT16_MAX from
- *    the <cstdint> header).
+ *    the <cstdint> header). Once window scaling (RFC 7323) is in effect, it counts units of 2^shift
+ *    sequence numbers, with the shift the receiver's SYN offered.
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) Selective acknowledgments (RFC 2018): blocks of sequence numbers beyond the ackno that the receiver
+ *    already holds. The block with the most recently received segment comes first. Empty unless the
+ *    peer's SYN carried the SACK-permitted option.
+ *
+ * 5) The timestamp echo (TSecr of the RFC 7323 timestamps option): the timestamp of the segment that
+ *    this message acknowledges the data of, so the sender can time the round trip. Empty unless both SYNs
+ *    carried timestamps.
  */
 
+struct SACKBlock
+{
+  Wrap32 left;  // first sequence number held
+  Wrap32 right; // sequence number just past the last one held
+};
+
 struct TCPReceiverMessage
 {
   std::optional<Wrap32> ackno {};
   uint16_t window_size {};
   bool RST {};
+  std::vector<SACKBlock> sack {};
+  std::optional<uint32_t> timestamp_echo {};
+
+  static constexpr size_t MAX_SACK_BLOCKS = 4; // as many as fit in the TCP header's 40 bytes of options
 };
@@ -3,12 +3,61 @@
 #include "helpers.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <sstream>
 
 using namespace std;
 
 static_assert( !( TCPSegment::HEADER_LENGTH & 0x03 ) ); // header length must be divisible by 4
 
+namespace {
+// TCP option kinds (RFC 9293 section 3.1, RFC 7323, RFC 2018)
+constexpr uint8_t OPTION_END = 0;
+constexpr uint8_t OPTION_NOP = 1;
+constexpr uint8_t OPTION_MSS = 2;
+constexpr uint8_t OPTION_WINDOW_SCALE = 3;
+constexpr uint8_t OPTION_SACK_PERMITTED = 4;
+constexpr uint8_t OPTION_SACK = 5;
+constexpr uint8_t OPTION_TIMESTAMPS = 8;
+
+constexpr uint8_t SACK_BLOCK_LENGTH = 8;
+constexpr uint8_t MAX_OPTIONS_LENGTH = 40;
+static_assert( 4 + SACK_BLOCK_LENGTH * TCPReceiverMessage::MAX_SACK_BLOCKS <= MAX_OPTIONS_LENGTH );
+
+// Options this implementation sends on a SYN, each padded with NOPs in front to four bytes
+uint8_t syn_options_length( const TCPSenderMessage& sender )
+{
+  if ( not sender.SYN ) {
+    return 0;
+  }
+  return static_cast<uint8_t>( ( sender.MSS.has_value() ? 4 : 0 ) + ( sender.SACK_permitted ? 4 : 0 )
+                               + ( sender.window_scale.has_value() ? 4 : 0 ) );
+}
+
+// The timestamps option, on any segment that carries a timestamp: two NOPs, then ten bytes
+uint8_t timestamps_length( const TCPSenderMessage& sender )
+{
+  return sender.timestamp.has_value() ? 12 : 0;
+}
+
+// SACK blocks sent: as many as there are, up to what fits beside the other options
+size_t sack_blocks( const TCPMessage& message )
+{
+  const size_t room = ( MAX_OPTIONS_LENGTH - syn_options_length( message.sender.get() )
+                        - timestamps_length( message.sender.get() ) - 4 )
+                      / SACK_BLOCK_LENGTH;
+  return min( { message.receiver->sack.size(), TCPReceiverMessage::MAX_SACK_BLOCKS, room } );
+}
+
+uint8_t options_length( const TCPMessage& message )
+{
+  const size_t blocks = sack_blocks( message );
+  const TCPSenderMessage& sender = message.sender.get();
+  return static_cast<uint8_t>( syn_options_length( sender ) + timestamps_length( sender )
+                               + ( blocks > 0 ? 4 + SACK_BLOCK_LENGTH * blocks : 0 ) );
+}
+} // namespace
+
 void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
 {
   /* verify checksum */
@@ -48,12 +97,67 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   parser.integer( udinfo.cksum );
   parser.integer( raw16 ); // urgent pointer
 
-  // skip any options or anything extra in the header
   if ( data_offset < ( HEADER_LENGTH >> 2 ) ) {
     parser.set_error();
     return;
   }
-  parser.remove_prefix( data_offset * 4 - HEADER_LENGTH );
+
+  // options: MSS, window scale, SACK-permitted, SACK and timestamps are understood, any other is skipped over
+  // by its length
+  uint64_t options_left = data_offset * 4 - HEADER_LENGTH;
+  while ( options_left > 0 and not parser.has_error() ) {
+    uint8_t kind {};
+    parser.integer( kind );
+    --options_left;
+    if ( kind == OPTION_END ) {
+      break;
+    }
+    if ( kind == OPTION_NOP ) {
+      continue;
+    }
+
+    uint8_t length {};
+    parser.integer( length );
+    if ( length < 2 or length - 1U > options_left ) {
+      parser.set_error();
+      return;
+    }
+    options_left -= length - 1U;
+
+    const uint8_t body_length = length - 2;
+    if ( kind == OPTION_MSS and body_length == 2 ) {
+      uint16_t mss {};
+      parser.integer( mss );
+      message.sender->MSS = mss;
+    } else if ( kind == OPTION_WINDOW_SCALE and body_length == 1 ) {
+      uint8_t shift {};
+      parser.integer( shift );
+      message.sender->window_scale = shift;
+    } else if ( kind == OPTION_SACK_PERMITTED and body_length == 0 ) {
+      message.sender->SACK_permitted = true;
+    } else if ( kind == OPTION_SACK and body_length > 0 and body_length % SACK_BLOCK_LENGTH == 0 ) {
+      for ( uint8_t i = 0; i < body_length / SACK_BLOCK_LENGTH; ++i ) {
+        uint32_t left {};
+        uint32_t right {};
+        parser.integer( left );
+        parser.integer( right );
+        message.receiver->sack.push_back( { Wrap32 { left }, Wrap32 { right } } );
+      }
+    } else if ( kind == OPTION_TIMESTAMPS and body_length == 8 ) {
+      uint32_t value {};
+      uint32_t echo {};
+      parser.integer( value );
+      parser.integer( echo );
+      message.sender->timestamp = value;
+      if ( message.receiver->ackno.has_value() ) {
+        message.receiver->timestamp_echo = echo; // TSecr is only valid with the ACK flag
+      }
+    } else {
+      parser.remove_prefix( body_length );
+    }
+  }
+  // skip anything after the end of the option list
+  parser.remove_prefix( options_left );
 
   parser.concatenate_all_remaining( message.sender->payload );
 }
@@ -64,13 +168,19 @@ public:
   uint32_t raw_value() const { return raw_value_; }
 };
 
-void TCPSegment::serialize( Serializer& serializer ) const
+uint64_t TCPSegment::header_length() const
+{
+  return HEADER_LENGTH + options_length( message );
+}
+
+// Everything but the payload
+void TCPSegment::serialize_header( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender->seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver->ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { ( HEADER_LENGTH >> 2 ) << 4 } ); // data offset
+  serializer.integer( static_cast<uint8_t>( ( header_length() >> 2 ) << 4 ) ); // data offset
   const bool reset = message.sender->RST or message.receiver->RST;
   const uint8_t flags = ( message.receiver->ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender->SYN ? 0b0000'0010U : 0 ) | ( message.sender->FIN ? 0b0000'0001U : 0 );
@@ -78,6 +188,46 @@ void TCPSegment::serialize( Serializer& serializer ) const
   serializer.integer( message.receiver->window_size );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
+
+  if ( message.sender->SYN and message.sender->MSS.has_value() ) {
+    serializer.integer( OPTION_MSS );
+    serializer.integer( uint8_t { 4 } );
+    serializer.integer( message.sender->MSS.value() );
+  }
+  if ( message.sender->SYN and message.sender->window_scale.has_value() ) {
+    for ( const uint8_t octet :
+          { OPTION_NOP, OPTION_WINDOW_SCALE, uint8_t { 3 }, message.sender->window_scale.value() } ) {
+      serializer.integer( octet );
+    }
+  }
+  if ( message.sender->SYN and message.sender->SACK_permitted ) {
+    for ( const uint8_t octet : { OPTION_NOP, OPTION_NOP, OPTION_SACK_PERMITTED, uint8_t { 2 } } ) {
+      serializer.integer( octet );
+    }
+  }
+  if ( message.sender->timestamp.has_value() ) {
+    for ( const uint8_t octet : { OPTION_NOP, OPTION_NOP, OPTION_TIMESTAMPS, uint8_t { 10 } } ) {
+      serializer.integer( octet );
+    }
+    serializer.integer( message.sender->timestamp.value() );
+    serializer.integer( message.receiver->timestamp_echo.value_or( 0 ) );
+  }
+  const size_t blocks = sack_blocks( message );
+  if ( blocks > 0 ) {
+    const auto length = static_cast<uint8_t>( 2 + SACK_BLOCK_LENGTH * blocks );
+    for ( const uint8_t octet : { OPTION_NOP, OPTION_NOP, OPTION_SACK, length } ) {
+      serializer.integer( octet );
+    }
+    for ( size_t i = 0; i < blocks; ++i ) {
+      serializer.integer( Wrap32Serializable { message.receiver->sack[i].left }.raw_value() );
+      serializer.integer( Wrap32Serializable { message.receiver->sack[i].right }.raw_value() );
+    }
+  }
+}
+
+void TCPSegment::serialize( Serializer& serializer ) const
+{
+  serialize_header( serializer );
   serializer.buffer( message.sender->payload );
 }
 
@@ -85,10 +235,11 @@ void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
   udinfo.cksum = 0;
   Serializer s;
-  serialize( s );
+  serialize_header( s ); // the payload is summed where it is, not copied
 
   InternetChecksum check { datagram_layer_pseudo_checksum };
   check.add( s.finish() );
+  check.add( string_view { message.sender.get().payload } );
   udinfo.cksum = check.value();
 }
 
@@ -106,6 +257,15 @@ string TCPSegment::to_string() const
   if ( message.sender->FIN ) {
     ss << " +FIN";
   }
+  if ( message.sender->SYN and message.sender->MSS.has_value() ) {
+    ss << " MSS<" << message.sender->MSS.value() << ">";
+  }
+  if ( message.sender->SYN and message.sender->window_scale.has_value() ) {
+    ss << " WSCALE<" << static_cast<int>( message.sender->window_scale.value() ) << ">";
+  }
+  if ( message.sender->SYN and message.sender->SACK_permitted ) {
+    ss << " +SACK_PERMITTED";
+  }
   if ( message.sender->RST or message.receiver->RST ) {
     ss << " +RST";
   }
@@ -113,6 +273,14 @@ string TCPSegment::to_string() const
   if ( ackno.has_value() ) {
     ss << " ACK<" << Wrap32Serializable { *ackno }.raw_value() << ">";
   }
+  if ( message.sender->timestamp.has_value() ) {
+    ss << " TS<" << message.sender->timestamp.value() << "," << message.receiver->timestamp_echo.value_or( 0 )
+       << ">";
+  }
+  for ( const auto& block : message.receiver->sack ) {
+    ss << " SACK<" << Wrap32Serializable { block.left }.raw_value() << "-"
+       << Wrap32Serializable { block.right }.raw_value() << ">";
+  }
   ss << " winsize=" << message.receiver->window_size;
   ss << " src=" << udinfo.src_port << " dst=" << udinfo.dst_port;
   return ss.str();
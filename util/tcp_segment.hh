@@ -28,7 +28,11 @@ struct TCPSegment
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
 
   static constexpr uint8_t HEADER_LENGTH = 20; // TCP header length, not including options
+  uint64_t header_length() const;              // TCP header length as serialized, options included
 
   // Return a string containing a summary in human-readable format
   std::string to_string() const;
+
+private:
+  void serialize_header( Serializer& serializer ) const;
 };
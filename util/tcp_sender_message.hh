@@ -2,12 +2,14 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains five fields:
+ * It contains nine fields:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -20,6 +22,18 @@
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
  * 5) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 6) The SACK-permitted option (RFC 2018), only meaningful alongside SYN. If set, this side of the connection
+ *    understands selective acknowledgments, so the peer's receiver may send them.
+ *
+ * 7) The window scale option (RFC 7323), only meaningful alongside SYN: the shift count this side applies to
+ *    the windows its receiver advertises. Only if both SYNs carry it are the windows after them scaled.
+ *
+ * 8) The maximum segment size option (RFC 9293), only meaningful alongside SYN: the largest payload this
+ *    side receives in one segment. The peer sends segments no larger than it.
+ *
+ * 9) The timestamp (TSval of the RFC 7323 timestamps option): the sender's clock, in milliseconds, when
+ *    the segment went out. Offered on SYN, and sent on every segment if both SYNs carried one.
  */
 
 struct TCPSenderMessage
@@ -32,6 +46,11 @@ struct TCPSenderMessage
 
   bool RST {};
 
+  bool SACK_permitted {};
+  std::optional<uint8_t> window_scale {};
+  std::optional<uint16_t> MSS {};
+  std::optional<uint32_t> timestamp {};
+
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
 };
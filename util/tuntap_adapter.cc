@@ -5,16 +5,9 @@ using namespace std;
 
 optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
 {
-  vector<string> strs( 3 );
-  strs[0].resize( IPv4Header::LENGTH );
-  strs[1].resize( TCPSegment::HEADER_LENGTH );
-  _tun.read( strs );
-
-  InternetDatagram ip_dgram;
-  if ( parse( ip_dgram, move( strs ) ) ) {
-    return unwrap_tcp_in_ip( move( ip_dgram ) );
-  }
-  return {};
+  auto buffers = make_read_buffers();
+  _tun.read( buffers );
+  return unwrap_read_buffers( move( buffers ) );
 }
 
 void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )